@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Stream FUDI messages to Pd over TCP and time how much CPU Pd uses.
+
+This starts Pd with netreceive.pd, connects to it, and for the given time
+sends messages of about the given size at up to the given rate (in MB per
+second).  Pd prints the number of messages it got and its CPU time in
+milliseconds, then quits; we print how much we actually sent.
+
+    python3 fudistream.py pd
+    python3 fudistream.py -s 176 -m 100 /path/to/pd -nonetthread
+
+Everything after the options is the Pd command line; "-nogui -noaudio" and
+the patch are added to it.
+"""
+
+import argparse
+import os
+import socket
+import subprocess
+import sys
+import time
+
+
+def message(size):
+    """a FUDI message of numbers, about "size" bytes long"""
+    words = []
+    length = 2      # for the ";\n"
+    while length < size or not words:
+        word = str(len(words) + 1)
+        words.append(word)
+        length += len(word) + 1
+    return (" ".join(words) + ";\n").encode()
+
+
+def connect(port, timeout):
+    """connect to Pd, retrying until it listens or the timeout runs out"""
+    deadline = time.time() + timeout
+    while True:
+        try:
+            return socket.create_connection(("127.0.0.1", port))
+        except OSError:
+            if time.time() > deadline:
+                raise
+            time.sleep(0.01)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="time Pd receiving a stream of FUDI messages")
+    parser.add_argument("-s", "--size", type=int, default=23,
+                        help="approximate message size in bytes (default 23)")
+    parser.add_argument("-m", "--mbps", type=float, default=100,
+                        help="MB per second to send at most (default 100)")
+    parser.add_argument("-t", "--time", type=float, default=10,
+                        help="seconds to send (default 10)")
+    parser.add_argument("-p", "--port", type=int, default=3000,
+                        help="port netreceive.pd listens on (default 3000)")
+    parser.add_argument("pd", nargs=argparse.REMAINDER,
+                        help="Pd command line")
+    args = parser.parse_args()
+    if not args.pd:
+        parser.error("no Pd command given")
+
+    msg = message(args.size)
+    chunk = msg * max(1, 65536 // len(msg))
+    patch = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         "netreceive.pd")
+    pd = subprocess.Popen(args.pd + ["-nogui", "-noaudio", "-open", patch])
+    try:
+        sock = connect(args.port, 10)
+        time.sleep(1)
+        sock.sendall(b"start;\n")
+        start = time.time()
+        sent = 0
+        while True:
+            elapsed = time.time() - start
+            if elapsed >= args.time:
+                break
+                # stay under the rate; sendall() blocks if Pd falls behind
+            ahead = sent / (args.mbps * 1e6) - elapsed
+            if ahead > 0:
+                time.sleep(ahead)
+            sock.sendall(chunk)
+            sent += len(chunk)
+        elapsed = time.time() - start
+        sock.sendall(b"stop;\n")
+        print("sent %d messages of %d bytes, %.1f MB/s" %
+              (sent // len(msg), len(msg), sent / elapsed / 1e6),
+              file=sys.stderr)
+        pd.wait(timeout=60)
+    finally:
+        if pd.poll() is None:
+            pd.kill()
+
+
+if __name__ == "__main__":
+    main()
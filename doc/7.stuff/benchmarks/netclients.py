@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Open many TCP connections to Pd and time how much CPU Pd uses meanwhile.
+
+This starts Pd with netreceive.pd, connects the given number of clients to
+it, and then, for the given time, either leaves them idle or sends "1;"
+messages at the given rate from randomly chosen clients.  Pd prints the
+number of messages it got and its CPU time in milliseconds, then quits.
+
+    python3 netclients.py pd
+    python3 netclients.py -n 1000 -r 2000 /path/to/pd -nonetthread
+
+Everything after the options is the Pd command line; "-nogui -noaudio" and
+the patch are added to it.
+"""
+
+import argparse
+import os
+import random
+import resource
+import socket
+import subprocess
+import sys
+import time
+
+
+def connect(port, timeout):
+    """connect to Pd, retrying until it listens or the timeout runs out"""
+    deadline = time.time() + timeout
+    while True:
+        try:
+            return socket.create_connection(("127.0.0.1", port))
+        except OSError:
+            if time.time() > deadline:
+                raise
+            time.sleep(0.01)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="time Pd with many TCP clients connected")
+    parser.add_argument("-n", "--clients", type=int, default=1000,
+                        help="number of TCP connections (default 1000)")
+    parser.add_argument("-r", "--rate", type=float, default=0,
+                        help="messages per second over all clients "
+                             "(default 0: idle)")
+    parser.add_argument("-t", "--time", type=float, default=10,
+                        help="seconds to measure (default 10)")
+    parser.add_argument("-p", "--port", type=int, default=3000,
+                        help="port netreceive.pd listens on (default 3000)")
+    parser.add_argument("pd", nargs=argparse.REMAINDER,
+                        help="Pd command line")
+    args = parser.parse_args()
+    if not args.pd:
+        parser.error("no Pd command given")
+
+        # Pd and we each need a file descriptor per connection
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    want = args.clients + 64
+    if soft != resource.RLIM_INFINITY and soft < want:
+        if hard != resource.RLIM_INFINITY and hard < want:
+            sys.exit("need %d open files but the limit is %d" % (want, hard))
+        resource.setrlimit(resource.RLIMIT_NOFILE, (want, hard))
+
+    patch = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         "netreceive.pd")
+    pd = subprocess.Popen(args.pd + ["-nogui", "-noaudio", "-open", patch])
+    try:
+        start = time.time()
+        socks = [connect(args.port, 10)]
+            # Pd listens with a short backlog, so don't rush it
+        while len(socks) < args.clients:
+            socks.append(connect(args.port, 10))
+            time.sleep(0.002)
+        print("%d clients connected in %.2f s" %
+              (len(socks), time.time() - start), file=sys.stderr)
+        time.sleep(1)
+
+        socks[0].sendall(b"start;\n")
+        start = time.time()
+        sent = 0
+        while time.time() - start < args.time:
+            if args.rate > 0:
+                for i in range(10):
+                    random.choice(socks).sendall(b"1;\n")
+                sent += 10
+                time.sleep(10 / args.rate)
+            else:
+                time.sleep(0.1)
+        socks[0].sendall(b"stop;\n")
+        print("sent %d messages" % sent, file=sys.stderr)
+        pd.wait(timeout=30)
+    finally:
+        if pd.poll() is None:
+            pd.kill()
+
+
+if __name__ == "__main__":
+    main()
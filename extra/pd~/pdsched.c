@@ -20,6 +20,7 @@ outputs audio and messages. */
 #endif
 
 #include "binarymsg.c"
+#include "shmtransport.c"
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__FreeBSD_kernel__)\
      || defined(__GNU__)
@@ -44,6 +45,50 @@ static t_class *pd_ambinary_class;
 #define BUFSIZE 65536
 static char *ascii_inbuf;
 
+#ifdef PDTILDE_SHM
+static t_shm sched_shm;             /* mapped if we're using shared memory */
+static t_shmbuf sched_toparent;     /* messages waiting for room in the ring */
+static t_shmbuf sched_fromparent;   /* incomplete message from the parent */
+static uint32_t sched_msgwrite;     /* message bytes we've put in */
+#endif
+
+    /* [stdout] objects send us their messages to pass on to the parent */
+static void pd_ambinary_anything(t_pd *dummy, t_symbol *s,
+    int argc, t_atom *argv)
+{
+#ifdef PDTILDE_SHM
+    if (sched_shm.s_h)
+    {
+        if (shmbuf_putmessage(&sched_toparent, s, argc, argv) < 0)
+            pd_error(0, "pd~: out of memory; message dropped");
+        return;
+    }
+#endif
+    pd_tilde_putsymbol(s, stdout);
+    for (; argc--; argv++)
+    {
+        if (argv->a_type == A_FLOAT)
+            pd_tilde_putfloat(argv->a_w.w_float, stdout);
+        else if (argv->a_type == A_SYMBOL)
+            pd_tilde_putsymbol(argv->a_w.w_symbol, stdout);
+    }
+    pd_tilde_putsemi(stdout);
+}
+
+    /* a message from the parent: the first atom names the receiver */
+static void sched_message(int n, t_atom *ap)
+{
+    if (n > 1 && ap[0].a_type == A_SYMBOL)
+    {
+        t_pd *whom = ap[0].a_w.w_symbol->s_thing;
+        if (!whom)
+            pd_error(0, "%s: no such object", ap[0].a_w.w_symbol->s_name);
+        else if (ap[1].a_type == A_SYMBOL)
+            typedmess(whom, ap[1].a_w.w_symbol, n-2, ap+2);
+        else pd_list(whom, 0, n-1, ap+1);
+    }
+}
+
 static int readasciimessage(t_binbuf *b)
 {
     int fill = 0, c;
@@ -81,6 +126,92 @@ static int readbinmessage(t_binbuf *b)
     }
 }
 
+#ifdef PDTILDE_SHM
+    /* map the segment whose file descriptor the parent gave us */
+static int sched_shmopen(int fd)
+{
+    t_shmheader *h = (t_shmheader *)mmap(0, sizeof(*h), PROT_READ,
+        MAP_SHARED, fd, 0);
+    int ninsig, noutsig, nblocks;
+    if (h == MAP_FAILED)
+        return (-1);
+    if (h->h_magic != SHM_MAGIC)
+    {
+        munmap(h, sizeof(*h));
+        return (-1);
+    }
+    ninsig = h->h_ninsig;
+    noutsig = h->h_noutsig;
+    nblocks = h->h_nblocks;
+    munmap(h, sizeof(*h));
+    return (shm_map(&sched_shm, fd, ninsig, noutsig, nblocks, 0));
+}
+
+    /* the scheduler loop when audio comes in shared memory.  We stop when
+    the parent says so or when it's gone (perhaps before we even got here,
+    so we check against the process ID it left in the header). */
+static void sched_shmloop(int chin, int chout)
+{
+    t_shm *s = &sched_shm;
+    t_shmheader *h = s->s_h;
+    t_binbuf *b = binbuf_new();
+    uint32_t nblock = 0;
+    while (1)
+    {
+        int i, j, onset = 0;
+        t_sample *sp;
+        float *fp;
+        t_atom at;
+        if (shm_wait(&h->h_inblocks, nblock + 1))
+        {
+            if (__atomic_load_n(&h->h_quit, __ATOMIC_ACQUIRE) ||
+                getppid() != (pid_t)h->h_parent)
+                    break;
+            continue;
+        }
+        if (__atomic_load_n(&h->h_quit, __ATOMIC_ACQUIRE))
+            break;
+            /* messages the parent sent before this block */
+        shmbuf_receive(&sched_fromparent, s->s_tochild, &h->h_tochildread,
+            s->s_inmsgend[nblock % h->h_nblocks]);
+        while (shmbuf_getatom(&sched_fromparent, &onset, &at))
+        {
+            if (at.a_type == A_SEMI)
+            {
+                sched_message(binbuf_getnatom(b), binbuf_getvec(b));
+                binbuf_clear(b);
+            }
+            else binbuf_add(b, 1, &at);
+        }
+        shmbuf_consume(&sched_fromparent, onset);
+        fp = shm_block(s, s->s_in, h->h_ninsig, nblock);
+        for (i = 0, sp = STUFF->st_soundin; i < chin; i++)
+            for (j = 0; j < DEFDACBLKSIZE; j++)
+                *sp++ = (i < h->h_ninsig ? fp[i * DEFDACBLKSIZE + j] : 0);
+        sched_tick();
+        sys_pollgui();
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__FreeBSD_kernel__)\
+     || defined(__GNU__)
+        pollwatchdog();
+#endif
+            /* messages from this tick, then the audio they go with */
+        sched_msgwrite = shmbuf_send(&sched_toparent, s->s_toparent,
+            &h->h_toparentread, sched_msgwrite);
+        s->s_outmsgend[nblock % h->h_nblocks] = sched_msgwrite;
+        fp = shm_block(s, s->s_out, h->h_noutsig, nblock);
+        for (i = 0, sp = STUFF->st_soundout; i < h->h_noutsig; i++)
+            for (j = 0; j < DEFDACBLKSIZE; j++)
+        {
+            if (i < chout)
+                *fp++ = *sp, *sp++ = 0;
+            else *fp++ = 0;
+        }
+        shm_post(&h->h_outblocks, ++nblock);
+    }
+    binbuf_free(b);
+}
+#endif /* PDTILDE_SHM */
+
 int pd_extern_sched(char *flags)
 {
     int i, j, chin, chout, fill = 0, c, useascii = 0;
@@ -96,9 +227,10 @@ int pd_extern_sched(char *flags)
     if (!flags || flags[0] != 'a')
     {
             /* signal to stdout object to do binary by attaching an object
-            to an obscure symbol name */
+            to an obscure symbol name.  It sends its messages to this. */
         pd_ambinary_class = class_new(gensym("pd~"), 0, 0, sizeof(t_pd),
             CLASS_PD, 0);
+        class_addanything(pd_ambinary_class, pd_ambinary_anything);
         pd_bind(&pd_ambinary_class, gensym("#pd_binary_stdio"));
             /* On Windows, set stdin and out to "binary" mode */
 #ifdef _WIN32
@@ -115,6 +247,24 @@ int pd_extern_sched(char *flags)
     /* fprintf(stderr, "Pd plug-in scheduler called, chans %d %d, sr %d\n",
         chin, chout, (int)rate); */
     sys_setchsr(chin, chout, as.a_srate);
+#ifdef PDTILDE_SHM
+        /* "s" and a file descriptor: audio and messages in shared memory */
+    if (flags && flags[0] == 's')
+    {
+        if (sched_shmopen(atoi(flags + 1)) < 0)
+        {
+            fprintf(stderr, "pd-extern: can't map shared memory\n");
+            binbuf_free(b);
+            return (1);
+        }
+            /* nothing else should go to the parent's pipe */
+        dup2(2, 1);
+        sched_shmloop(chin, chout);
+        shm_unmap(&sched_shm);
+        binbuf_free(b);
+        return (0);
+    }
+#endif
     while (useascii ? readasciimessage(b) : readbinmessage(b) )
     {
         t_atom *ap = binbuf_getvec(b);
@@ -152,15 +302,7 @@ int pd_extern_sched(char *flags)
             else putchar(A_SEMI);
             fflush(stdout);
         }
-        else if (n > 1 && ap[0].a_type == A_SYMBOL)
-        {
-            t_pd *whom = ap[0].a_w.w_symbol->s_thing;
-            if (!whom)
-                pd_error(0, "%s: no such object", ap[0].a_w.w_symbol->s_name);
-            else if (ap[1].a_type == A_SYMBOL)
-                typedmess(whom, ap[1].a_w.w_symbol, n-2, ap+2);
-            else pd_list(whom, 0, n-1, ap+1);
-        }
+        else sched_message(n, ap);
     }
     binbuf_free(b);
     return (0);
@@ -12,6 +12,10 @@ learning XCode.  */
 #define MSP
 #endif
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     /* for sched_setaffinity() */
+#endif
+
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
@@ -28,6 +32,10 @@ typedef int socklen_t;
 #include <fcntl.h>
 #include <signal.h>
 #endif
+#ifdef __linux__
+#include <sched.h>
+#define PDTILDE_AFFINITY
+#endif
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
@@ -125,6 +133,7 @@ static const char *pd_tilde_dllextent[] = {
     0};
 
 #include "binarymsg.c"
+#include "shmtransport.c"
 
 /* ------------------------ pd_tilde~ ----------------------------- */
 
@@ -159,6 +168,21 @@ typedef struct _pd_tilde
     t_pdsample **x_insig;
     t_pdsample **x_outsig;
     int x_blksize;
+#ifdef PDTILDE_SHM
+    int x_useshm;           /* pass audio in shared memory if we can */
+    int x_shmfd;
+    t_shm x_shm;            /* mapped while running with shared memory */
+    uint32_t x_inblocks;    /* audio blocks we've put in */
+    uint32_t x_outblocks;   /* ... and taken out */
+    uint32_t x_msgwrite;    /* message bytes we've put in */
+    t_shmbuf x_tochild;     /* messages waiting for room in the ring */
+    t_shmbuf x_fromchild;   /* incomplete message from the sub-process */
+#endif
+#ifdef PDTILDE_AFFINITY
+    int x_cpu;              /* CPU asked for, or -1 for none */
+    int x_cpuauto;          /* or take one from the pool ("-cpu auto") */
+    int x_pinned;           /* CPU the running sub-process is pinned to */
+#endif
 } t_pd_tilde;
 
 #ifdef MSP
@@ -430,6 +454,86 @@ int barf_getc(FILE *fd)
 
 #endif /* MAX */
 
+#ifdef PDTILDE_SHM
+static void shmbuf_free(t_shmbuf *b)
+{
+    if (b->b_vec)
+        free(b->b_vec);
+    b->b_vec = 0;
+    b->b_n = b->b_size = 0;
+}
+
+    /* find how much of a buffer is complete messages, i.e., the onset just
+    after the last semicolon, without making symbols of anything. */
+static int shmbuf_complete(t_shmbuf *b)
+{
+    const char *bp = b->b_vec, *ep = b->b_vec + b->b_n, *z;
+    int done = 0;
+    while (bp < ep)
+    {
+        if (*bp == A_PDSEMI)
+            done = (int)(++bp - b->b_vec);
+        else if (*bp == A_PDFLOAT)
+            bp += 1 + sizeof(float);
+        else if (*bp == A_PDSYMBOL)
+        {
+            if (!(z = (const char *)memchr(bp + 1, 0, ep - (bp + 1))))
+                break;
+            bp = z + 1;
+        }
+        else bp++;
+    }
+    return (done);
+}
+#endif /* PDTILDE_SHM */
+
+#ifdef PDTILDE_AFFINITY
+    /* The CPUs sub-processes are pinned to.  All the pd~ objects in this Pd
+    share one pool, so that "-cpu auto" can spread them over the cores,
+    keeping away from the one we're running on if there are enough. */
+static int *pd_tilde_cpucount;  /* sub-processes pinned to each CPU */
+static int pd_tilde_ncpu;
+
+static int pd_tilde_pin(t_pd_tilde *x)
+{
+    int cpu = x->x_cpu, i, mine;
+    x->x_pinned = -1;
+    if (cpu < 0 && !x->x_cpuauto)
+        return (-1);
+    if (!pd_tilde_cpucount)
+    {
+        pd_tilde_ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (pd_tilde_ncpu < 1)
+            pd_tilde_ncpu = 1;
+        pd_tilde_cpucount = (int *)t_getbytes(pd_tilde_ncpu * sizeof(int));
+    }
+    if (x->x_cpuauto)
+    {
+        if (pd_tilde_ncpu < 2)
+            return (-1);
+        mine = sched_getcpu();
+        for (i = 0, cpu = -1; i < pd_tilde_ncpu; i++)
+            if (cpu < 0 || pd_tilde_cpucount[i] + (i == mine) <
+                pd_tilde_cpucount[cpu] + (cpu == mine))
+                    cpu = i;
+    }
+    else if (cpu >= pd_tilde_ncpu)
+    {
+        PDERROR "pd~: no CPU %d (only %d)", cpu, pd_tilde_ncpu);
+        return (-1);
+    }
+    pd_tilde_cpucount[cpu]++;
+    return (x->x_pinned = cpu);
+}
+
+static void pd_tilde_unpin(t_pd_tilde *x)
+{
+    if (x->x_pinned >= 0)
+        pd_tilde_cpucount[x->x_pinned]--;
+    x->x_pinned = -1;
+}
+#endif /* PDTILDE_AFFINITY */
+
 static void pd_tilde_close(t_pd_tilde *x)
 {
 #ifdef _WIN32
@@ -437,6 +541,14 @@ static void pd_tilde_close(t_pd_tilde *x)
 #endif
     FILE *infd = x->x_infd, *outfd = x->x_outfd;
     x->x_infd = x->x_outfd = 0;
+#ifdef PDTILDE_SHM
+        /* the sub-process isn't reading its input; tell it to quit */
+    if (x->x_shm.s_h)
+    {
+        __atomic_store_n(&x->x_shm.s_h->h_quit, 1, __ATOMIC_SEQ_CST);
+        shm_post(&x->x_shm.s_h->h_inblocks, x->x_inblocks);
+    }
+#endif
     if (outfd)
         fclose(outfd);
     if (infd)
@@ -446,6 +558,17 @@ static void pd_tilde_close(t_pd_tilde *x)
         _cwait(&termstat, x->x_childpid, WAIT_CHILD);
 #else
         waitpid(x->x_childpid, 0, 0);
+#endif
+#ifdef PDTILDE_SHM
+    shm_unmap(&x->x_shm);
+    if (x->x_shmfd >= 0)
+        close(x->x_shmfd);
+    x->x_shmfd = -1;
+    shmbuf_free(&x->x_tochild);
+    shmbuf_free(&x->x_fromchild);
+#endif
+#ifdef PDTILDE_AFFINITY
+    pd_tilde_unpin(x);
 #endif
     binbuf_clear(x->x_binbuf);
     x->x_infd = x->x_outfd = 0;
@@ -532,7 +655,7 @@ static void pd_tilde_dostart(t_pd_tilde *x, const char *pddir,
     char cmdbuf[MAXPDSTRING], pdexecbuf[MAXPDSTRING], schedbuf[MAXPDSTRING],
         tmpbuf[MAXPDSTRING], patchdir[MAXPDSTRING];
     char *execargv[FIXEDARG+MAXARG+1], ninsigstr[20], noutsigstr[20],
-        sampleratestr[40];
+        sampleratestr[40], flagsstr[20];
     const char**dllextent;
     struct stat statbuf;
     x->x_childpid = -1;
@@ -607,6 +730,35 @@ gotone:
     execargv[2] = schedbuf;
     execargv[3] = "-extraflags";
     execargv[4] = (x->x_binary ? "b" : "a");
+#ifdef PDTILDE_SHM
+        /* make a shared memory segment for the sub-process to inherit.  It
+        holds "fifo" blocks of input to start with, plus room for the one
+        we're about to put in and one more for slack. */
+    x->x_shmfd = -1;
+    if (x->x_useshm && x->x_binary)
+    {
+        int nblocks = (fifo > 0 ? fifo : 0) + 2;
+        if ((x->x_shmfd = (int)syscall(SYS_memfd_create, "pd~",
+            MFD_CLOEXEC)) < 0 ||
+            ftruncate(x->x_shmfd, shm_size(ninsig, noutsig, nblocks)) < 0 ||
+            shm_map(&x->x_shm, x->x_shmfd, ninsig, noutsig, nblocks, 1) < 0)
+        {
+            post("pd~: can't make shared memory (%s); using pipes",
+                strerror(errno));
+            if (x->x_shmfd >= 0)
+                close(x->x_shmfd);
+            x->x_shmfd = -1;
+        }
+        else
+        {
+            snprintf(flagsstr, sizeof(flagsstr), "s%d", x->x_shmfd);
+            execargv[4] = flagsstr;
+            x->x_inblocks = (fifo > 0 ? fifo : 0);
+            x->x_outblocks = x->x_msgwrite = 0;
+            x->x_shm.s_h->h_inblocks.c_n = x->x_inblocks;
+        }
+    }
+#endif
     execargv[5] = "-path";
     execargv[6] = patchdir;
     execargv[7] = "-inchannels";
@@ -694,6 +846,9 @@ gotone:
         _close(stdoutwas);
     }
 #else /* _WIN32 */
+#ifdef PDTILDE_AFFINITY
+    pd_tilde_pin(x);
+#endif
     if ((pid = fork()) < 0)
     {
         PDERROR "pd~: can't fork");
@@ -720,6 +875,20 @@ gotone:
             close(pipe1[1]);
         if (pipe2[0] >= 2)
             close(pipe2[0]);
+#ifdef PDTILDE_SHM
+        if (x->x_shmfd >= 0)
+            fcntl(x->x_shmfd, F_SETFD, 0);
+#endif
+#ifdef PDTILDE_AFFINITY
+        if (x->x_pinned >= 0)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(x->x_pinned, &cpuset);
+            if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0)
+                perror("pd~: sched_setaffinity");
+        }
+#endif
         execv(cmdbuf, execargv);
         _exit(1);
     }
@@ -737,6 +906,15 @@ gotone:
     outfd = fdopen(pipe1[1], "w");
     infd = fdopen(pipe2[0], "r");
     x->x_childpid = pid;
+#ifdef PDTILDE_SHM
+        /* the shared memory starts out holding "fifo" blocks of silence */
+    if (x->x_shm.s_h)
+    {
+        x->x_outfd = outfd;
+        x->x_infd = infd;
+        return;
+    }
+#endif
     for (i = 0; i < fifo; i++)
         if (x->x_binary)
     {
@@ -763,6 +941,15 @@ fail2:
     close(pipe1[0]);
     close(pipe1[1]);
 fail1:
+#ifdef PDTILDE_SHM
+    shm_unmap(&x->x_shm);
+    if (x->x_shmfd >= 0)
+        close(x->x_shmfd);
+    x->x_shmfd = -1;
+#endif
+#ifdef PDTILDE_AFFINITY
+    pd_tilde_unpin(x);
+#endif
     x->x_infd = x->x_outfd = 0;
     x->x_childpid = -1;
     post("pd~ startup failed");
@@ -789,6 +976,58 @@ void pd_empty(int infd)
 
 static int nperfed = 0;
 
+#ifdef PDTILDE_SHM
+    /* pd_tilde_doperf() below, through shared memory.  Returns 0 if the
+    sub-process has gone away. */
+static int pd_tilde_shmperf(t_pd_tilde *x, int n)
+{
+    t_shm *s = &x->x_shm;
+    t_shmheader *h = s->s_h;
+    int i, j, onset = 0, complete;
+    float *fp;
+    t_atom at;
+        /* first any messages, which the sub-process will take before this
+        block, then the block itself */
+    x->x_msgwrite = shmbuf_send(&x->x_tochild, s->s_tochild,
+        &h->h_tochildread, x->x_msgwrite);
+    s->s_inmsgend[x->x_inblocks % h->h_nblocks] = x->x_msgwrite;
+    fp = shm_block(s, s->s_in, x->x_ninsig, x->x_inblocks);
+    for (i = 0; i < x->x_ninsig; i++)
+    {
+        t_pdsample *sp = x->x_insig[i];
+        for (j = 0; j < n; j++)
+            *fp++ = *sp++;
+        for (; j < DEFDACBLKSIZE; j++)
+            *fp++ = 0;
+    }
+    shm_post(&h->h_inblocks, ++x->x_inblocks);
+        /* wait for the output that's due now */
+    while (shm_wait(&h->h_outblocks, x->x_outblocks + 1))
+        if (waitpid(x->x_childpid, 0, WNOHANG) == x->x_childpid)
+    {
+        x->x_childpid = -1;
+        PDERROR "pd~: subprocess exited");
+        pd_tilde_close(x);
+        return (0);
+    }
+    fp = shm_block(s, s->s_out, x->x_noutsig, x->x_outblocks);
+    for (i = 0; i < x->x_noutsig; i++, fp += DEFDACBLKSIZE)
+        for (j = 0; j < n; j++)
+            x->x_outsig[i][j] = fp[j];
+    shmbuf_receive(&x->x_fromchild, s->s_toparent, &h->h_toparentread,
+        s->s_outmsgend[x->x_outblocks % h->h_nblocks]);
+    x->x_outblocks++;
+        /* pd_tilde_tick() wants whole messages; keep any unfinished one */
+    complete = shmbuf_complete(&x->x_fromchild);
+    while (onset < complete && shmbuf_getatom(&x->x_fromchild, &onset, &at))
+        binbuf_add(x->x_binbuf, 1, &at);
+    shmbuf_consume(&x->x_fromchild, complete);
+    if (complete)
+        clock_delay(x->x_clock, 0);
+    return (1);
+}
+#endif
+
 static void pd_tilde_doperf(t_pd_tilde *x)
 {
     int n = x->x_blksize, i, j, nsigs, numbuffill = 0, c;
@@ -800,6 +1039,14 @@ static void pd_tilde_doperf(t_pd_tilde *x)
 #endif
     if (!x->x_infd)
         goto zeroit;
+#ifdef PDTILDE_SHM
+    if (x->x_shm.s_h)
+    {
+        if (!pd_tilde_shmperf(x, n))
+            goto zeroit;
+        return;
+    }
+#endif
     if (x->x_binary)
     {
         pd_tilde_putsemi(x->x_outfd);
@@ -1068,6 +1315,14 @@ static void pd_tilde_anything(t_pd_tilde *x, t_symbol *s,
     char msgbuf[MAXPDSTRING];
     if (!x->x_outfd)
         return;
+#ifdef PDTILDE_SHM
+    if (x->x_shm.s_h)
+    {
+        if (shmbuf_putmessage(&x->x_tochild, s, argc, argv) < 0)
+            PDERROR "pd~: out of memory; message dropped");
+        return;
+    }
+#endif
     if (x->x_binary)
     {
         pd_tilde_putsymbol(s, x->x_outfd);
@@ -1095,7 +1350,8 @@ static void pd_tilde_anything(t_pd_tilde *x, t_symbol *s,
 static void *pd_tilde_new(t_symbol *s, int argc, t_atom *argv)
 {
     t_pd_tilde *x = (t_pd_tilde *)pd_new(pd_tilde_class);
-    int ninsig = 2, noutsig = 2, j, fifo = 5, binary = 1;
+    int ninsig = 2, noutsig = 2, j, fifo = 5, binary = 1, useshm = 1,
+        cpu = -1, cpuauto = 0;
     t_float sr = sys_getsr();
     t_pdsample **g;
     t_symbol *pddir = sys_libdir,
@@ -1138,6 +1394,24 @@ static void *pd_tilde_new(t_symbol *s, int argc, t_atom *argv)
             binary = 0;
             argc--; argv++;
         }
+        else if (!strcmp(firstarg->s_name, "-pipe"))
+        {
+            useshm = 0;
+            argc--; argv++;
+        }
+        else if (!strcmp(firstarg->s_name, "-cpu") && argc > 1)
+        {
+            if (argv[1].a_type == A_SYMBOL &&
+                !strcmp(argv[1].a_w.w_symbol->s_name, "auto"))
+                    cpuauto = 1;
+            else if ((cpu = atom_getfloatarg(1, argc, argv)) < 0 ||
+                argv[1].a_type != A_FLOAT)
+            {
+                PDERROR "pd~: -cpu needs a CPU number or 'auto'");
+                cpu = -1;
+            }
+            argc -= 2; argv += 2;
+        }
         else break;
     }
 
@@ -1146,7 +1420,7 @@ static void *pd_tilde_new(t_symbol *s, int argc, t_atom *argv)
         pd_error(x,
 "usage: pd~ [-sr #] [-ninsig #] [-noutsig #] [-fifo #] [-pddir <>]");
         post(
-"... [-scheddir <>]");
+"... [-scheddir <>] [-ascii] [-pipe] [-cpu # | auto]");
     }
 
     x->x_clock = clock_new(x, (t_method)pd_tilde_tick);
@@ -1165,6 +1439,18 @@ static void *pd_tilde_new(t_symbol *s, int argc, t_atom *argv)
     x->x_canvas = canvas_getcurrent();
     x->x_binbuf = binbuf_new();
     x->x_binary = binary;
+#ifdef PDTILDE_SHM
+    x->x_useshm = useshm;
+    x->x_shmfd = -1;
+#endif
+#ifdef PDTILDE_AFFINITY
+    x->x_cpu = cpu;
+    x->x_cpuauto = cpuauto;
+    x->x_pinned = -1;
+#else
+    if (cpu >= 0 || cpuauto)
+        post("pd~: -cpu not supported on this platform; ignored");
+#endif
     for (j = 1, g = x->x_insig; j < ninsig; j++, g++)
         inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
     x->x_outlet1 = outlet_new(&x->x_obj, 0);
@@ -0,0 +1,324 @@
+/* shared-memory transport between pd~ and its sub-process.
+
+This is #included by both pd~.c and pdsched.c, as binarymsg.c is.  On Linux,
+instead of sending every sample through a pipe, the two processes share a
+memory segment holding a ring of audio blocks in each direction and a ring of
+messages in each direction.  Messages are in the binary format of
+binarymsg.c.  Each audio block records how far the message ring had been
+written when the block was put in, so that the reader sees messages in the
+same order relative to audio as it would through the pipe.
+
+Each side spins briefly and then sleeps on a futex when it has to wait for
+the other; a side that has something to put in only makes a system call if
+the other one is actually asleep.  Sleeps time out now and then so that
+either side can find out whether the other is gone.
+
+The segment is an unlinked memfd that the sub-process inherits; its file
+descriptor is passed in the "-extraflags" argument. */
+
+#if defined(__linux__) && !defined(PDTILDE_NOSHM)
+#define PDTILDE_SHM
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#define SHM_MAGIC 0x7064747e    /* "~tdp" */
+#define SHM_MSGSIZE 65536       /* size of each message ring, power of two */
+#define SHM_SPIN 4000           /* polls before sleeping in the kernel */
+#define SHM_TIMEOUT 500         /* msec to sleep before checking on the peer */
+
+    /* a counter, with its own cache line to avoid false sharing */
+typedef struct _shmcounter
+{
+    uint32_t c_n;
+    int32_t c_sleeping;         /* the side waiting for c_n is in the kernel */
+    char c_pad[56];
+} t_shmcounter;
+
+typedef struct _shmheader
+{
+    uint32_t h_magic;
+    int32_t h_ninsig;
+    int32_t h_noutsig;
+    int32_t h_nblocks;          /* audio blocks in each ring */
+    int32_t h_quit;             /* parent is closing */
+    int32_t h_parent;           /* parent's process ID */
+    char h_pad[40];
+    t_shmcounter h_inblocks;    /* blocks the parent has put in */
+    t_shmcounter h_outblocks;   /* blocks the sub-process has put out */
+    t_shmcounter h_tochildread; /* message bytes the sub-process has taken */
+    t_shmcounter h_toparentread;    /* ... and the parent */
+} t_shmheader;
+
+    /* one process's view of the segment */
+typedef struct _shm
+{
+    t_shmheader *s_h;
+    size_t s_size;
+    uint32_t *s_inmsgend;       /* end of messages for each input block */
+    uint32_t *s_outmsgend;      /* ... and output block */
+    char *s_tochild;            /* message rings */
+    char *s_toparent;
+    float *s_in;                /* audio rings */
+    float *s_out;
+} t_shm;
+
+    /* a growable buffer for messages on their way in or out */
+typedef struct _shmbuf
+{
+    char *b_vec;
+    int b_n;
+    int b_size;
+} t_shmbuf;
+
+static size_t shm_size(int ninsig, int noutsig, int nblocks)
+{
+    return (sizeof(t_shmheader) + 2 * nblocks * sizeof(uint32_t) +
+        2 * SHM_MSGSIZE + (size_t)nblocks * (ninsig + noutsig) *
+            DEFDACBLKSIZE * sizeof(float));
+}
+
+    /* map a segment of the given size.  If "init", it's a new one and we
+    fill in the header. */
+static int shm_map(t_shm *s, int fd, int ninsig, int noutsig, int nblocks,
+    int init)
+{
+    char *p;
+    s->s_size = shm_size(ninsig, noutsig, nblocks);
+    if ((p = (char *)mmap(0, s->s_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0)) == MAP_FAILED)
+    {
+        s->s_h = 0;
+        return (-1);
+    }
+    s->s_h = (t_shmheader *)p;
+    if (init)
+    {
+        s->s_h->h_magic = SHM_MAGIC;
+        s->s_h->h_ninsig = ninsig;
+        s->s_h->h_noutsig = noutsig;
+        s->s_h->h_nblocks = nblocks;
+        s->s_h->h_parent = (int32_t)getpid();
+    }
+    p += sizeof(t_shmheader);
+    s->s_inmsgend = (uint32_t *)p;
+    s->s_outmsgend = s->s_inmsgend + nblocks;
+    p += 2 * nblocks * sizeof(uint32_t);
+    s->s_tochild = p;
+    s->s_toparent = p + SHM_MSGSIZE;
+    p += 2 * SHM_MSGSIZE;
+    s->s_in = (float *)p;
+    s->s_out = s->s_in + (size_t)nblocks * ninsig * DEFDACBLKSIZE;
+    return (0);
+}
+
+static void shm_unmap(t_shm *s)
+{
+    if (s->s_h)
+        munmap(s->s_h, s->s_size);
+    s->s_h = 0;
+}
+
+static float *shm_block(t_shm *s, float *ring, int nsig, uint32_t n)
+{
+    return (ring + (size_t)(n % s->s_h->h_nblocks) * nsig * DEFDACBLKSIZE);
+}
+
+    /* set a counter and wake up whoever is waiting for it */
+static void shm_post(t_shmcounter *c, uint32_t n)
+{
+    __atomic_store_n(&c->c_n, n, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&c->c_sleeping, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &c->c_n, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+    /* wait until a counter reaches n.  Returns 0 if it did, or 1 if we timed
+    out so that the caller can check whether to carry on waiting. */
+static int shm_wait(t_shmcounter *c, uint32_t n)
+{
+    static int nspin = -1;
+    struct timespec ts;
+    uint32_t was;
+    int i;
+        /* spinning only helps if the other side can run meanwhile */
+    if (nspin < 0)
+        nspin = (sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPIN : 0);
+    for (i = 0; i < nspin; i++)
+    {
+        if ((int32_t)(__atomic_load_n(&c->c_n, __ATOMIC_ACQUIRE) - n) >= 0)
+            return (0);
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    ts.tv_sec = SHM_TIMEOUT / 1000;
+    ts.tv_nsec = (SHM_TIMEOUT % 1000) * 1000000;
+        /* say we're going to sleep, then look again, so that the poster
+        either sees the flag or we see its new value */
+    __atomic_store_n(&c->c_sleeping, 1, __ATOMIC_SEQ_CST);
+    was = __atomic_load_n(&c->c_n, __ATOMIC_SEQ_CST);
+    if ((int32_t)(was - n) < 0)
+        syscall(SYS_futex, &c->c_n, FUTEX_WAIT, was, &ts, 0, 0);
+    __atomic_store_n(&c->c_sleeping, 0, __ATOMIC_SEQ_CST);
+    return ((int32_t)(__atomic_load_n(&c->c_n, __ATOMIC_ACQUIRE) - n) < 0);
+}
+
+    /* make room for n more bytes.  If we can't, leave the buffer as it was
+    and return -1. */
+static int shmbuf_reserve(t_shmbuf *b, int n)
+{
+    if (b->b_n + n > b->b_size)
+    {
+        int newsize = (b->b_size ? 2 * b->b_size : 1024);
+        char *vec;
+        while (newsize < b->b_n + n)
+            newsize *= 2;
+        if (!(vec = (char *)realloc(b->b_vec, newsize)))
+            return (-1);
+        b->b_vec = vec;
+        b->b_size = newsize;
+    }
+    return (0);
+}
+
+static int shmbuf_putfloat(t_shmbuf *b, float f)
+{
+    if (shmbuf_reserve(b, 1 + sizeof(f)) < 0)
+        return (-1);
+    b->b_vec[b->b_n] = A_PDFLOAT;
+    memcpy(b->b_vec + b->b_n + 1, &f, sizeof(f));
+    b->b_n += 1 + sizeof(f);
+    return (0);
+}
+
+static int shmbuf_putsymbol(t_shmbuf *b, t_symbol *s)
+{
+    int n = (int)strlen(s->s_name) + 1;
+    if (shmbuf_reserve(b, 1 + n) < 0)
+        return (-1);
+    b->b_vec[b->b_n] = A_PDSYMBOL;
+    memcpy(b->b_vec + b->b_n + 1, s->s_name, n);
+    b->b_n += 1 + n;
+    return (0);
+}
+
+    /* add a message.  If we run out of memory we drop all of it, so as not
+    to leave half a message in the buffer, and return -1. */
+static int shmbuf_putmessage(t_shmbuf *b, t_symbol *s, int argc,
+    t_atom *argv)
+{
+    int onset = b->b_n, bad = shmbuf_putsymbol(b, s);
+    for (; !bad && argc--; argv++)
+    {
+        if (argv->a_type == A_FLOAT)
+            bad = shmbuf_putfloat(b, argv->a_w.w_float);
+        else if (argv->a_type == A_SYMBOL)
+            bad = shmbuf_putsymbol(b, argv->a_w.w_symbol);
+    }
+    if (bad || shmbuf_reserve(b, 1) < 0)
+    {
+        b->b_n = onset;
+        return (-1);
+    }
+    b->b_vec[b->b_n++] = A_PDSEMI;
+    return (0);
+}
+
+    /* move as much of a buffer into a message ring as fits.  "write" is the
+    writer's count of bytes put in so far; we return the new one. */
+static uint32_t shmbuf_send(t_shmbuf *b, char *ring, t_shmcounter *read,
+    uint32_t write)
+{
+    uint32_t room = SHM_MSGSIZE -
+        (write - __atomic_load_n(&read->c_n, __ATOMIC_ACQUIRE)),
+        n = ((uint32_t)b->b_n < room ? (uint32_t)b->b_n : room),
+        onset = write & (SHM_MSGSIZE-1);
+    if (!n)
+        return (write);
+    if (n <= SHM_MSGSIZE - onset)
+        memcpy(ring + onset, b->b_vec, n);
+    else
+    {
+        memcpy(ring + onset, b->b_vec, SHM_MSGSIZE - onset);
+        memcpy(ring, b->b_vec + (SHM_MSGSIZE - onset),
+            n - (SHM_MSGSIZE - onset));
+    }
+    memmove(b->b_vec, b->b_vec + n, b->b_n - n);
+    b->b_n -= n;
+    return (write + n);
+}
+
+    /* take the bytes from "*readp" up to "end" out of a message ring and add
+    them to a buffer, which may hold an incomplete atom from before.  If
+    we're out of memory we leave them in the ring to take with a later
+    block. */
+static void shmbuf_receive(t_shmbuf *b, const char *ring, t_shmcounter *read,
+    uint32_t end)
+{
+    uint32_t start = read->c_n, n = end - start,
+        onset = start & (SHM_MSGSIZE-1);
+    if (!n || shmbuf_reserve(b, n) < 0)
+        return;
+    if (n <= SHM_MSGSIZE - onset)
+        memcpy(b->b_vec + b->b_n, ring + onset, n);
+    else
+    {
+        memcpy(b->b_vec + b->b_n, ring + onset, SHM_MSGSIZE - onset);
+        memcpy(b->b_vec + b->b_n + (SHM_MSGSIZE - onset), ring,
+            n - (SHM_MSGSIZE - onset));
+    }
+    b->b_n += n;
+    __atomic_store_n(&read->c_n, end, __ATOMIC_RELEASE);
+}
+
+    /* parse the next atom out of a buffer, starting at "*onsetp".  Returns 0
+    if the buffer ends in the middle of it, in which case the caller should
+    keep the rest for later with shmbuf_consume(). */
+static int shmbuf_getatom(t_shmbuf *b, int *onsetp, t_atom *ap)
+{
+    const char *bp = b->b_vec + *onsetp, *ep = b->b_vec + b->b_n, *z;
+    float f;
+    if (bp >= ep)
+        return (0);
+    switch (*bp)
+    {
+    case A_PDSEMI:
+        SETSEMI(ap);
+        *onsetp += 1;
+        return (1);
+    case A_PDFLOAT:
+        if (ep - bp < 1 + (int)sizeof(f))
+            return (0);
+        memcpy(&f, bp + 1, sizeof(f));
+        SETFLOAT(ap, f);
+        *onsetp += 1 + sizeof(f);
+        return (1);
+    case A_PDSYMBOL:
+        if (!(z = (const char *)memchr(bp + 1, 0, ep - (bp + 1))))
+            return (0);
+        SETSYMBOL(ap, gensym(bp + 1));
+        *onsetp += (int)(z + 1 - bp);
+        return (1);
+    default:    /* can't happen; skip the byte */
+        *onsetp += 1;
+        return (shmbuf_getatom(b, onsetp, ap));
+    }
+}
+
+static void shmbuf_consume(t_shmbuf *b, int n)
+{
+    memmove(b->b_vec, b->b_vec + n, b->b_n - n);
+    b->b_n -= n;
+}
+
+#endif /* __linux__ */
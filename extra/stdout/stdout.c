@@ -83,21 +83,6 @@ static void stdout_binary(t_stdout *x, int argc, t_atom *argv)
         fflush(stdout);
 }
 
-static void pd_tilde_putfloat(float f, FILE *fd)
-{
-    putc(A_FLOAT, fd);
-    fwrite(&f, sizeof(f), 1, fd);
-}
-
-static void pd_tilde_putsymbol(t_symbol *s, FILE *fd)
-{
-    const char *sp = s->s_name;
-    putc(A_SYMBOL, fd);
-    do
-        putc(*sp, fd);
-    while (*sp++);
-}
-
 static void stdout_anything(t_stdout *x, t_symbol *s, int argc, t_atom *argv)
 {
     char msgbuf[MAXPDSTRING], *sp, *ep = msgbuf+MAXPDSTRING;
@@ -114,15 +99,11 @@ static void stdout_anything(t_stdout *x, t_symbol *s, int argc, t_atom *argv)
     }
     else if (x->x_mode == MODE_PDTILDE)
     {
-        pd_tilde_putsymbol(s, stdout);
-        for (; argc--; argv++)
-        {
-            if (argv->a_type == A_FLOAT)
-                pd_tilde_putfloat(argv->a_w.w_float, stdout);
-            else if (argv->a_type == A_SYMBOL)
-                pd_tilde_putsymbol(argv->a_w.w_symbol, stdout);
-        }
-        putc(A_SEMI, stdout);
+            /* the pd~ scheduler passes it on, through stdout or shared
+            memory as the case may be */
+        t_pd *sched = gensym("#pd_binary_stdio")->s_thing;
+        if (sched)
+            typedmess(sched, s, argc, argv);
         if (x->x_flush)
             fflush(stdout);
         return;
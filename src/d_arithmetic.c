@@ -10,6 +10,65 @@ to reset the value.
 
 #include "m_pd.h"
 
+/* -------------------------- constant inputs -------------------------- */
+
+/* Inputs that are constant over the DSP block (the output of sig~, say,
+or an unconnected inlet) are recognized via signal_getscalar().  If both
+inputs are constant we compute the output once per block and pass it on as
+a constant too; if one is, we use the scalar version's perform routine.
+Division is left alone since, compiled with -ffast-math, we can't be sure
+to get exactly the same result as the vector routines do. */
+
+#define BINOP_PLUS 0
+#define BINOP_MINUS 1
+#define BINOP_TIMES 2
+#define BINOP_MAX 3
+#define BINOP_MIN 4
+
+static t_int *binop_constant_perform(t_int *w)
+{
+    t_sample f = *(t_float *)(w[1]), g = *(t_float *)(w[2]);
+    t_float *out = (t_float *)(w[3]);
+    switch (w[4])
+    {
+    case BINOP_PLUS: *out = f + g; break;
+    case BINOP_MINUS: *out = f - g; break;
+    case BINOP_TIMES: *out = f * g; break;
+    case BINOP_MAX: *out = (f > g ? f : g); break;
+    default: *out = (f < g ? f : g); break;
+    }
+    return (w+5);
+}
+
+static void binop_constant_dsp(t_float *f, t_float *g, t_signal *out, int op)
+{
+    dsp_add(binop_constant_perform, 4, f, g, &out->s_scalarvalue, (t_int)op);
+    dsp_add_scalarsignal(&out->s_scalarvalue, out);
+}
+
+    /* try this first in the DSP methods of the two-signal versions.  If
+    "commutes" is set the constant may be on either side; otherwise only
+    the right one.  Returns 0 if we couldn't do anything. */
+static int binop_dsp(t_signal **sp, int op, t_perfroutine scalarperform,
+    t_perfroutine scalarperf8, int commutes)
+{
+    t_signal *in = sp[0], *scalar = sp[1];
+    int n = sp[0]->s_n;
+    if (sp[0]->s_scalar && sp[1]->s_scalar)
+    {
+        t_float *f = signal_getscalar(sp[0]);
+        binop_constant_dsp(f, signal_getscalar(sp[1]), sp[2], op);
+        return (1);
+    }
+    if (sp[0]->s_scalar && commutes)
+        in = sp[1], scalar = sp[0];
+    else if (!sp[1]->s_scalar)
+        return (0);
+    dsp_add((n&7 ? scalarperform : scalarperf8), 4, in->s_vec,
+        signal_getscalar(scalar), sp[2]->s_vec, (t_int)n);
+    return (1);
+}
+
 /* ----------------------------- plus ----------------------------- */
 static t_class *plus_class, *scalarplus_class;
 
@@ -77,12 +136,16 @@ t_int *scalarplus_perf8(t_int *w)
 
 static void plus_dsp(t_plus *x, t_signal **sp)
 {
-    dsp_add_plus(sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_n);
+    if (!binop_dsp(sp, BINOP_PLUS, scalarplus_perform, scalarplus_perf8, 1))
+        dsp_add_plus(sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_n);
 }
 
 static void scalarplus_dsp(t_scalarplus *x, t_signal **sp)
 {
-    if (sp[0]->s_n&7)
+    if (sp[0]->s_scalar)
+        binop_constant_dsp(signal_getscalar(sp[0]), &x->x_g, sp[1],
+            BINOP_PLUS);
+    else if (sp[0]->s_n&7)
         dsp_add(scalarplus_perform, 4, sp[0]->s_vec, &x->x_g,
             sp[1]->s_vec, (t_int)sp[0]->s_n);
     else
@@ -202,6 +265,8 @@ t_int *scalarminus_perf8(t_int *w)
 
 static void minus_dsp(t_minus *x, t_signal **sp)
 {
+    if (binop_dsp(sp, BINOP_MINUS, scalarminus_perform, scalarminus_perf8, 0))
+        return;
     if (sp[0]->s_n&7)
         dsp_add(minus_perform, 4,
             sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
@@ -212,7 +277,10 @@ static void minus_dsp(t_minus *x, t_signal **sp)
 
 static void scalarminus_dsp(t_scalarminus *x, t_signal **sp)
 {
-    if (sp[0]->s_n&7)
+    if (sp[0]->s_scalar)
+        binop_constant_dsp(signal_getscalar(sp[0]), &x->x_g, sp[1],
+            BINOP_MINUS);
+    else if (sp[0]->s_n&7)
         dsp_add(scalarminus_perform, 4, sp[0]->s_vec, &x->x_g,
             sp[1]->s_vec, (t_int)sp[0]->s_n);
     else
@@ -333,6 +401,8 @@ t_int *scalartimes_perf8(t_int *w)
 
 static void times_dsp(t_times *x, t_signal **sp)
 {
+    if (binop_dsp(sp, BINOP_TIMES, scalartimes_perform, scalartimes_perf8, 1))
+        return;
     if (sp[0]->s_n&7)
         dsp_add(times_perform, 4,
             sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
@@ -343,7 +413,10 @@ static void times_dsp(t_times *x, t_signal **sp)
 
 static void scalartimes_dsp(t_scalartimes *x, t_signal **sp)
 {
-    if (sp[0]->s_n&7)
+    if (sp[0]->s_scalar)
+        binop_constant_dsp(signal_getscalar(sp[0]), &x->x_g, sp[1],
+            BINOP_TIMES);
+    else if (sp[0]->s_n&7)
         dsp_add(scalartimes_perform, 4, sp[0]->s_vec, &x->x_g,
             sp[1]->s_vec, (t_int)sp[0]->s_n);
     else
@@ -617,6 +690,8 @@ t_int *scalarmax_perf8(t_int *w)
 
 static void max_dsp(t_max *x, t_signal **sp)
 {
+    if (binop_dsp(sp, BINOP_MAX, scalarmax_perform, scalarmax_perf8, 0))
+        return;
     if (sp[0]->s_n&7)
         dsp_add(max_perform, 4,
             sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
@@ -627,7 +702,10 @@ static void max_dsp(t_max *x, t_signal **sp)
 
 static void scalarmax_dsp(t_scalarmax *x, t_signal **sp)
 {
-    if (sp[0]->s_n&7)
+    if (sp[0]->s_scalar)
+        binop_constant_dsp(&x->x_g, signal_getscalar(sp[0]), sp[1],
+            BINOP_MAX);
+    else if (sp[0]->s_n&7)
         dsp_add(scalarmax_perform, 4, sp[0]->s_vec, &x->x_g,
             sp[1]->s_vec, (t_int)sp[0]->s_n);
     else
@@ -759,6 +837,8 @@ t_int *scalarmin_perf8(t_int *w)
 
 static void min_dsp(t_min *x, t_signal **sp)
 {
+    if (binop_dsp(sp, BINOP_MIN, scalarmin_perform, scalarmin_perf8, 0))
+        return;
     if (sp[0]->s_n&7)
         dsp_add(min_perform, 4,
             sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
@@ -769,7 +849,10 @@ static void min_dsp(t_min *x, t_signal **sp)
 
 static void scalarmin_dsp(t_scalarmin *x, t_signal **sp)
 {
-    if (sp[0]->s_n&7)
+    if (sp[0]->s_scalar)
+        binop_constant_dsp(&x->x_g, signal_getscalar(sp[0]), sp[1],
+            BINOP_MIN);
+    else if (sp[0]->s_n&7)
         dsp_add(scalarmin_perform, 4, sp[0]->s_vec, &x->x_g,
             sp[1]->s_vec, (t_int)sp[0]->s_n);
     else
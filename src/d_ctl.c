@@ -25,7 +25,7 @@ static void sig_tilde_float(t_sig *x, t_float f)
 
 static void sig_tilde_dsp(t_sig *x, t_signal **sp)
 {
-    dsp_add_scalarcopy(&x->x_f, sp[0]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add_scalarsignal(&x->x_f, sp[0]);
 }
 
 static void *sig_tilde_new(t_floatarg f)
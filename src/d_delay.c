@@ -36,6 +36,14 @@ typedef struct _sigdelwrite
 #define XTRASAMPS 4
 #define SAMPBLK 4
 
+/* The delay line holds two copies of the "nsamps" samples, the second one
+starting nsamps points after the first, preceded by XTRASAMPS guard points
+copying the end of the line.  Any index between 0 and 2*nsamps + XTRASAMPS
+thus reads the same as the one nsamps points further on (or back), so that
+readers can subtract their delay from the write phase plus nsamps without
+checking for wraparound. */
+#define DELBUFSIZE(nsamps) (2 * (nsamps) + XTRASAMPS)
+
 static void sigdelwrite_updatesr(t_sigdelwrite *x, t_float sr) /* added by Mathieu Bouchard */
 {
     int nsamps = x->x_deltime * sr * (t_float)(0.001f);
@@ -45,8 +53,8 @@ static void sigdelwrite_updatesr(t_sigdelwrite *x, t_float sr) /* added by Mathi
     if (x->x_cspace.c_n != nsamps)
     {
         x->x_cspace.c_vec = (t_sample *)resizebytes(x->x_cspace.c_vec,
-            (x->x_cspace.c_n + XTRASAMPS) * sizeof(t_sample),
-            (nsamps + XTRASAMPS) * sizeof(t_sample));
+            DELBUFSIZE(x->x_cspace.c_n) * sizeof(t_sample),
+            DELBUFSIZE(nsamps) * sizeof(t_sample));
         x->x_cspace.c_n = nsamps;
         x->x_cspace.c_phase = XTRASAMPS;
     }
@@ -55,7 +63,8 @@ static void sigdelwrite_updatesr(t_sigdelwrite *x, t_float sr) /* added by Mathi
 static void sigdelwrite_clear (t_sigdelwrite *x) /* added by Orm Finnendahl */
 {
   if (x->x_cspace.c_n > 0)
-    memset(x->x_cspace.c_vec, 0, sizeof(t_sample)*(x->x_cspace.c_n + XTRASAMPS));
+    memset(x->x_cspace.c_vec, 0,
+        sizeof(t_sample) * DELBUFSIZE(x->x_cspace.c_n));
 }
 
 
@@ -106,6 +115,7 @@ static t_int *sigdelwrite_perform(t_int *w)
         t_sample f = *in++;
         if (PD_BIGORSMALL(f))
             f = 0;
+        bp[nsamps] = f;
         *bp++ = f;
         if (bp == ep)
         {
@@ -133,7 +143,7 @@ static void sigdelwrite_free(t_sigdelwrite *x)
 {
     pd_unbind(&x->x_obj.ob_pd, x->x_sym);
     freebytes(x->x_cspace.c_vec,
-        (x->x_cspace.c_n + XTRASAMPS) * sizeof(t_sample));
+        DELBUFSIZE(x->x_cspace.c_n) * sizeof(t_sample));
 }
 
 static void sigdelwrite_setup(void)
@@ -203,7 +213,10 @@ static t_int *sigdelread_perform(t_int *w)
     if (phase < 0) phase += nsamps;
     bp = vp + phase;
 
-    while (n--)
+        /* the mirrored copy lets us read a whole block without wrapping */
+    if (n <= nsamps)
+        memcpy(out, bp, n * sizeof(t_sample));
+    else while (n--)
     {
         *out++ = *bp++;
         if (bp == ep) bp -= nsamps;
@@ -247,6 +260,15 @@ static void sigdelread_setup(void)
 
 
 /* ----------------------------- vd~ / delread4~ ----------------------------- */
+
+/* An optional second argument gives a number of "taps", each with its own
+delay-time inlet and signal outlet, all reading the same delay line in one
+perform routine.  We first compute the read positions and interpolation
+fractions of all taps for the whole block in one branchless loop, then
+interpolate (outputs may share memory with other taps' inputs, so all
+inputs are read before any output is written).  Thanks to the mirrored delay line neither loop has to check
+for wraparound. */
+
 static t_class *sigvd_class;
 
 typedef struct _sigvd
@@ -255,94 +277,147 @@ typedef struct _sigvd
     t_symbol *x_sym;
     t_float x_sr;       /* samples per msec */
     int x_zerodel;      /* 0 or vecsize depending on read/write order */
+    int x_ntaps;        /* number of taps (inlet/outlet pairs) */
+    t_sample **x_invec; /* input and output vectors, one of each per tap */
+    t_sample **x_outvec;
+    int *x_idel;        /* integer part of delay for each tap and sample */
+    t_sample *x_frac;   /* and fractional part */
+    int x_bufsize;      /* allocated size of x_idel and x_frac */
     t_float x_f;
 } t_sigvd;
 
-static void *sigvd_new(t_symbol *s)
+static void *sigvd_new(t_symbol *s, t_floatarg f)
 {
     t_sigvd *x = (t_sigvd *)pd_new(sigvd_class);
+    int i, ntaps = f;
+    if (ntaps < 1)
+        ntaps = 1;
     x->x_sym = s;
     x->x_sr = 1;
     x->x_zerodel = 0;
-    outlet_new(&x->x_obj, &s_signal);
+    x->x_ntaps = ntaps;
+    x->x_invec = (t_sample **)getbytes(2 * ntaps * sizeof(t_sample *));
+    x->x_outvec = x->x_invec + ntaps;
+    x->x_idel = 0;
+    x->x_frac = 0;
+    x->x_bufsize = 0;
+    for (i = 1; i < ntaps; i++)
+        inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+    for (i = 0; i < ntaps; i++)
+        outlet_new(&x->x_obj, &s_signal);
     x->x_f = 0;
     return (x);
 }
 
 static t_int *sigvd_perform(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_sample *out = (t_sample *)(w[2]);
-    t_delwritectl *ctl = (t_delwritectl *)(w[3]);
-    t_sigvd *x = (t_sigvd *)(w[4]);
-    int n = (int)(w[5]);
+    t_delwritectl *ctl = (t_delwritectl *)(w[1]);
+    t_sigvd *x = (t_sigvd *)(w[2]);
+    int n = (int)(w[3]);
 
-    int nsamps = ctl->c_n;
+    int nsamps = ctl->c_n, tap, i;
     t_sample limit = nsamps - n;
-    t_sample fn = n-1;
-    t_sample *vp = ctl->c_vec, *bp, *wp = vp + ctl->c_phase;
-    t_sample zerodel = x->x_zerodel;
+    t_sample *vp = ctl->c_vec, *wp = vp + ctl->c_phase + nsamps;
+    t_sample zerodel = x->x_zerodel, sr = x->x_sr;
     if (limit < 0) /* blocksize is larger than delread~ buffer size */
     {
-        while (n--)
-            *out++ = 0;
-        return (w+6);
+        for (tap = 0; tap < x->x_ntaps; tap++)
+            memset(x->x_outvec[tap], 0, n * sizeof(t_sample));
+        return (w+4);
     }
-    while (n--)
+    for (tap = 0; tap < x->x_ntaps; tap++)
+    {
+        t_sample *in = x->x_invec[tap];
+        int *idel = x->x_idel + tap * n;
+        t_sample *fracp = x->x_frac + tap * n;
+        for (i = 0; i < n; i++)
+        {
+            t_sample delsamps = sr * in[i] - zerodel;
+            int idelsamps;
+                /* too small or NAN */
+            delsamps = (delsamps >= 1.00001f ? delsamps : 1.00001f);
+                /* too big */
+            delsamps = (delsamps > limit ? limit : delsamps);
+            delsamps += (n - 1 - i);
+            idelsamps = delsamps;
+            idel[i] = idelsamps;
+            fracp[i] = delsamps - (t_sample)idelsamps;
+        }
+    }
+    for (tap = 0; tap < x->x_ntaps; tap++)
     {
-        t_sample delsamps = x->x_sr * *in++ - zerodel, frac;
-        int idelsamps;
-        t_sample a, b, c, d, cminusb;
-        if (!(delsamps >= 1.00001f))    /* too small or NAN */
-            delsamps = 1.00001f;
-        if (delsamps > limit)           /* too big */
-            delsamps = limit;
-        delsamps += fn;
-        fn = fn - 1.0f;
-        idelsamps = delsamps;
-        frac = delsamps - (t_sample)idelsamps;
-        bp = wp - idelsamps;
-        if (bp < vp + XTRASAMPS) bp += nsamps;
-        d = bp[-3];
-        c = bp[-2];
-        b = bp[-1];
-        a = bp[0];
-        cminusb = c-b;
-        *out++ = b + frac * (
-            cminusb - 0.1666667f * (1.-frac) * (
-                (d - a - 3.0f * cminusb) * frac + (d + 2.0f*a - 3.0f*b)
-            )
-        );
+        t_sample *out = x->x_outvec[tap];
+        int *idel = x->x_idel + tap * n;
+        t_sample *fracp = x->x_frac + tap * n;
+        for (i = 0; i < n; i++)
+        {
+            t_sample *bp = wp - idel[i], frac = fracp[i];
+            t_sample a, b, c, d, cminusb;
+            d = bp[-3];
+            c = bp[-2];
+            b = bp[-1];
+            a = bp[0];
+            cminusb = c-b;
+            out[i] = b + frac * (
+                cminusb - 0.1666667f * (1.-frac) * (
+                    (d - a - 3.0f * cminusb) * frac + (d + 2.0f*a - 3.0f*b)
+                )
+            );
+        }
     }
-    return (w+6);
+    return (w+4);
 }
 
 static void sigvd_dsp(t_sigvd *x, t_signal **sp)
 {
     t_sigdelwrite *delwriter =
         (t_sigdelwrite *)pd_findbyclass(x->x_sym, sigdelwrite_class);
+    int i, n = sp[0]->s_n;
     x->x_sr = sp[0]->s_sr * 0.001;
     if (delwriter)
     {
-        sigdelwrite_checkvecsize(delwriter, sp[0]->s_n);
+        sigdelwrite_checkvecsize(delwriter, n);
         x->x_zerodel = (delwriter->x_sortno == ugen_getsortno() ?
             0 : delwriter->x_vecsize);
-        dsp_add(sigvd_perform, 5,
-            sp[0]->s_vec, sp[1]->s_vec,
-                &delwriter->x_cspace, x, (t_int)sp[0]->s_n);
+        for (i = 0; i < x->x_ntaps; i++)
+        {
+            x->x_invec[i] = sp[i]->s_vec;
+            x->x_outvec[i] = sp[x->x_ntaps + i]->s_vec;
+        }
+        if (n * x->x_ntaps > x->x_bufsize)
+        {
+            int bufsize = n * x->x_ntaps;
+            x->x_idel = (int *)resizebytes(x->x_idel,
+                x->x_bufsize * sizeof(int), bufsize * sizeof(int));
+            x->x_frac = (t_sample *)resizebytes(x->x_frac,
+                x->x_bufsize * sizeof(t_sample), bufsize * sizeof(t_sample));
+            x->x_bufsize = bufsize;
+        }
+        dsp_add(sigvd_perform, 3, &delwriter->x_cspace, x, (t_int)n);
         /* check block size - but only if delwriter has been initialized */
-        if (delwriter->x_cspace.c_n > 0 && sp[0]->s_n > delwriter->x_cspace.c_n)
+        if (delwriter->x_cspace.c_n > 0 && n > delwriter->x_cspace.c_n)
             pd_error(x, "delread4~ %s: blocksize larger than delwrite~ buffer", x->x_sym->s_name);
     }
     else if (*x->x_sym->s_name)
         pd_error(x, "delread4~: %s: no such delwrite~",x->x_sym->s_name);
 }
 
+static void sigvd_free(t_sigvd *x)
+{
+    freebytes(x->x_invec, 2 * x->x_ntaps * sizeof(t_sample *));
+    if (x->x_bufsize)
+    {
+        freebytes(x->x_idel, x->x_bufsize * sizeof(int));
+        freebytes(x->x_frac, x->x_bufsize * sizeof(t_sample));
+    }
+}
+
 static void sigvd_setup(void)
 {
-    sigvd_class = class_new(gensym("delread4~"), (t_newmethod)sigvd_new, 0,
-        sizeof(t_sigvd), 0, A_DEFSYM, 0);
-    class_addcreator((t_newmethod)sigvd_new, gensym("vd~"), A_DEFSYM, 0);
+    sigvd_class = class_new(gensym("delread4~"), (t_newmethod)sigvd_new,
+        (t_method)sigvd_free, sizeof(t_sigvd), 0, A_DEFSYM, A_DEFFLOAT, 0);
+    class_addcreator((t_newmethod)sigvd_new, gensym("vd~"),
+        A_DEFSYM, A_DEFFLOAT, 0);
     class_addmethod(sigvd_class, (t_method)sigvd_dsp, gensym("dsp"), A_CANT, 0);
     CLASS_MAINSIGNALIN(sigvd_class, t_sigvd, x_f);
     class_sethelpsymbol(sigvd_class, gensym("delay-tilde-objects"));
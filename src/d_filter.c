@@ -382,6 +382,26 @@ t_class *sigbiquad_class;
 
 static void sigbiquad_list(t_sigbiquad *x, t_symbol *s, int argc, t_atom *argv);
 
+    /* check that the poles of 1 - fb1 z^-1 - fb2 z^-2 lie in the unit circle */
+static int biquad_isstable(t_float fb1, t_float fb2)
+{
+    t_float discriminant = fb1 * fb1 + 4 * fb2;
+    if (discriminant < 0) /* imaginary roots -- resonant filter */
+    {
+            /* they're conjugates so we just check that the product
+            is less than one */
+        return (fb2 >= -1.0f);
+    }
+    else    /* real roots */
+    {
+            /* check that the parabola 1 - fb1 x - fb2 x^2 has a
+                vertex between -1 and 1, and that it's nonnegative
+                at both ends, which implies both roots are in [1-,1]. */
+        return (fb1 <= 2.0f && fb1 >= -2.0f &&
+            1.0f - fb1 -fb2 >= 0 && 1.0f + fb1 - fb2 >= 0);
+    }
+}
+
 static void *sigbiquad_new(t_symbol *s, int argc, t_atom *argv)
 {
     t_sigbiquad *x = (t_sigbiquad *)pd_new(sigbiquad_class);
@@ -427,26 +447,10 @@ static void sigbiquad_list(t_sigbiquad *x, t_symbol *s, int argc, t_atom *argv)
     t_float ff1 = atom_getfloatarg(2, argc, argv);
     t_float ff2 = atom_getfloatarg(3, argc, argv);
     t_float ff3 = atom_getfloatarg(4, argc, argv);
-    t_float discriminant = fb1 * fb1 + 4 * fb2;
     t_biquadctl *c = &x->x_cspace;
-    if (discriminant < 0) /* imaginary roots -- resonant filter */
-    {
-            /* they're conjugates so we just check that the product
-            is less than one */
-        if (fb2 >= -1.0f) goto stable;
-    }
-    else    /* real roots */
-    {
-            /* check that the parabola 1 - fb1 x - fb2 x^2 has a
-                vertex between -1 and 1, and that it's nonnegative
-                at both ends, which implies both roots are in [1-,1]. */
-        if (fb1 <= 2.0f && fb1 >= -2.0f &&
-            1.0f - fb1 -fb2 >= 0 && 1.0f + fb1 - fb2 >= 0)
-                goto stable;
-    }
         /* if unstable, just bash to zero */
-    fb1 = fb2 = ff1 = ff2 = ff3 = 0;
-stable:
+    if (!biquad_isstable(fb1, fb2))
+        fb1 = fb2 = ff1 = ff2 = ff3 = 0;
     c->c_fb1 = fb1;
     c->c_fb2 = fb2;
     c->c_ff1 = ff1;
@@ -482,6 +486,267 @@ void sigbiquad_setup(void)
         A_GIMME, 0);
 }
 
+/* ------- biquads~ - bank of parallel channels of biquad cascades -------- */
+
+/* Each of "nchans" signal inlets feeds a cascade of "nsect" biquad sections
+whose output appears on the corresponding outlet.  Filter state and
+coefficients are kept in separate arrays indexed by "lane" (section * nchans
++ channel) so that the inner loops run over contiguous lanes and can be
+vectorized by the compiler.  For several channels we interleave the inputs
+into a scratch buffer and run one section at a time across all channels.
+For a single channel with several sections we instead run the cascade as a
+"wavefront": at step t, section k computes sample t-k, so that all sections
+are computed in the same inner loop.  Both give exactly the same output as
+chaining biquad~ objects. */
+
+typedef struct sigbiquads
+{
+    t_object x_obj;
+    t_float x_f;
+    int x_nchans;           /* number of parallel channels */
+    int x_nsect;            /* number of biquad sections per channel */
+    int x_nlanes;           /* nchans * nsect */
+    t_sample *x_fb1;        /* coefficients, one per lane */
+    t_sample *x_fb2;
+    t_sample *x_ff1;
+    t_sample *x_ff2;
+    t_sample *x_ff3;
+    t_sample *x_w1;         /* filter state, one per lane */
+    t_sample *x_w2;
+    t_sample *x_pipe;       /* wavefront registers, 2 * (nsect + 1) */
+    t_sample *x_buf;        /* interleaved scratch buffer */
+    int x_bufsize;
+    t_sample **x_invec;     /* input and output vectors */
+    t_sample **x_outvec;
+} t_sigbiquads;
+
+t_class *sigbiquads_class;
+
+static void sigbiquads_setchannel(t_sigbiquads *x, int ch,
+    int argc, t_atom *argv)
+{
+    int sect;
+    for (sect = 0; sect < x->x_nsect; sect++)
+    {
+        int lane = sect * x->x_nchans + ch, onset = 5 * sect;
+        t_float fb1 = atom_getfloatarg(onset, argc, argv);
+        t_float fb2 = atom_getfloatarg(onset + 1, argc, argv);
+        t_float ff1 = atom_getfloatarg(onset + 2, argc, argv);
+        t_float ff2 = atom_getfloatarg(onset + 3, argc, argv);
+        t_float ff3 = atom_getfloatarg(onset + 4, argc, argv);
+            /* sections with no coefficients pass the signal through */
+        if (onset >= argc)
+            ff1 = 1;
+        if (!biquad_isstable(fb1, fb2))
+            fb1 = fb2 = ff1 = ff2 = ff3 = 0;
+        x->x_fb1[lane] = fb1;
+        x->x_fb2[lane] = fb2;
+        x->x_ff1[lane] = ff1;
+        x->x_ff2[lane] = ff2;
+        x->x_ff3[lane] = ff3;
+    }
+}
+
+    /* list of coefficients, 5 per section, sets all channels */
+static void sigbiquads_list(t_sigbiquads *x, t_symbol *s, int argc,
+    t_atom *argv)
+{
+    int ch;
+    for (ch = 0; ch < x->x_nchans; ch++)
+        sigbiquads_setchannel(x, ch, argc, argv);
+}
+
+    /* "channel <n> <coefficients...>" sets one channel's cascade */
+static void sigbiquads_channel(t_sigbiquads *x, t_symbol *s, int argc,
+    t_atom *argv)
+{
+    int ch = atom_getfloatarg(0, argc, argv);
+    if (ch < 0 || ch >= x->x_nchans)
+    {
+        pd_error(x, "biquads~: channel %d out of range", ch);
+        return;
+    }
+    sigbiquads_setchannel(x, ch, argc - 1, argv + 1);
+}
+
+static void sigbiquads_clear(t_sigbiquads *x)
+{
+    int i;
+    for (i = 0; i < x->x_nlanes; i++)
+        x->x_w1[i] = x->x_w2[i] = 0;
+    for (i = 0; i < 2 * (x->x_nsect + 1); i++)
+        x->x_pipe[i] = 0;
+}
+
+static void *sigbiquads_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_sigbiquads *x = (t_sigbiquads *)pd_new(sigbiquads_class);
+    int nchans = atom_getfloatarg(0, argc, argv),
+        nsect = atom_getfloatarg(1, argc, argv), i;
+    if (nchans < 1)
+        nchans = 1;
+    if (nsect < 1)
+        nsect = 1;
+    x->x_nchans = nchans;
+    x->x_nsect = nsect;
+    x->x_nlanes = nchans * nsect;
+    x->x_fb1 = (t_sample *)getbytes(7 * x->x_nlanes * sizeof(t_sample));
+    x->x_fb2 = x->x_fb1 + x->x_nlanes;
+    x->x_ff1 = x->x_fb2 + x->x_nlanes;
+    x->x_ff2 = x->x_ff1 + x->x_nlanes;
+    x->x_ff3 = x->x_ff2 + x->x_nlanes;
+    x->x_w1 = x->x_ff3 + x->x_nlanes;
+    x->x_w2 = x->x_w1 + x->x_nlanes;
+    x->x_pipe = (t_sample *)getbytes(2 * (nsect + 1) * sizeof(t_sample));
+    x->x_buf = 0;
+    x->x_bufsize = 0;
+    x->x_invec = (t_sample **)getbytes(2 * nchans * sizeof(t_sample *));
+    x->x_outvec = x->x_invec + nchans;
+    for (i = 1; i < nchans; i++)
+        inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+    for (i = 0; i < nchans; i++)
+        outlet_new(&x->x_obj, &s_signal);
+    sigbiquads_list(x, 0, (argc > 2 ? argc - 2 : 0), argv + 2);
+    sigbiquads_clear(x);
+    x->x_f = 0;
+    return (x);
+}
+
+static void sigbiquads_free(t_sigbiquads *x)
+{
+    freebytes(x->x_fb1, 7 * x->x_nlanes * sizeof(t_sample));
+    freebytes(x->x_pipe, 2 * (x->x_nsect + 1) * sizeof(t_sample));
+    if (x->x_buf)
+        freebytes(x->x_buf, x->x_bufsize * sizeof(t_sample));
+    freebytes(x->x_invec, 2 * x->x_nchans * sizeof(t_sample *));
+}
+
+static void sigbiquads_flush(t_sigbiquads *x)
+{
+    int i;
+    for (i = 0; i < x->x_nlanes; i++)
+    {
+        if (PD_BIGORSMALL(x->x_w1[i]))
+            x->x_w1[i] = 0;
+        if (PD_BIGORSMALL(x->x_w2[i]))
+            x->x_w2[i] = 0;
+    }
+}
+
+    /* several channels: run each section across all channels at once */
+static t_int *sigbiquads_perform(t_int *w)
+{
+    t_sigbiquads *x = (t_sigbiquads *)(w[1]);
+    int n = (int)(w[2]), nchans = x->x_nchans, i, ch, sect;
+    t_sample *buf = x->x_buf, *bp;
+    for (ch = 0; ch < nchans; ch++)
+    {
+        t_sample *in = x->x_invec[ch];
+        for (i = 0, bp = buf + ch; i < n; i++, bp += nchans)
+            *bp = in[i];
+    }
+    for (sect = 0; sect < x->x_nsect; sect++)
+    {
+        int onset = sect * nchans;
+        t_sample *fb1 = x->x_fb1 + onset, *fb2 = x->x_fb2 + onset,
+            *ff1 = x->x_ff1 + onset, *ff2 = x->x_ff2 + onset,
+            *ff3 = x->x_ff3 + onset, *w1 = x->x_w1 + onset,
+            *w2 = x->x_w2 + onset;
+        for (i = 0, bp = buf; i < n; i++, bp += nchans)
+        {
+            for (ch = 0; ch < nchans; ch++)
+            {
+                t_sample output = bp[ch] + fb1[ch] * w1[ch] + fb2[ch] * w2[ch];
+                bp[ch] = ff1[ch] * output + ff2[ch] * w1[ch] +
+                    ff3[ch] * w2[ch];
+                w2[ch] = w1[ch];
+                w1[ch] = output;
+            }
+        }
+    }
+    for (ch = 0; ch < nchans; ch++)
+    {
+        t_sample *out = x->x_outvec[ch];
+        for (i = 0, bp = buf + ch; i < n; i++, bp += nchans)
+            out[i] = *bp;
+    }
+    sigbiquads_flush(x);
+    return (w+3);
+}
+
+    /* one channel, several sections: wavefront through the cascade.  The
+    pipe arrays hold each section's input, with pipe[k+1] the output of
+    section k; we ping-pong between two copies so the inner loop reads one
+    and writes the other. */
+static t_int *sigbiquads_perform_cascade(t_int *w)
+{
+    t_sigbiquads *x = (t_sigbiquads *)(w[1]);
+    int n = (int)(w[2]), nsect = x->x_nsect, t, k, lo, hi;
+    t_sample *in = x->x_invec[0], *out = x->x_outvec[0];
+    t_sample *fb1 = x->x_fb1, *fb2 = x->x_fb2, *ff1 = x->x_ff1,
+        *ff2 = x->x_ff2, *ff3 = x->x_ff3, *w1 = x->x_w1, *w2 = x->x_w2;
+    t_sample *pa = x->x_pipe, *pb = x->x_pipe + (nsect + 1), *tmp;
+    for (t = 0; t < n + nsect - 1; t++)
+    {
+        if (t < n)
+            pa[0] = in[t];
+            /* sections active at this step: those whose sample t-k is
+            within this block */
+        lo = (t >= n ? t - n + 1 : 0);
+        hi = (t < nsect - 1 ? t : nsect - 1);
+        for (k = lo; k <= hi; k++)
+        {
+            t_sample output = pa[k] + fb1[k] * w1[k] + fb2[k] * w2[k];
+            pb[k+1] = ff1[k] * output + ff2[k] * w1[k] + ff3[k] * w2[k];
+            w2[k] = w1[k];
+            w1[k] = output;
+        }
+        if (t >= nsect - 1)
+            out[t - (nsect - 1)] = pb[nsect];
+        tmp = pa, pa = pb, pb = tmp;
+    }
+    sigbiquads_flush(x);
+    return (w+3);
+}
+
+static void sigbiquads_dsp(t_sigbiquads *x, t_signal **sp)
+{
+    int i, n = sp[0]->s_n;
+    for (i = 0; i < x->x_nchans; i++)
+    {
+        x->x_invec[i] = sp[i]->s_vec;
+        x->x_outvec[i] = sp[x->x_nchans + i]->s_vec;
+    }
+    if (x->x_nchans == 1 && x->x_nsect > 1)
+        dsp_add(sigbiquads_perform_cascade, 2, x, (t_int)n);
+    else
+    {
+        if (n * x->x_nchans > x->x_bufsize)
+        {
+            x->x_buf = (t_sample *)resizebytes(x->x_buf,
+                x->x_bufsize * sizeof(t_sample),
+                    n * x->x_nchans * sizeof(t_sample));
+            x->x_bufsize = n * x->x_nchans;
+        }
+        dsp_add(sigbiquads_perform, 2, x, (t_int)n);
+    }
+}
+
+void sigbiquads_setup(void)
+{
+    sigbiquads_class = class_new(gensym("biquads~"),
+        (t_newmethod)sigbiquads_new, (t_method)sigbiquads_free,
+            sizeof(t_sigbiquads), 0, A_GIMME, 0);
+    CLASS_MAINSIGNALIN(sigbiquads_class, t_sigbiquads, x_f);
+    class_addmethod(sigbiquads_class, (t_method)sigbiquads_dsp,
+        gensym("dsp"), A_CANT, 0);
+    class_addlist(sigbiquads_class, sigbiquads_list);
+    class_addmethod(sigbiquads_class, (t_method)sigbiquads_channel,
+        gensym("channel"), A_GIMME, 0);
+    class_addmethod(sigbiquads_class, (t_method)sigbiquads_clear,
+        gensym("clear"), 0);
+}
+
 /* ---------------- samphold~ - sample and hold  ----------------- */
 
 typedef struct sigsamphold
@@ -1168,6 +1433,7 @@ void d_filter_setup(void)
     siglop_setup();
     sigbp_setup();
     sigbiquad_setup();
+    sigbiquads_setup();
     sigsamphold_setup();
     sigrpole_setup();
     sigrzero_setup();
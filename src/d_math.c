@@ -7,10 +7,16 @@
 */
 
 #include "m_pd.h"
+#include "s_stuff.h"
+#include "d_fastmath.h"
 #include <math.h>
 #include <limits.h>
 #define LOGTEN 2.302585092994046
 
+/* Most objects here have a second perform routine used when "fast math" is
+on (see d_fastmath.h).  These are written without branches so that the
+compiler can vectorize them. */
+
 /* ------------------------- clip~ -------------------------- */
 static t_class *clip_class;
 
@@ -169,9 +175,22 @@ static t_int *sigrsqrt_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *sigrsqrt_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i], g = 1 / sqrt(f);
+        out[i] = (f > 0 ? g : 0);
+    }
+    return (w + 4);
+}
+
 static void sigrsqrt_dsp(t_sigrsqrt *x, t_signal **sp)
 {
-    dsp_add(sigrsqrt_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? sigrsqrt_fast_perform : sigrsqrt_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void sigrsqrt_setup(void)
@@ -228,9 +247,22 @@ t_int *sigsqrt_perform(t_int *w)    /* not static; also used in d_fft.c */
     return (w + 4);
 }
 
+static t_int *sigsqrt_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i];
+        out[i] = sqrt(f > 0 ? f : 0);
+    }
+    return (w + 4);
+}
+
 static void sigsqrt_dsp(t_sigsqrt *x, t_signal **sp)
 {
-    dsp_add(sigsqrt_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? sigsqrt_fast_perform : sigsqrt_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void sigsqrt_setup(void)
@@ -343,9 +375,23 @@ static t_int *mtof_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *mtof_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i], g = 8.17579891564f *
+            fastmath_exp(.0577622650f * (f > 1499 ? 1499 : f));
+        out[i] = (f <= -1500 ? 0 : g);
+    }
+    return (w + 4);
+}
+
 static void mtof_tilde_dsp(t_mtof_tilde *x, t_signal **sp)
 {
-    dsp_add(mtof_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? mtof_tilde_fast_perform : mtof_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void mtof_tilde_setup(void)
@@ -387,9 +433,23 @@ static t_int *ftom_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *ftom_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i],
+            g = 17.3123405046f * fastmath_log(.12231220585f * f);
+        out[i] = (f > 0 ? g : -1500);
+    }
+    return (w + 4);
+}
+
 static void ftom_tilde_dsp(t_ftom_tilde *x, t_signal **sp)
 {
-    dsp_add(ftom_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? ftom_tilde_fast_perform : ftom_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void ftom_tilde_setup(void)
@@ -437,9 +497,23 @@ static t_int *dbtorms_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *dbtorms_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i], g = fastmath_exp((t_sample)(LOGTEN * 0.05) *
+            ((f > 485 ? 485 : f) - 100));
+        out[i] = (f <= 0 ? 0 : g);
+    }
+    return (w + 4);
+}
+
 static void dbtorms_tilde_dsp(t_dbtorms_tilde *x, t_signal **sp)
 {
-    dsp_add(dbtorms_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? dbtorms_tilde_fast_perform : dbtorms_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void dbtorms_tilde_setup(void)
@@ -486,9 +560,23 @@ static t_int *rmstodb_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *rmstodb_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i],
+            g = 100 + (t_sample)(20./LOGTEN) * fastmath_log(f);
+        out[i] = (f <= 0 || g < 0 ? 0 : g);
+    }
+    return (w + 4);
+}
+
 static void rmstodb_tilde_dsp(t_rmstodb_tilde *x, t_signal **sp)
 {
-    dsp_add(rmstodb_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? rmstodb_tilde_fast_perform : rmstodb_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void rmstodb_tilde_setup(void)
@@ -536,9 +624,23 @@ static t_int *dbtopow_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *dbtopow_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i], g = fastmath_exp((t_sample)(LOGTEN * 0.1) *
+            ((f > 870 ? 870 : f) - 100));
+        out[i] = (f <= 0 ? 0 : g);
+    }
+    return (w + 4);
+}
+
 static void dbtopow_tilde_dsp(t_dbtopow_tilde *x, t_signal **sp)
 {
-    dsp_add(dbtopow_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? dbtopow_tilde_fast_perform : dbtopow_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void dbtopow_tilde_setup(void)
@@ -585,9 +687,23 @@ static t_int *powtodb_tilde_perform(t_int *w)
     return (w + 4);
 }
 
+static t_int *powtodb_tilde_fast_perform(t_int *w)
+{
+    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
+    int n = (int)w[3], i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i],
+            g = 100 + (t_sample)(10./LOGTEN) * fastmath_log(f);
+        out[i] = (f <= 0 || g < 0 ? 0 : g);
+    }
+    return (w + 4);
+}
+
 static void powtodb_tilde_dsp(t_powtodb_tilde *x, t_signal **sp)
 {
-    dsp_add(powtodb_tilde_perform, 3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
+    dsp_add((sys_fastmath ? powtodb_tilde_fast_perform : powtodb_tilde_perform),
+        3, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
 void powtodb_tilde_setup(void)
@@ -634,9 +750,31 @@ t_int *pow_tilde_perform(t_int *w)
     return (w+5);
 }
 
+    /* same special cases as above: 0 for zero to a negative power or a
+    negative number to a fractional one; negative numbers to integer
+    powers get the sign of the result from the parity of the power. */
+static t_int *pow_tilde_fast_perform(t_int *w)
+{
+    t_sample *in1 = (t_sample *)(w[1]);
+    t_sample *in2 = (t_sample *)(w[2]);
+    t_sample *out = (t_sample *)(w[3]);
+    int n = (int)(w[4]), i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f1 = in1[i], f2 = in2[i], mag = (f1 < 0 ? -f1 : f1), g;
+        int ipow = (int)f2;
+        g = fastmath_pow((mag > 0 ? mag : 1), f2);
+        g = (f1 < 0 && (ipow & 1) ? -g : g);
+        g = (f1 < 0 && f2 != (t_sample)ipow ? 0 : g);
+        g = (f1 == 0 ? (f2 == 0 ? 1 : 0) : g);
+        out[i] = g;
+    }
+    return (w+5);
+}
+
 static void pow_tilde_dsp(t_pow_tilde *x, t_signal **sp)
 {
-    dsp_add(pow_tilde_perform, 4,
+    dsp_add((sys_fastmath ? pow_tilde_fast_perform : pow_tilde_perform), 4,
         sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
 }
 
@@ -675,9 +813,19 @@ t_int *exp_tilde_perform(t_int *w)
     return (w+4);
 }
 
+static t_int *exp_tilde_fast_perform(t_int *w)
+{
+    t_sample *in1 = (t_sample *)(w[1]);
+    t_sample *out = (t_sample *)(w[2]);
+    int n = (int)(w[3]), i;
+    for (i = 0; i < n; i++)
+        out[i] = fastmath_exp(in1[i]);
+    return (w+4);
+}
+
 static void exp_tilde_dsp(t_exp_tilde *x, t_signal **sp)
 {
-    dsp_add(exp_tilde_perform, 3,
+    dsp_add((sys_fastmath ? exp_tilde_fast_perform : exp_tilde_perform), 3,
         sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_n);
 }
 
@@ -728,9 +876,25 @@ t_int *log_tilde_perform(t_int *w)
     return (w+5);
 }
 
+static t_int *log_tilde_fast_perform(t_int *w)
+{
+    t_sample *in1 = (t_sample *)(w[1]);
+    t_sample *in2 = (t_sample *)(w[2]);
+    t_sample *out = (t_sample *)(w[3]);
+    int n = (int)(w[4]), i;
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in1[i], g = in2[i],
+            lf = fastmath_log(f > 0 ? f : 1), lg = fastmath_log(g > 0 ? g : 1);
+        lf = (g > 0 ? lf / lg : lf);
+        out[i] = (f <= 0 ? -1000 : lf);
+    }
+    return (w+5);
+}
+
 static void log_tilde_dsp(t_log_tilde *x, t_signal **sp)
 {
-    dsp_add(log_tilde_perform, 4,
+    dsp_add((sys_fastmath ? log_tilde_fast_perform : log_tilde_perform), 4,
         sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, (t_int)sp[0]->s_n);
 }
 
@@ -340,6 +340,275 @@ static void osc_setup(void)
     cos_maketable();
 }
 
+/* -------------------------- oscbank~ ------------------------------ */
+
+/* A bank of oscillators summed into one output, for additive synthesis.
+Each partial keeps a 32-bit integer phase that wraps around by itself, so
+the phase at sample i of a block is simply phase + i * increment and the
+per-partial loop over the block has no recurrence; the compiler can then
+vectorize the phase computation and table interpolation.  Amplitude
+changes are ramped over one block.  Partials at or above the Nyquist
+frequency are silenced.  Besides cosines the bank can make saw or square
+waves, band-limited with "PolyBLEP" corrections at the discontinuities. */
+
+#define OSCBANK_COS 0
+#define OSCBANK_SAW 1
+#define OSCBANK_SQUARE 2
+
+#define OSCBANK_FRACBITS (32 - LOGCOSTABSIZE)
+#define OSCBANK_TWO32 4294967296.
+    /* phase as a number from 0 to 1, going through a signed int because
+    unsigned-to-float conversion is slow or not vectorized on some CPUs */
+#define OSCBANK_UNITPHASE(ph) \
+    ((t_sample)(int32_t)((ph) ^ 0x80000000) * phasescale + 0.5f)
+
+static t_class *oscbank_class;
+
+typedef struct _oscpartial
+{
+    uint32_t p_phase;
+    t_float p_freq;         /* frequency in Hz */
+    t_float p_amp;          /* current amplitude */
+    t_float p_target;       /* amplitude to ramp to over the next block */
+} t_oscpartial;
+
+typedef struct _oscbank
+{
+    t_object x_obj;
+    int x_n;                /* number of partials */
+    t_oscpartial *x_vec;
+    int x_shape;            /* OSCBANK_COS, etc. */
+    double x_conv;          /* 2^32 / sample rate */
+    t_float x_nyquist;
+    t_symbol *x_freqname;   /* optional arrays for frequencies and */
+    t_symbol *x_ampname;    /* amplitudes, read every block */
+    t_word *x_freqvec;
+    t_word *x_ampvec;
+    int x_nfreq;
+    int x_namp;
+} t_oscbank;
+
+static void oscbank_set(t_oscbank *x, t_symbol *freqname, t_symbol *ampname);
+
+static void *oscbank_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_oscbank *x = (t_oscbank *)pd_new(oscbank_class);
+    int n = atom_getfloatarg(0, argc, argv);
+    if (n < 1)
+        n = 1;
+    x->x_n = n;
+    x->x_vec = (t_oscpartial *)getbytes(n * sizeof(*x->x_vec));
+    x->x_shape = OSCBANK_COS;
+    x->x_conv = 0;
+    x->x_nyquist = 0;
+    x->x_freqvec = x->x_ampvec = 0;
+    x->x_nfreq = x->x_namp = 0;
+    oscbank_set(x, atom_getsymbolarg(1, argc, argv),
+        atom_getsymbolarg(2, argc, argv));
+    outlet_new(&x->x_obj, gensym("signal"));
+    return (x);
+}
+
+static void oscbank_free(t_oscbank *x)
+{
+    freebytes(x->x_vec, x->x_n * sizeof(*x->x_vec));
+}
+
+static void oscbank_getarrays(t_oscbank *x)
+{
+    t_garray *a;
+    x->x_freqvec = x->x_ampvec = 0;
+    x->x_nfreq = x->x_namp = 0;
+    if (*x->x_freqname->s_name)
+    {
+        if (!(a = (t_garray *)pd_findbyclass(x->x_freqname, garray_class)))
+            pd_error(x, "oscbank~: %s: no such array",
+                x->x_freqname->s_name);
+        else if (!garray_getfloatwords(a, &x->x_nfreq, &x->x_freqvec))
+            pd_error(x, "%s: bad template for oscbank~",
+                x->x_freqname->s_name);
+        else garray_usedindsp(a);
+    }
+    if (*x->x_ampname->s_name)
+    {
+        if (!(a = (t_garray *)pd_findbyclass(x->x_ampname, garray_class)))
+            pd_error(x, "oscbank~: %s: no such array",
+                x->x_ampname->s_name);
+        else if (!garray_getfloatwords(a, &x->x_namp, &x->x_ampvec))
+            pd_error(x, "%s: bad template for oscbank~",
+                x->x_ampname->s_name);
+        else garray_usedindsp(a);
+    }
+}
+
+    /* correction to subtract from a naive sawtooth near its discontinuity,
+    t being phase in [0, 1) and dt the phase increment per sample (idt its
+    inverse).  Both branches are computed and selected so that the loops
+    calling this stay branch-free. */
+static inline t_sample oscbank_polyblep(t_sample t, t_sample dt, t_sample idt)
+{
+    t_sample y1 = t * idt, y2 = (t - 1) * idt;
+    t_sample before = y2 * y2 + y2 + y2 + 1, after = y1 + y1 - y1 * y1 - 1;
+    return (t < dt ? after : (t > 1 - dt ? before : 0));
+}
+
+static t_int *oscbank_perform(t_int *w)
+{
+    t_oscbank *x = (t_oscbank *)(w[1]);
+    t_sample *out = (t_sample *)(w[2]);
+    int n = (int)(w[3]), i, k;
+    float *tab = cos_table;
+    t_oscpartial *p;
+    t_sample invn = 1./n;
+    const t_sample fracscale = 1./(1 << OSCBANK_FRACBITS),
+        phasescale = 1./OSCBANK_TWO32;
+
+    for (i = 0; i < n; i++)
+        out[i] = 0;
+    for (k = 0; k < x->x_nfreq && k < x->x_n; k++)
+        x->x_vec[k].p_freq = x->x_freqvec[k].w_float;
+    for (k = 0; k < x->x_namp && k < x->x_n; k++)
+        x->x_vec[k].p_target = x->x_ampvec[k].w_float;
+    for (k = 0, p = x->x_vec; k < x->x_n; k++, p++)
+    {
+        t_float freq = p->p_freq;
+        uint32_t phase = p->p_phase, inc;
+        t_sample amp = p->p_amp, damp;
+        if (!(freq < x->x_nyquist && freq > -x->x_nyquist))
+        {
+            p->p_amp = 0;   /* out of band (or NAN) */
+            continue;
+        }
+        inc = (uint32_t)(int64_t)(freq * x->x_conv);
+        p->p_phase = phase + (uint32_t)n * inc;
+        if (amp == 0 && p->p_target == 0)
+            continue;
+        damp = (p->p_target - amp) * invn;
+        p->p_amp = p->p_target;
+        if (x->x_shape == OSCBANK_COS)
+        {
+            for (i = 0; i < n; i++)
+            {
+                uint32_t ph = phase + (uint32_t)i * inc;
+                float *addr = tab + (ph >> OSCBANK_FRACBITS);
+                t_sample frac = (t_sample)(ph & ((1 << OSCBANK_FRACBITS) - 1))
+                    * fracscale;
+                out[i] += (amp + (i + 1) * damp) *
+                    (addr[0] + frac * (addr[1] - addr[0]));
+            }
+        }
+        else
+        {
+                /* for negative frequencies run the phase backward and flip
+                the output, which gives the same naive waveform */
+            t_sample dt = (freq < 0 ? -freq : freq) * x->x_conv * phasescale,
+                idt = (dt > 0 ? 1./dt : 0), sign = (freq < 0 ? -1 : 1);
+            if (x->x_shape == OSCBANK_SAW)
+                for (i = 0; i < n; i++)
+                {
+                    t_sample t = OSCBANK_UNITPHASE(phase + (uint32_t)i * inc);
+                    t = (freq < 0 ? 1 - t : t);
+                    out[i] += sign * (amp + (i + 1) * damp) *
+                        (t + t - 1 - oscbank_polyblep(t, dt, idt));
+                }
+            else for (i = 0; i < n; i++)
+            {
+                t_sample t = OSCBANK_UNITPHASE(phase + (uint32_t)i * inc),
+                    t2 = (t < 0.5f ? t + 0.5f : t - 0.5f);
+                out[i] += (amp + (i + 1) * damp) * ((t < 0.5f ? 1 : -1)
+                    + oscbank_polyblep(t, dt, idt)
+                        - oscbank_polyblep(t2, dt, idt));
+            }
+        }
+    }
+    return (w+4);
+}
+
+static void oscbank_dsp(t_oscbank *x, t_signal **sp)
+{
+    x->x_conv = OSCBANK_TWO32 / sp[0]->s_sr;
+    x->x_nyquist = 0.5 * sp[0]->s_sr;
+    oscbank_getarrays(x);
+    dsp_add(oscbank_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+static void oscbank_freq(t_oscbank *x, t_symbol *s, int argc, t_atom *argv)
+{
+    int i;
+    for (i = 0; i < argc && i < x->x_n; i++)
+        x->x_vec[i].p_freq = atom_getfloat(argv + i);
+}
+
+static void oscbank_amp(t_oscbank *x, t_symbol *s, int argc, t_atom *argv)
+{
+    int i;
+    for (i = 0; i < argc && i < x->x_n; i++)
+        x->x_vec[i].p_target = atom_getfloat(argv + i);
+}
+
+static void oscbank_partial(t_oscbank *x, t_floatarg findex,
+    t_floatarg freq, t_floatarg amp)
+{
+    int index = findex;
+    if (index < 0 || index >= x->x_n)
+    {
+        pd_error(x, "oscbank~: partial %d out of range", index);
+        return;
+    }
+    x->x_vec[index].p_freq = freq;
+    x->x_vec[index].p_target = amp;
+}
+
+    /* set all phases, in cycles (0 to 1) */
+static void oscbank_phase(t_oscbank *x, t_floatarg f)
+{
+    uint32_t phase = (uint32_t)(int64_t)((f - floor(f)) * OSCBANK_TWO32);
+    int i;
+    for (i = 0; i < x->x_n; i++)
+        x->x_vec[i].p_phase = phase;
+}
+
+static void oscbank_shape(t_oscbank *x, t_symbol *s)
+{
+    if (s == gensym("cos"))
+        x->x_shape = OSCBANK_COS;
+    else if (s == gensym("saw"))
+        x->x_shape = OSCBANK_SAW;
+    else if (s == gensym("square"))
+        x->x_shape = OSCBANK_SQUARE;
+    else pd_error(x, "oscbank~: %s: unknown shape", s->s_name);
+}
+
+    /* "set <freq array> <amp array>"; empty names revert to messages */
+static void oscbank_set(t_oscbank *x, t_symbol *freqname, t_symbol *ampname)
+{
+    x->x_freqname = freqname;
+    x->x_ampname = ampname;
+    if (canvas_dspstate)
+        oscbank_getarrays(x);
+}
+
+static void oscbank_setup(void)
+{
+    oscbank_class = class_new(gensym("oscbank~"), (t_newmethod)oscbank_new,
+        (t_method)oscbank_free, sizeof(t_oscbank), 0, A_GIMME, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_dsp,
+        gensym("dsp"), A_CANT, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_freq,
+        gensym("freq"), A_GIMME, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_amp,
+        gensym("amp"), A_GIMME, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_partial,
+        gensym("partial"), A_FLOAT, A_FLOAT, A_FLOAT, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_phase,
+        gensym("phase"), A_FLOAT, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_shape,
+        gensym("shape"), A_SYMBOL, 0);
+    class_addmethod(oscbank_class, (t_method)oscbank_set,
+        gensym("set"), A_DEFSYM, A_DEFSYM, 0);
+    cos_maketable();
+}
+
 /* ---- vcf~ - resonant filter with audio-rate center frequency input ----- */
 
 typedef struct vcfctl
@@ -527,6 +796,7 @@ void d_osc_setup(void)
     phasor_setup();
     cos_setup();
     osc_setup();
+    oscbank_setup();
     sigvcf_setup();
     noise_setup();
 }
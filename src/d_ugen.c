@@ -13,6 +13,7 @@
 
 #include "m_pd.h"
 #include "m_imp.h"
+#include "s_stuff.h"
 #include <stdarg.h>
 
 extern t_class *vinlet_class, *voutlet_class, *canvas_class, *text_class;
@@ -43,6 +44,10 @@ struct _instanceugen
     int u_phase;
     int u_loud;
     struct _dspcontext *u_context;
+        /* with "-rtaudit", the class of the object that put each entry in
+        the DSP chain, and the one whose "dsp" method is being called */
+    t_class **u_chainclass;
+    t_class *u_owner;
 };
 
 #define THIS (pd_this->pd_ugen)
@@ -53,6 +58,8 @@ void d_ugen_newpdinstance(void)
     THIS->u_dspchain = 0;
     THIS->u_dspchainsize = 0;
     THIS->u_signals = 0;
+    THIS->u_chainclass = 0;
+    THIS->u_owner = 0;
 }
 
 void d_ugen_freepdinstance(void)
@@ -329,6 +336,17 @@ static t_int dsp_done(t_int *w)
     return (0);
 }
 
+    /* keep u_chainclass the same size as the chain */
+static void dsp_addclass(int oldsize, int newsize)
+{
+    int i;
+    THIS->u_chainclass = (t_class **)t_resizebytes(THIS->u_chainclass,
+        oldsize * sizeof(t_class *), newsize * sizeof(t_class *));
+    for (i = oldsize - 1; i < newsize - 1; i++)
+        THIS->u_chainclass[i] = THIS->u_owner;
+    THIS->u_chainclass[newsize-1] = 0;
+}
+
 void dsp_add(t_perfroutine f, int n, ...)
 {
     int newsize = THIS->u_dspchainsize + n+1, i;
@@ -350,6 +368,8 @@ void dsp_add(t_perfroutine f, int n, ...)
     }
     va_end(ap);
     THIS->u_dspchain[newsize-1] = (t_int)dsp_done;
+    if (THIS->u_chainclass)
+        dsp_addclass(THIS->u_dspchainsize, newsize);
     THIS->u_dspchainsize = newsize;
 }
 
@@ -364,6 +384,8 @@ void dsp_addv(t_perfroutine f, int n, t_int *vec)
     for (i = 0; i < n; i++)
         THIS->u_dspchain[THIS->u_dspchainsize + i] = vec[i];
     THIS->u_dspchain[newsize-1] = (t_int)dsp_done;
+    if (THIS->u_chainclass)
+        dsp_addclass(THIS->u_dspchainsize, newsize);
     THIS->u_dspchainsize = newsize;
 }
 
@@ -372,7 +394,18 @@ void dsp_tick(void)
     if (THIS->u_dspchain)
     {
         t_int *ip;
-        for (ip = THIS->u_dspchain; ip; ) ip = (*(t_perfroutine)(*ip))(ip);
+        if (THIS->u_chainclass)
+        {
+                /* tell m_memory.c whose perform routine is running */
+            for (ip = THIS->u_dspchain; ip; )
+            {
+                rtaudit_enter(THIS->u_chainclass[ip - THIS->u_dspchain]);
+                ip = (*(t_perfroutine)(*ip))(ip);
+            }
+            rtaudit_leave();
+        }
+        else for (ip = THIS->u_dspchain; ip; )
+            ip = (*(t_perfroutine)(*ip))(ip);
         THIS->u_phase++;
     }
 }
@@ -409,6 +442,8 @@ static void signal_cleanup(void)
     THIS->u_freeborrowed = 0;
 }
 
+static t_int *scalarcopy_skip(t_int *w);
+
     /* mark the signal "reusable." */
 void signal_makereusable(t_signal *sig)
 {
@@ -451,6 +486,10 @@ void signal_makereusable(t_signal *sig)
             /* if it's a real signal (not borrowed), put it on the free list
                 so we can reuse it. */
         if (THIS->u_freelist[logn] == sig) bug("signal_free 2");
+            /* if it was a constant that everyone read as a scalar, nobody
+            looked at the vector; remove the code that filled it in. */
+        if (sig->s_scalar && sig->s_nscalarreaders >= sig->s_nreaders)
+            THIS->u_dspchain[sig->s_scalarfill] = (t_int)scalarcopy_skip;
         sig->s_nextfree = THIS->u_freelist[logn];
         THIS->u_freelist[logn] = sig;
     }
@@ -501,6 +540,8 @@ static t_signal *signal_new(int n, t_float sr)
     ret->s_sr = sr;
     ret->s_refcount = 0;
     ret->s_borrowedfrom = 0;
+    ret->s_scalar = 0;
+    ret->s_nreaders = ret->s_nscalarreaders = 0;
     if (THIS->u_loud) post("new %lx: %lx", ret, ret->s_vec);
     return (ret);
 }
@@ -597,6 +638,12 @@ void ugen_stop(void)
             THIS->u_dspchainsize * sizeof (t_int));
         THIS->u_dspchain = 0;
     }
+    if (THIS->u_chainclass)
+    {
+        freebytes(THIS->u_chainclass,
+            THIS->u_dspchainsize * sizeof (t_class *));
+        THIS->u_chainclass = 0;
+    }
     signal_cleanup();
 
 }
@@ -608,6 +655,9 @@ void ugen_start(void)
     THIS->u_dspchain = (t_int *)getbytes(sizeof(*THIS->u_dspchain));
     THIS->u_dspchain[0] = (t_int)dsp_done;
     THIS->u_dspchainsize = 1;
+    if (sys_rtaudit)
+        THIS->u_chainclass = (t_class **)getbytes(sizeof(t_class *));
+    rtpool_setup();
     if (THIS->u_context) bug("ugen_start");
 }
 
@@ -752,7 +802,7 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
     t_sigoutlet *uout;
     t_siginlet *uin;
     t_sigoutconnect *oc;
-    t_class *class = pd_class(&u->u_obj->ob_pd);
+    t_class *class = pd_class(&u->u_obj->ob_pd), *owner;
     int i, n;
         /* suppress creating new signals for the outputs of signal
         inlets and subpatches; except in the case we're an inlet and "blocking"
@@ -776,16 +826,16 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
     {
         if (!uin->i_nconnect)
         {
+            static t_float zero;
             t_float *scalar;
             s3 = signal_new(dc->dc_calcsize, dc->dc_srate);
             /* post("%s: unconnected signal inlet set to zero",
                 class_getname(u->u_obj->ob_pd)); */
-            if ((scalar = obj_findsignalscalar(u->u_obj, i)))
-                dsp_add_scalarcopy(scalar, s3->s_vec, s3->s_n);
-            else
-                dsp_add_zero(s3->s_vec, s3->s_n);
             uin->i_signal = s3;
             s3->s_refcount = 1;
+            if (!(scalar = obj_findsignalscalar(u->u_obj, i)))
+                scalar = &zero;
+            dsp_add_scalarsignal(scalar, s3);
         }
     }
     insig = (t_signal **)getbytes((u->u_nin + u->u_nout) * sizeof(t_signal *));
@@ -802,7 +852,9 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
             is in sig_makereusable(). */
         if (nofreesigs)
             (*sig)->s_refcount++;
-        else if (!newrefcount)
+            /* constant inputs are held until after the DSP routine has had
+            a chance to ask for their values (see signal_getscalar()). */
+        else if (!newrefcount && !(*sig)->s_scalar)
             signal_makereusable(*sig);
     }
     for (sig = outsig, uout = u->u_out, i = u->u_nout; i--; sig++, uout++)
@@ -826,7 +878,25 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
         /* now call the DSP scheduling routine for the ugen.  This
         routine must fill in "borrowed" signal outputs in case it's either
         a subcanvas or a signal inlet. */
+    owner = THIS->u_owner;
+    THIS->u_owner = class;
     mess1(&u->u_obj->ob_pd, gensym("dsp"), insig);
+    THIS->u_owner = owner;
+
+        /* now we can free constant inputs whose last reader this was.  The
+        same one might be connected to more than one inlet. */
+    if (!nofreesigs)
+        for (i = 0; i < u->u_nin; i++)
+    {
+        if (insig[i]->s_scalar && !insig[i]->s_refcount)
+        {
+            for (n = 0; n < i; n++)
+                if (insig[n] == insig[i])
+                    break;
+            if (n == i)
+                signal_makereusable(insig[i]);
+        }
+    }
 
         /* if any output signals aren't connected to anyone, free them
         now; otherwise they'll either get freed when the reference count
@@ -1315,6 +1385,41 @@ void dsp_add_scalarcopy(t_float *in, t_sample *out, int n)
         dsp_add(scalarcopy_perf8, 3, in, out, (t_int)n);
 }
 
+    /* replaces the above in the DSP chain when the copy isn't needed */
+static t_int *scalarcopy_skip(t_int *w)
+{
+    return (w+4);
+}
+
+    /* Fill a signal with a value that only changes between DSP blocks,
+    such as the output of sig~ or an unconnected signal inlet.  The signal
+    is marked as constant so that objects reading it can take the value
+    directly from "in" by calling signal_getscalar(), instead of reading
+    the vector.  If all its readers do that, the copy is dropped from the
+    DSP chain when the signal is freed. The signal's reference count must
+    already be set to its number of readers. */
+void dsp_add_scalarsignal(t_float *in, t_signal *sig)
+{
+    dsp_add_scalarcopy(in, sig->s_vec, sig->s_n);
+    sig->s_scalarfill = THIS->u_dspchainsize - 5;
+    sig->s_scalar = in;
+    sig->s_nreaders = sig->s_refcount;
+    sig->s_nscalarreaders = 0;
+}
+
+    /* If a signal input is constant over each block, return a pointer to
+    its value (valid while the DSP chain runs) and count the caller as a
+    reader that won't look at the signal vector, so call it at most once
+    per inlet and only if you're going to use the result.  Returns 0 if
+    the signal isn't known to be constant. */
+t_float *signal_getscalar(t_signal *sig)
+{
+    if (!sig->s_scalar)
+        return (0);
+    sig->s_nscalarreaders++;
+    return (sig->s_scalar);
+}
+
 /* ------------------------ samplerate~~ -------------------------- */
 
 static t_class *samplerate_tilde_class;
@@ -2185,7 +2185,10 @@ void pd_doloadbang(void);
 t_pd *glob_evalfile(t_pd *ignore, t_symbol *name, t_symbol *dir)
 {
     t_pd *x = 0, *boundx;
-    int dspstate;
+    int dspstate, nprefetch = 0, npass = 0, nthread = 0;
+    double starttime = sys_getrealtime(), readtime = starttime,
+        prefetchtime = starttime, evaltime;
+    t_binbuf *b;
 
         /* even though binbuf_evalfile appears to take care of dspstate,
         we have to do it again here, because canvas_startdsp() assumes
@@ -2195,15 +2198,38 @@ t_pd *glob_evalfile(t_pd *ignore, t_symbol *name, t_symbol *dir)
     boundx = s__X.s_thing;
         s__X.s_thing = 0;       /* don't save #X; we'll need to leave it bound
                                 for the caller to grab it. */
-    binbuf_evalfile(name, dir);
+        /* read the file, then read ahead any abstractions it uses (on
+        other threads) before creating the objects. */
+    if ((b = binbuf_readpatch(name, dir)))
+    {
+        readtime = sys_getrealtime();
+        nprefetch = sys_abscache_prefetch(b, dir, &npass, &nthread);
+        prefetchtime = sys_getrealtime();
+        binbuf_evalpatch(b, name, dir);
+        binbuf_free(b);
+    }
     while ((x != s__X.s_thing) && s__X.s_thing)
     {
         x = s__X.s_thing;
         vmess(x, gensym("pop"), "i", 1);
     }
+    evaltime = sys_getrealtime();
+    if (sys_loadtrace)
+    {
+        post("%s: read %.1f msec", name->s_name,
+            1000 * (readtime - starttime));
+        post("... read ahead %d abstraction files in %d passes "
+            "(%d threads): %.1f msec", nprefetch, npass, nthread,
+                1000 * (prefetchtime - readtime));
+        post("... created objects: %.1f msec",
+            1000 * (evaltime - prefetchtime));
+    }
     if (!sys_noloadbang)
         pd_doloadbang();
     canvas_resume_dsp(dspstate);
+    if (sys_loadtrace)
+        post("... loadbang and DSP sort: %.1f msec",
+            1000 * (sys_getrealtime() - evaltime));
     s__X.s_thing = boundx;
     return x;
 }
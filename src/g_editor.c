@@ -1701,6 +1701,8 @@ void canvas_reload(t_symbol *name, t_symbol *dir, t_glist *except)
     t_binbuf*b = 0;
     if(EDITOR->copy_binbuf)
         b = binbuf_duplicate(EDITOR->copy_binbuf);
+        /* don't reuse any cached copy of the file */
+    sys_abscache_clear();
 
     THISGUI->i_reloadingabstraction = except;
         /* find all root canvases */
@@ -57,130 +57,199 @@ void binbuf_clear(t_binbuf *x)
     x->b_n = 0;
 }
 
+    /* character classes for binbuf_text() */
+#define BB_SPACE 1      /* white space */
+#define BB_DELIM 2      /* semicolon or comma */
+#define BB_ESCAPE 4     /* characters needing the careful tokenizer below */
+
+static const unsigned char binbuf_charclass[256] = {
+    [0] = BB_ESCAPE, ['\\'] = BB_ESCAPE, ['$'] = BB_ESCAPE,
+    [' '] = BB_SPACE, ['\t'] = BB_SPACE, ['\n'] = BB_SPACE, ['\r'] = BB_SPACE,
+    [','] = BB_DELIM, [';'] = BB_DELIM,
+};
+
+#define BB_CLASS(c) (binbuf_charclass[(unsigned char)(c)])
+
+    /* state machine that decides whether a token is a float.  Start at zero;
+    states 2, 4, 5, and 8 are complete floats and -1 means it isn't one. */
+static int binbuf_floatstate(int floatstate, char c)
+{
+    int digit = (c >= '0' && c <= '9'),
+        dot = (c == '.'), minus = (c == '-'),
+        plusminus = (minus || (c == '+')),
+        expon = (c == 'e' || c == 'E');
+    if (floatstate == 0)    /* beginning */
+    {
+        if (minus) floatstate = 1;
+        else if (digit) floatstate = 2;
+        else if (dot) floatstate = 3;
+        else floatstate = -1;
+    }
+    else if (floatstate == 1)   /* got minus */
+    {
+        if (digit) floatstate = 2;
+        else if (dot) floatstate = 3;
+        else floatstate = -1;
+    }
+    else if (floatstate == 2)   /* got digits */
+    {
+        if (dot) floatstate = 4;
+        else if (expon) floatstate = 6;
+        else if (!digit) floatstate = -1;
+    }
+    else if (floatstate == 3)   /* got '.' without digits */
+    {
+        if (digit) floatstate = 5;
+        else floatstate = -1;
+    }
+    else if (floatstate == 4)   /* got '.' after digits */
+    {
+        if (digit) floatstate = 5;
+        else if (expon) floatstate = 6;
+        else floatstate = -1;
+    }
+    else if (floatstate == 5)   /* got digits after . */
+    {
+        if (expon) floatstate = 6;
+        else if (!digit) floatstate = -1;
+    }
+    else if (floatstate == 6)   /* got 'e' */
+    {
+        if (plusminus) floatstate = 7;
+        else if (digit) floatstate = 8;
+        else floatstate = -1;
+    }
+    else if (floatstate == 7)   /* got plus or minus */
+    {
+        if (digit) floatstate = 8;
+        else floatstate = -1;
+    }
+    else if (floatstate == 8)   /* got digits */
+    {
+        if (!digit) floatstate = -1;
+    }
+    return (floatstate);
+}
+
+#define BB_ISFLOAT(state) ((state) == 2 || (state) == 4 || (state) == 5 || \
+    (state) == 8)
+
+    /* count the atoms in a text, so that binbuf_text() can allocate them
+    all at once.  This can only overestimate, except for symbols longer
+    than MAXPDSTRING which binbuf_text() splits up. */
+static int binbuf_countatoms(const char *text, size_t size)
+{
+    size_t i;
+    int n = 0, intoken = 0;
+    for (i = 0; i < size; i++)
+    {
+        int class = BB_CLASS(text[i]);
+        if (class & (BB_SPACE|BB_DELIM))
+            n += (class == BB_DELIM), intoken = 0;
+        else n += !intoken, intoken = 1;
+    }
+    return (n);
+}
+
     /* convert text to a binbuf */
 void binbuf_text(t_binbuf *x, const char *text, size_t size)
 {
     char buf[MAXPDSTRING+1], *bufp, *ebuf = buf+MAXPDSTRING;
     const char *textp = text, *etext = text+size;
     t_atom *ap;
-    int nalloc = 16, natom = 0;
+    int nalloc = binbuf_countatoms(text, size) + 1, natom = 0;
     binbuf_clear(x);
     if (!binbuf_resize(x, nalloc)) return;
     ap = x->b_vec;
     while (1)
     {
-        int type;
+        const char *tokp;
+        int floatstate = 0;
             /* skip leading space */
-        while ((textp != etext) && (*textp == ' ' || *textp == '\n'
-            || *textp == '\r' || *textp == '\t')) textp++;
+        while ((textp != etext) && (BB_CLASS(*textp) & BB_SPACE))
+            textp++;
         if (textp == etext) break;
         if (*textp == ';') SETSEMI(ap), textp++;
         else if (*textp == ',') SETCOMMA(ap), textp++;
         else
         {
-                /* it's an atom other than a comma or semi */
-            char c;
-            int floatstate = 0, slash = 0, lastslash = 0, dollar = 0;
-            bufp = buf;
-            do
-            {
-                c = *bufp = *textp++;
-                lastslash = slash;
-                slash = (c == '\\');
-
+                /* most atoms have no backslashes or dollar signs; these we
+                can take straight from the text without copying them. */
+            for (tokp = textp; tokp != etext && !BB_CLASS(*tokp); tokp++)
                 if (floatstate >= 0)
+                    floatstate = binbuf_floatstate(floatstate, *tokp);
+            if ((tokp == etext || !(BB_CLASS(*tokp) & BB_ESCAPE)) &&
+                tokp - textp <= MAXPDSTRING)
+            {
+                    /* short integers (floatstate 2) are common and are
+                    exact, so we needn't call atof() for them */
+                if (floatstate == 2 && tokp - textp < 10)
                 {
-                    int digit = (c >= '0' && c <= '9'),
-                        dot = (c == '.'), minus = (c == '-'),
-                        plusminus = (minus || (c == '+')),
-                        expon = (c == 'e' || c == 'E');
-                    if (floatstate == 0)    /* beginning */
-                    {
-                        if (minus) floatstate = 1;
-                        else if (digit) floatstate = 2;
-                        else if (dot) floatstate = 3;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 1)   /* got minus */
-                    {
-                        if (digit) floatstate = 2;
-                        else if (dot) floatstate = 3;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 2)   /* got digits */
-                    {
-                        if (dot) floatstate = 4;
-                        else if (expon) floatstate = 6;
-                        else if (!digit) floatstate = -1;
-                    }
-                    else if (floatstate == 3)   /* got '.' without digits */
-                    {
-                        if (digit) floatstate = 5;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 4)   /* got '.' after digits */
-                    {
-                        if (digit) floatstate = 5;
-                        else if (expon) floatstate = 6;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 5)   /* got digits after . */
-                    {
-                        if (expon) floatstate = 6;
-                        else if (!digit) floatstate = -1;
-                    }
-                    else if (floatstate == 6)   /* got 'e' */
-                    {
-                        if (plusminus) floatstate = 7;
-                        else if (digit) floatstate = 8;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 7)   /* got plus or minus */
-                    {
-                        if (digit) floatstate = 8;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 8)   /* got digits */
-                    {
-                        if (!digit) floatstate = -1;
-                    }
+                    const char *cp = textp + (*textp == '-');
+                    int n = 0;
+                    while (cp != tokp)
+                        n = 10 * n + (*cp++ - '0');
+                    SETFLOAT(ap, (*textp == '-' ? -(t_float)n : n));
                 }
-                if (!lastslash && c == '$' && (textp != etext &&
-                    textp[0] >= '0' && textp[0] <= '9'))
-                        dollar = 1;
-                if (!slash) bufp++;
-                else if (lastslash)
+                else if (BB_ISFLOAT(floatstate))
                 {
-                    bufp++;
-                    slash = 0;
+                    memcpy(buf, textp, tokp - textp);
+                    buf[tokp - textp] = 0;
+                    SETFLOAT(ap, atof(buf));
                 }
+                else SETSYMBOL(ap, gensymn(textp, (int)(tokp - textp)));
+                textp = tokp;
             }
-            while (textp != etext && bufp != ebuf &&
-                (slash || (*textp != ' ' && *textp != '\n' && *textp != '\r'
-                    && *textp != '\t' &&*textp != ',' && *textp != ';')));
-            *bufp = 0;
+            else
+            {
+                    /* otherwise go through it character by character */
+                char c;
+                int slash = 0, lastslash = 0, dollar = 0;
+                floatstate = 0;
+                bufp = buf;
+                do
+                {
+                    c = *bufp = *textp++;
+                    lastslash = slash;
+                    slash = (c == '\\');
+
+                    if (floatstate >= 0)
+                        floatstate = binbuf_floatstate(floatstate, c);
+                    if (!lastslash && c == '$' && (textp != etext &&
+                        textp[0] >= '0' && textp[0] <= '9'))
+                            dollar = 1;
+                    if (!slash) bufp++;
+                    else if (lastslash)
+                    {
+                        bufp++;
+                        slash = 0;
+                    }
+                }
+                while (textp != etext && bufp != ebuf &&
+                    (slash || !(BB_CLASS(*textp) & (BB_SPACE|BB_DELIM))));
+                *bufp = 0;
 #if 0
-            post("binbuf_text: buf %s", buf);
+                post("binbuf_text: buf %s", buf);
 #endif
-            if (floatstate == 2 || floatstate == 4 || floatstate == 5 ||
-                floatstate == 8)
+                if (BB_ISFLOAT(floatstate))
                     SETFLOAT(ap, atof(buf));
-                /* LATER try to figure out how to mix "$" and "\$" correctly;
-                here, the backslashes were already stripped so we assume all
-                "$" chars are real dollars.  In fact, we only know at least one
-                was. */
-            else if (dollar)
-            {
-                if (buf[0] != '$')
-                    dollar = 0;
-                for (bufp = buf+1; *bufp; bufp++)
-                    if (*bufp < '0' || *bufp > '9')
+                    /* LATER try to figure out how to mix "$" and "\$"
+                    correctly; here, the backslashes were already stripped so
+                    we assume all "$" chars are real dollars.  In fact, we
+                    only know at least one was. */
+                else if (dollar)
+                {
+                    if (buf[0] != '$')
                         dollar = 0;
-                if (dollar)
-                    SETDOLLAR(ap, atoi(buf+1));
-                else SETDOLLSYM(ap, gensym(buf));
+                    for (bufp = buf+1; *bufp; bufp++)
+                        if (*bufp < '0' || *bufp > '9')
+                            dollar = 0;
+                    if (dollar)
+                        SETDOLLAR(ap, atoi(buf+1));
+                    else SETDOLLSYM(ap, gensym(buf));
+                }
+                else SETSYMBOL(ap, gensym(buf));
             }
-            else SETSYMBOL(ap, gensym(buf));
         }
         ap++;
         natom++;
@@ -847,6 +916,15 @@ int binbuf_read(t_binbuf *b, const char *filename, const char *dirname, int crfl
         close(fd);
         t_freebytes(buf, length);
         return(1);
+    }
+    if (binbuf_isbinary(buf, length))
+    {
+        int bad = binbuf_setbinary(b, buf, length);
+        if (bad)
+            pd_error(0, "%s: bad binary file", namebuf);
+        t_freebytes(buf, length);
+        close(fd);
+        return (bad);
     }
         /* optionally map carriage return to semicolon */
     if (crflag)
@@ -903,6 +981,460 @@ int binbuf_read_via_path(t_binbuf *b, const char *filename, const char *dirname,
     else return (0);
 }
 
+/* Binbufs can also be stored in a binary format, which is faster to load
+than text since nothing has to be tokenized and each symbol is interned
+only once.  The format is: a header of four magic bytes, a version number,
+the size of a float in bytes, and two zero bytes, then the number of symbols
+and of atoms as 32-bit integers.  Then come the symbols' names, each
+terminated by a null, and then the atoms, each a tag byte (below) followed
+by a float, an integer, a symbol number, or a dollar number as appropriate.
+Numbers are little-endian.  Floats with integer values are stored as
+integers, which are written seven bits per byte, the high bit meaning that
+more bytes follow; negative ones are stored as 2 * |n| - 1.  binbuf_read() recognizes binary files
+by their header; binbuf_write() writes one if the file name ends in
+".pdbin". */
+
+#define BINMAGIC "PdB"      /* plus the terminating null */
+#define BINVERSION 1
+#define BINHEADSIZE 16
+
+#define BIN_FLOAT 1
+#define BIN_INT 2
+#define BIN_SYMBOL 3
+#define BIN_DOLLSYM 4
+#define BIN_DOLLAR 5
+#define BIN_SEMI 6
+#define BIN_COMMA 7
+
+typedef struct _binout
+{
+    unsigned char *o_buf;
+    size_t o_size;
+    size_t o_n;
+} t_binout;
+
+static void binout_reserve(t_binout *o, size_t n)
+{
+    if (o->o_n + n > o->o_size)
+    {
+        size_t newsize = 2 * o->o_size + n;
+        o->o_buf = (unsigned char *)t_resizebytes(o->o_buf, o->o_size, newsize);
+        o->o_size = newsize;
+    }
+}
+
+static void binout_int(t_binout *o, unsigned int n)
+{
+    binout_reserve(o, 5);
+    while (n >= 0x80)
+        o->o_buf[o->o_n++] = (n & 0x7f) | 0x80, n >>= 7;
+    o->o_buf[o->o_n++] = n;
+}
+
+static void binout_float(t_binout *o, t_float f)
+{
+#if PD_FLOATSIZE == 32
+    uint32_t bits;
+#else
+    uint64_t bits;
+#endif
+    t_float g;
+    unsigned int j;
+        /* integers, but not -0, go in the shorter form */
+    if (f > -0x40000000 && f < 0x40000000 &&
+        (g = (int)f, !memcmp(&f, &g, sizeof(f))))
+    {
+        int k = (int)f;
+        binout_reserve(o, 1);
+        o->o_buf[o->o_n++] = BIN_INT;
+        binout_int(o, (k < 0 ? -2 * k - 1 : 2 * k));
+        return;
+    }
+    memcpy(&bits, &f, sizeof(bits));
+    binout_reserve(o, 1 + sizeof(bits));
+    o->o_buf[o->o_n++] = BIN_FLOAT;
+    for (j = 0; j < sizeof(bits); j++, bits >>= 8)
+        o->o_buf[o->o_n++] = (unsigned char)bits;
+}
+
+static void binout_put32(unsigned char *bp, unsigned int n)
+{
+    bp[0] = n; bp[1] = n >> 8; bp[2] = n >> 16; bp[3] = n >> 24;
+}
+
+static unsigned int binin_get32(const unsigned char *bp)
+{
+    return (bp[0] | (bp[1] << 8) | (bp[2] << 16) | ((unsigned int)bp[3] << 24));
+}
+
+    /* hash a symbol's address, for numbering the symbols when writing */
+#define BINSYMHASH(s, size) \
+    ((((unsigned int)((size_t)(s) >> 3) * 2654435761u) >> 12) & ((size) - 1))
+
+    /* convert a binbuf to the binary format.  The result is allocated with
+    getbytes() and should be freed by the caller. */
+void binbuf_getbinary(const t_binbuf *x, char **bufp, int *lengthp)
+{
+    t_binout o;
+    t_symbol **symtab;
+    int *symnum, hashsize, nsym = 0, natom = 0, i;
+    const t_atom *ap;
+    unsigned int h;
+    for (hashsize = 64; hashsize < 2 * x->b_n; hashsize *= 2)
+        ;
+    symtab = (t_symbol **)getbytes(hashsize * sizeof(*symtab));
+    symnum = (int *)getbytes(hashsize * sizeof(*symnum));
+    o.o_size = BINHEADSIZE + x->b_n * 3;
+    o.o_buf = (unsigned char *)getbytes(o.o_size);
+    o.o_n = BINHEADSIZE;
+        /* first number the symbols and write out their names */
+    for (ap = x->b_vec, i = x->b_n; i--; ap++)
+    {
+        t_symbol *s;
+        if (ap->a_type == A_SYMBOL || ap->a_type == A_DOLLSYM)
+            s = ap->a_w.w_symbol;
+        else if (ap->a_type == A_POINTER)
+            s = gensym("(pointer)");    /* as in atom_string() */
+        else continue;
+        for (h = BINSYMHASH(s, hashsize); symtab[h] && symtab[h] != s;
+            h = (h + 1) & (hashsize - 1))
+                ;
+        if (!symtab[h])
+        {
+            size_t len = strlen(s->s_name) + 1;
+            symtab[h] = s;
+            symnum[h] = nsym++;
+            binout_reserve(&o, len);
+            memcpy(o.o_buf + o.o_n, s->s_name, len);
+            o.o_n += len;
+        }
+    }
+        /* then the atoms */
+    for (ap = x->b_vec, i = x->b_n; i--; ap++)
+    {
+        t_symbol *s = 0;
+        switch (ap->a_type)
+        {
+        case A_FLOAT:
+            binout_float(&o, ap->a_w.w_float);
+            break;
+        case A_SYMBOL: case A_DOLLSYM:
+            s = ap->a_w.w_symbol;
+            break;
+        case A_POINTER:
+            s = gensym("(pointer)");
+            break;
+        case A_DOLLAR:
+            binout_reserve(&o, 1);
+            o.o_buf[o.o_n++] = BIN_DOLLAR;
+            binout_int(&o, ap->a_w.w_index);
+            break;
+        case A_SEMI: case A_COMMA:
+            binout_reserve(&o, 1);
+            o.o_buf[o.o_n++] = (ap->a_type == A_SEMI ? BIN_SEMI : BIN_COMMA);
+            break;
+        default:
+            bug("binbuf_getbinary");
+            continue;
+        }
+        if (s)
+        {
+            for (h = BINSYMHASH(s, hashsize); symtab[h] != s;
+                h = (h + 1) & (hashsize - 1))
+                    ;
+            binout_reserve(&o, 1);
+            o.o_buf[o.o_n++] =
+                (ap->a_type == A_DOLLSYM ? BIN_DOLLSYM : BIN_SYMBOL);
+            binout_int(&o, symnum[h]);
+        }
+        natom++;
+    }
+    memcpy(o.o_buf, BINMAGIC, 4);
+    o.o_buf[4] = BINVERSION;
+    o.o_buf[5] = sizeof(t_float);
+    o.o_buf[6] = o.o_buf[7] = 0;
+    binout_put32(o.o_buf + 8, nsym);
+    binout_put32(o.o_buf + 12, natom);
+    freebytes(symtab, hashsize * sizeof(*symtab));
+    freebytes(symnum, hashsize * sizeof(*symnum));
+        /* trim to size */
+    *bufp = (char *)t_resizebytes(o.o_buf, o.o_size, o.o_n);
+    *lengthp = (int)o.o_n;
+}
+
+    /* check whether a buffer holds a binbuf in binary format */
+int binbuf_isbinary(const char *buf, size_t length)
+{
+    return (length >= BINHEADSIZE && !memcmp(buf, BINMAGIC, 4));
+}
+
+static int binin_int(const unsigned char **bpp, const unsigned char *ep,
+    unsigned int *result)
+{
+    const unsigned char *bp = *bpp;
+    unsigned int n = 0, shift = 0;
+    do
+    {
+        if (bp == ep || shift > 28)
+            return (0);
+        n |= (unsigned int)(*bp & 0x7f) << shift;
+        shift += 7;
+    } while (*bp++ & 0x80);
+    *bpp = bp;
+    *result = n;
+    return (1);
+}
+
+    /* read a float of 4 or 8 bytes, whatever our own float size */
+static int binin_float(const unsigned char **bpp, const unsigned char *ep,
+    int floatsize, t_atom *ap)
+{
+    const unsigned char *bp = *bpp;
+    uint64_t bits = 0;
+    int j;
+    if (ep - bp < floatsize)
+        return (0);
+    for (j = floatsize; j--; )
+        bits = (bits << 8) | bp[j];
+    *bpp = bp + floatsize;
+    if (floatsize == 4)
+    {
+        uint32_t bits32 = (uint32_t)bits;
+        float f;
+        memcpy(&f, &bits32, 4);
+        SETFLOAT(ap, f);
+    }
+    else
+    {
+        double f;
+        memcpy(&f, &bits, 8);
+        SETFLOAT(ap, f);
+    }
+    return (1);
+}
+
+    /* set a binbuf from the binary format.  Returns 0 on success or 1 if
+    the buffer isn't valid, leaving the binbuf empty. */
+int binbuf_setbinary(t_binbuf *x, const char *buf, size_t length)
+{
+    const unsigned char *bp = (const unsigned char *)buf, *ep = bp + length;
+    unsigned int nsym, natom, i, n;
+    int floatsize;
+    const char **names = 0;
+    t_symbol **syms = 0;
+    t_atom *ap;
+    binbuf_clear(x);
+    if (!binbuf_isbinary(buf, length) || bp[4] != BINVERSION ||
+        (bp[5] != 4 && bp[5] != 8))
+            return (1);
+    floatsize = bp[5];
+    nsym = binin_get32(bp + 8);
+    natom = binin_get32(bp + 12);
+        /* each symbol takes at least one byte and each atom at least one */
+    if (nsym > length || natom > length)
+        return (1);
+    bp += BINHEADSIZE;
+    names = (const char **)getbytes((nsym + 1) * sizeof(*names));
+    syms = (t_symbol **)getbytes((nsym + 1) * sizeof(*syms));
+    for (i = 0; i < nsym; i++)
+    {
+        const unsigned char *nul = memchr(bp, 0, ep - bp);
+        if (!nul)
+            goto fail;
+        names[i] = (const char *)bp;
+        bp = nul + 1;
+    }
+    gensymv(nsym, names, syms);
+    if (!binbuf_resize(x, natom))
+        goto fail;
+    for (i = 0, ap = x->b_vec; i < natom; i++, ap++)
+    {
+        if (bp == ep)
+            goto fail;
+        switch (*bp++)
+        {
+        case BIN_INT:
+            if (!binin_int(&bp, ep, &n))
+                goto fail;
+            SETFLOAT(ap, (n & 1 ? -(int)(n >> 1) - 1 : (int)(n >> 1)));
+            break;
+        case BIN_FLOAT:
+            if (!binin_float(&bp, ep, floatsize, ap))
+                goto fail;
+            break;
+        case BIN_SYMBOL:
+            if (!binin_int(&bp, ep, &n) || n >= nsym)
+                goto fail;
+            SETSYMBOL(ap, syms[n]);
+            break;
+        case BIN_DOLLSYM:
+            if (!binin_int(&bp, ep, &n) || n >= nsym)
+                goto fail;
+            SETDOLLSYM(ap, syms[n]);
+            break;
+        case BIN_DOLLAR:
+            if (!binin_int(&bp, ep, &n))
+                goto fail;
+            SETDOLLAR(ap, n);
+            break;
+        case BIN_SEMI:
+            SETSEMI(ap);
+            break;
+        case BIN_COMMA:
+            SETCOMMA(ap);
+            break;
+        default:
+            goto fail;
+        }
+    }
+    freebytes(names, (nsym + 1) * sizeof(*names));
+    freebytes(syms, (nsym + 1) * sizeof(*syms));
+    return (0);
+fail:
+    binbuf_clear(x);
+    freebytes(names, (nsym + 1) * sizeof(*names));
+    freebytes(syms, (nsym + 1) * sizeof(*syms));
+    return (1);
+}
+
+/* The same atom encoding carries messages between Pd instances over the
+network ("netsend -t" and "netreceive -t"), sparing the conversion to and
+from text.  Each message is a 32-bit count of the bytes that follow, then
+the size of a float in bytes, then the atoms, with symbols' names written in
+place (null-terminated) rather than as symbol numbers. */
+
+#define NETHEADSIZE 5
+
+    /* append a message to a buffer allocated by getbytes(), growing it as
+    needed.  *sizep is the buffer's allocated size and *lengthp the number of
+    bytes in use. */
+void binbuf_putnetmessage(char **bufp, int *sizep, int *lengthp,
+    int argc, const t_atom *argv)
+{
+    t_binout o;
+    size_t onset = *lengthp, len;
+    o.o_buf = (unsigned char *)*bufp;
+    o.o_size = *sizep;
+    o.o_n = onset;
+    binout_reserve(&o, NETHEADSIZE);
+    o.o_n += NETHEADSIZE;
+    for (; argc--; argv++)
+    {
+        const char *name;
+        switch (argv->a_type)
+        {
+        case A_FLOAT:
+            binout_float(&o, argv->a_w.w_float);
+            continue;
+        case A_DOLLAR:
+            binout_reserve(&o, 1);
+            o.o_buf[o.o_n++] = BIN_DOLLAR;
+            binout_int(&o, argv->a_w.w_index);
+            continue;
+        case A_SEMI: case A_COMMA:
+            binout_reserve(&o, 1);
+            o.o_buf[o.o_n++] = (argv->a_type == A_SEMI ? BIN_SEMI : BIN_COMMA);
+            continue;
+        case A_SYMBOL: case A_DOLLSYM:
+            name = argv->a_w.w_symbol->s_name;
+            break;
+        default:
+            name = "(pointer)";     /* as in atom_string() */
+            break;
+        }
+        len = strlen(name) + 1;
+        binout_reserve(&o, 1 + len);
+        o.o_buf[o.o_n++] = (argv->a_type == A_DOLLSYM ?
+            BIN_DOLLSYM : BIN_SYMBOL);
+        memcpy(o.o_buf + o.o_n, name, len);
+        o.o_n += len;
+    }
+    binout_put32(o.o_buf + onset, (unsigned int)(o.o_n - onset - 4));
+    o.o_buf[onset + 4] = sizeof(t_float);
+    *bufp = (char *)o.o_buf;
+    *sizep = (int)o.o_size;
+    *lengthp = (int)o.o_n;
+}
+
+    /* the size of the message starting at buf, or zero if we don't have
+    enough of it to tell.  This is also called from the network thread. */
+int binbuf_netmessagesize(const char *buf, int length)
+{
+    unsigned int n;
+    if (length < 4)
+        return (0);
+    n = binin_get32((const unsigned char *)buf);
+    return (n > 0x7fff0000 ? 0x7fff0000 : (int)n + 4);
+}
+
+    /* append one or more messages to a binbuf, each followed by a
+    semicolon.  Returns 0 on success or 1 if the data are malformed, in
+    which case the messages before the bad one are kept. */
+int binbuf_addnetmessages(t_binbuf *x, const char *buf, int length)
+{
+    const unsigned char *bp = (const unsigned char *)buf, *ep = bp + length,
+        *mp, *nul;
+    int natom = x->b_n, floatsize;
+    unsigned int n;
+    t_atom *ap;
+    while (bp < ep)
+    {
+        if (ep - bp < NETHEADSIZE || binin_get32(bp) < NETHEADSIZE - 4 ||
+            binin_get32(bp) > (unsigned int)(ep - bp - 4) ||
+                ((floatsize = bp[4]) != 4 && floatsize != 8))
+                    goto fail;
+        mp = bp + 4 + binin_get32(bp);
+        bp += NETHEADSIZE;
+            /* each atom takes at least a byte; we trim the binbuf below */
+        if (natom + (mp - bp) + 1 > x->b_n &&
+            !binbuf_resize(x, natom + (int)(mp - bp) + 1))
+                goto fail;
+        for (ap = x->b_vec + natom; bp < mp; ap++)
+        {
+            switch (*bp++)
+            {
+            case BIN_INT:
+                if (!binin_int(&bp, mp, &n))
+                    goto fail;
+                SETFLOAT(ap, (n & 1 ? -(int)(n >> 1) - 1 : (int)(n >> 1)));
+                break;
+            case BIN_FLOAT:
+                if (!binin_float(&bp, mp, floatsize, ap))
+                    goto fail;
+                break;
+            case BIN_SYMBOL: case BIN_DOLLSYM:
+                if (!(nul = memchr(bp, 0, mp - bp)))
+                    goto fail;
+                if (bp[-1] == BIN_SYMBOL)
+                    SETSYMBOL(ap, gensym((const char *)bp));
+                else SETDOLLSYM(ap, gensym((const char *)bp));
+                bp = nul + 1;
+                break;
+            case BIN_DOLLAR:
+                if (!binin_int(&bp, mp, &n))
+                    goto fail;
+                SETDOLLAR(ap, n);
+                break;
+            case BIN_SEMI:
+                SETSEMI(ap);
+                break;
+            case BIN_COMMA:
+                SETCOMMA(ap);
+                break;
+            default:
+                goto fail;
+            }
+        }
+        SETSEMI(ap);
+        natom = (int)(ap + 1 - x->b_vec);
+    }
+    binbuf_resize(x, natom);
+    return (0);
+fail:
+    binbuf_resize(x, natom);
+    return (1);
+}
+
 #define WBUFSIZE 4096
 static t_binbuf *binbuf_convert(const t_binbuf *oldb, int maxtopd);
 
@@ -930,6 +1462,21 @@ int binbuf_write(const t_binbuf *x, const char *filename, const char *dir, int c
         z = y;
     }
 
+    if (strlen(filename) > 6 &&
+        !strcmp(filename + strlen(filename) - 6, ".pdbin"))
+    {
+        char *bbuf;
+        int blength, ok;
+        if (!(f = sys_fopen(fbuf, "wb")))
+            goto fail;
+        binbuf_getbinary(z, &bbuf, &blength);
+        ok = (fwrite(bbuf, blength, 1, f) == 1 && fflush(f) == 0);
+        t_freebytes(bbuf, blength);
+        if (!ok)
+            goto fail;
+        fclose(f);
+        return (0);
+    }
     if (!(f = sys_fopen(fbuf, "w")))
         goto fail;
     for (ap = z->b_vec, indx = z->b_n; indx--; ap++)
@@ -1463,42 +2010,64 @@ static t_binbuf *binbuf_convert(const t_binbuf *oldb, int maxtopd)
     return (newb);
 }
 
-/* LATER make this evaluate the file on-the-fly. */
-/* LATER figure out how to log errors */
-void binbuf_evalfile(t_symbol *name, t_symbol *dir)
+    /* read a patch file into a new binbuf, converting it from Max format
+    if the extension is ".pat" or ".mxt".  Returns 0 if the file can't be
+    read.  This and binbuf_evalpatch() are the two halves of
+    binbuf_evalfile(), split so that abstractions can be cached between
+    them (see do_create_abstraction() in s_loader.c). */
+t_binbuf *binbuf_readpatch(t_symbol *name, t_symbol *dir)
 {
     t_binbuf *b = binbuf_new();
     int import = !strcmp(name->s_name + strlen(name->s_name) - 4, ".pat") ||
         !strcmp(name->s_name + strlen(name->s_name) - 4, ".mxt");
-    int dspstate = canvas_suspend_dsp();
-        /* set filename so that new canvases can pick them up */
-    glob_setfilename(0, name, dir);
     if (binbuf_read(b, name->s_name, dir->s_name, 0))
+    {
         pd_error(0, "%s: read failed; %s", name->s_name, strerror(errno));
-    else
+        binbuf_free(b);
+        return (0);
+    }
+    if (import)
     {
-            /* save bindings of symbols #N, #A (and restore afterward) */
-        t_pd *bounda = gensym("#A")->s_thing, *boundn = s__N.s_thing;
-        gensym("#A")->s_thing = 0;
-        s__N.s_thing = &pd_canvasmaker;
-        if (import)
-        {
-            t_binbuf *newb = binbuf_convert(b, 1);
-            binbuf_free(b);
-            b = newb;
-        }
-        binbuf_eval(b, 0, 0, 0);
-            /* avoid crashing if no canvas was created by binbuf eval */
-        if (s__X.s_thing && *s__X.s_thing == canvas_class)
-            canvas_initbang((t_canvas *)(s__X.s_thing)); /* JMZ*/
-        gensym("#A")->s_thing = bounda;
-        s__N.s_thing = boundn;
+        t_binbuf *newb = binbuf_convert(b, 1);
+        binbuf_free(b);
+        b = newb;
     }
+    return (b);
+}
+
+    /* evaluate a patch that was read from "name" in "dir".  The binbuf
+    isn't changed so it may be evaluated again. */
+void binbuf_evalpatch(const t_binbuf *b, t_symbol *name, t_symbol *dir)
+{
+    int dspstate = canvas_suspend_dsp();
+        /* save bindings of symbols #N, #A (and restore afterward) */
+    t_pd *bounda = gensym("#A")->s_thing, *boundn = s__N.s_thing;
+        /* set filename so that new canvases can pick them up */
+    glob_setfilename(0, name, dir);
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+    binbuf_eval(b, 0, 0, 0);
+        /* avoid crashing if no canvas was created by binbuf eval */
+    if (s__X.s_thing && *s__X.s_thing == canvas_class)
+        canvas_initbang((t_canvas *)(s__X.s_thing)); /* JMZ*/
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
     glob_setfilename(0, &s_, &s_);
-    binbuf_free(b);
     canvas_resume_dsp(dspstate);
 }
 
+/* LATER make this evaluate the file on-the-fly. */
+/* LATER figure out how to log errors */
+void binbuf_evalfile(t_symbol *name, t_symbol *dir)
+{
+    t_binbuf *b = binbuf_readpatch(name, dir);
+    if (b)
+    {
+        binbuf_evalpatch(b, name, dir);
+        binbuf_free(b);
+    }
+}
+
     /* save a text object to a binbuf for a file or copy buf */
 void binbuf_savetext(const t_binbuf *bfrom, t_binbuf *bto)
 {
@@ -18,6 +18,9 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#if PDTHREADS
+#include <pthread.h>
+#endif
 
 #ifdef _MSC_VER  /* This is only for Microsoft's compiler, not cygwin, e.g. */
 #define snprintf _snprintf
@@ -63,23 +66,34 @@ void s_stuff_newpdinstance(void)
     STUFF->st_dacsr = DEFDACSAMPLERATE;
     STUFF->st_printhook = sys_printhook;
     STUFF->st_impdata = NULL;
+    STUFF->st_abscache = NULL;
+    STUFF->st_pathcache = NULL;
+    STUFF->st_rtpool = NULL;
+    STUFF->st_netthread = NULL;
+    STUFF->st_oscbindgen = 0;
+    STUFF->st_osctrie = NULL;
+    STUFF->st_netpending = NULL;
 }
 
 void s_stuff_freepdinstance(void)
 {
+    sys_abscache_free();
+    sys_pathcache_clear();
+    rtpool_free();
+    netthread_free();
+    osctrie_free();
     freebytes(STUFF, sizeof(*STUFF));
 }
 
 static t_pdinstance *pdinstance_init(t_pdinstance *x)
 {
-    int i;
     x->pd_systime = 0;
     x->pd_clock_setlist = 0;
     x->pd_canvaslist = 0;
     x->pd_templatelist = 0;
     x->pd_symhash = getbytes(SYMTABHASHSIZE * sizeof(*x->pd_symhash));
-    for (i = 0; i < SYMTABHASHSIZE; i++)
-        x->pd_symhash[i] = 0;
+    x->pd_symhashsize = SYMTABHASHSIZE;
+    x->pd_nsymbols = 0;
 #ifdef PDINSTANCE
     dogensym("pointer",   &x->pd_s_pointer,  x);
     dogensym("float",     &x->pd_s_float,    x);
@@ -143,6 +157,92 @@ static void class_addmethodtolist(t_class *c, t_methodentry **methodlist,
     memcpy(m->me_arg, args, MAXPDARG+1);
 }
 
+    /* classes with more than a few methods (GUI objects, and especially
+    pd_objectmaker which has one for every object name) get an open-addressing
+    hash table from selector to method so that messages don't need a linear
+    search.  Each slot holds the method's index plus one, or zero if empty.
+    The table is rebuilt whenever a method is added, since that may also
+    rename an older method (see above). */
+#define METHODHASHMIN 8
+
+#define METHODHASH(s, size) \
+    ((((unsigned int)((size_t)(s) >> 3) * 2654435761u) >> 12) & ((size) - 1))
+
+static void class_hashmethodlist(t_methodentry *mlist, int nmethod,
+    int *hash, int hashsize)
+{
+    int i;
+    unsigned int h;
+    memset(hash, 0, hashsize * sizeof(*hash));
+    for (i = 0; i < nmethod; i++)
+    {
+            /* probe past earlier entries so that, as in a linear search,
+            the first of any methods with the same name is found */
+        for (h = METHODHASH(mlist[i].me_name, hashsize); hash[h];
+            h = (h + 1) & (hashsize - 1))
+                ;
+        hash[h] = i + 1;
+    }
+}
+
+static void class_rehash(t_class *c)
+{
+    int newsize = 0;
+#ifdef PDINSTANCE
+    int i;
+#endif
+    if (c->c_nmethod >= METHODHASHMIN)
+        for (newsize = METHODHASHMIN; newsize < 2 * c->c_nmethod; newsize *= 2)
+            ;
+#ifdef PDINSTANCE
+    for (i = 0; i < pd_ninstances; i++)
+    {
+        c->c_methodhash[i] = (int *)t_resizebytes(c->c_methodhash[i],
+            c->c_methodhashsize * sizeof(int), newsize * sizeof(int));
+        if (newsize)
+            class_hashmethodlist(c->c_methods[i], c->c_nmethod,
+                c->c_methodhash[i], newsize);
+    }
+#else
+    c->c_methodhash = (int *)t_resizebytes(c->c_methodhash,
+        c->c_methodhashsize * sizeof(int), newsize * sizeof(int));
+    if (newsize)
+        class_hashmethodlist(c->c_methods, c->c_nmethod,
+            c->c_methodhash, newsize);
+#endif
+    c->c_methodhashsize = newsize;
+}
+
+    /* find the method for a selector, or return 0 if none */
+static t_methodentry *class_findmethod(const t_class *c, t_symbol *s)
+{
+    t_methodentry *m, *mlist;
+    int i;
+#ifdef PDINSTANCE
+    mlist = c->c_methods[pd_this->pd_instanceno];
+#else
+    mlist = c->c_methods;
+#endif
+    if (c->c_methodhashsize)
+    {
+        unsigned int h, mask = c->c_methodhashsize - 1;
+#ifdef PDINSTANCE
+        int *hash = c->c_methodhash[pd_this->pd_instanceno];
+#else
+        int *hash = c->c_methodhash;
+#endif
+        for (h = METHODHASH(s, c->c_methodhashsize); (i = hash[h]);
+            h = (h + 1) & mask)
+                if (mlist[i-1].me_name == s)
+                    return (&mlist[i-1]);
+        return (0);
+    }
+    for (i = c->c_nmethod, m = mlist; i--; m++)
+        if (m->me_name == s)
+            return (m);
+    return (0);
+}
+
 #ifdef PDINSTANCE
 EXTERN void pd_setinstance(t_pdinstance *x)
 {
@@ -184,6 +284,14 @@ EXTERN t_pdinstance *pdinstance_new(void)
                 c->c_methods[0][i].me_fun,
                 dogensym(c->c_methods[0][i].me_name->s_name, 0, x),
                     c->c_methods[0][i].me_arg, x);
+        c->c_methodhash = (int **)t_resizebytes(c->c_methodhash,
+            pd_ninstances * sizeof(*c->c_methodhash),
+            (pd_ninstances + 1) * sizeof(*c->c_methodhash));
+        c->c_methodhash[pd_ninstances] =
+            t_getbytes(c->c_methodhashsize * sizeof(int));
+        if (c->c_methodhashsize)
+            class_hashmethodlist(c->c_methods[pd_ninstances], c->c_nmethod,
+                c->c_methodhash[pd_ninstances], c->c_methodhashsize);
     }
     pd_ninstances++;
     pdinstance_renumber();
@@ -224,8 +332,15 @@ EXTERN void pdinstance_free(t_pdinstance *x)
         c->c_methods = (t_methodentry **)t_resizebytes(c->c_methods,
             pd_ninstances * sizeof(*c->c_methods),
             (pd_ninstances - 1) * sizeof(*c->c_methods));
+        freebytes(c->c_methodhash[instanceno],
+            c->c_methodhashsize * sizeof(int));
+        for (i = instanceno; i < pd_ninstances-1; i++)
+            c->c_methodhash[i] = c->c_methodhash[i+1];
+        c->c_methodhash = (int **)t_resizebytes(c->c_methodhash,
+            pd_ninstances * sizeof(*c->c_methodhash),
+            (pd_ninstances - 1) * sizeof(*c->c_methodhash));
     }
-    for (i =0; i < SYMTABHASHSIZE; i++)
+    for (i = 0; i < x->pd_symhashsize; i++)
     {
         while ((s = x->pd_symhash[i]))
         {
@@ -243,12 +358,13 @@ EXTERN void pdinstance_free(t_pdinstance *x)
                s != &x->pd_s_y &&
                s != &x->pd_s_)
             {
-                freebytes((void *)s->s_name, strlen(s->s_name)+1);
+                freebytes((t_symbolname *)s->s_name - 1,
+                    sizeof(t_symbolname) + symbol_length(s) + 1);
                 freebytes(s, sizeof(*s));
             }
         }
     }
-    freebytes(x->pd_symhash, SYMTABHASHSIZE * sizeof (*x->pd_symhash));
+    freebytes(x->pd_symhash, x->pd_symhashsize * sizeof (*x->pd_symhash));
     x_midi_freepdinstance();
     g_canvas_freepdinstance();
     d_ugen_freepdinstance();
@@ -498,15 +614,19 @@ t_class *class_new(t_symbol *s, t_newmethod newmethod, t_method freemethod,
     c->c_externdir = class_extern_dir;
     c->c_savefn = (typeflag == CLASS_PATCHABLE ? text_save : class_nosavefn);
     c->c_classfreefn = 0;
+    c->c_methodhashsize = 0;
 #ifdef PDINSTANCE
     c->c_methods = (t_methodentry **)t_getbytes(
         pd_ninstances * sizeof(*c->c_methods));
+    c->c_methodhash = (int **)t_getbytes(
+        pd_ninstances * sizeof(*c->c_methodhash));
     for (i = 0; i < pd_ninstances; i++)
-        c->c_methods[i] = t_getbytes(0);
+        c->c_methods[i] = t_getbytes(0), c->c_methodhash[i] = t_getbytes(0);
     c->c_next = class_list;
     class_list = c;
 #else
     c->c_methods = t_getbytes(0);
+    c->c_methodhash = t_getbytes(0);
 #endif
 #if 0       /* enable this if you want to see a list of all classes */
     post("class: %s", c->c_name->s_name);
@@ -537,10 +657,13 @@ void class_free(t_class *c)
         if(c->c_methods[i])
             freebytes(c->c_methods[i], c->c_nmethod * sizeof(*c->c_methods[i]));
         c->c_methods[i] = NULL;
+        freebytes(c->c_methodhash[i], c->c_methodhashsize * sizeof(int));
     }
     freebytes(c->c_methods, pd_ninstances * sizeof(*c->c_methods));
+    freebytes(c->c_methodhash, pd_ninstances * sizeof(*c->c_methodhash));
 #else
     freebytes(c->c_methods, c->c_nmethod * sizeof(*c->c_methods));
+    freebytes(c->c_methodhash, c->c_methodhashsize * sizeof(int));
 #endif
     freebytes(c, sizeof(*c));
 }
@@ -662,6 +785,7 @@ void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
             (t_gotfn)fn, sel, argvec, &pd_maininstance);
 #endif
         c->c_nmethod++;
+        class_rehash(c);
     }
     goto done;
 phooey:
@@ -840,44 +964,138 @@ t_propertiesfn class_getpropertiesfn(const t_class *c)
 
 /* ---------------- the symbol table ------------------------ */
 
-static t_symbol *dogensym(const char *s, t_symbol *oldsym,
-    t_pdinstance *pdinstance)
+    /* the symbol table is a hash table with chaining, which doubles in size
+    whenever the number of symbols exceeds the number of slots.  Names are
+    hashed with 32-bit FNV-1a; the hash and length are stored with each name
+    (see m_imp.h) so that they needn't be recomputed to grow the table, and
+    so that strings only have to be compared when the hashes match. */
+#define SYMHASHINIT 2166136261u
+#define SYMHASHSTEP(hash, c) (((hash) ^ (unsigned char)(c)) * 16777619u)
+
+static void symtab_resize(t_pdinstance *pdinstance, int newsize)
 {
-    char *symname = 0;
-    t_symbol **symhashloc, *sym2;
-    unsigned int hash = 5381;
-    int length = 0;
-    const char *s2 = s;
-    while (*s2) /* djb2 hash algo */
+    t_symbol **newhash = (t_symbol **)getbytes(newsize * sizeof(*newhash)),
+        *sym, *next;
+    int i;
+    for (i = 0; i < pdinstance->pd_symhashsize; i++)
+        for (sym = pdinstance->pd_symhash[i]; sym; sym = next)
     {
-        hash = ((hash << 5) + hash) + *s2;
-        length++;
-        s2++;
+        t_symbol **loc = newhash + (symbol_hash(sym) & (newsize-1));
+        next = sym->s_next;
+        sym->s_next = *loc;
+        *loc = sym;
     }
-    symhashloc = pdinstance->pd_symhash + (hash & (SYMTABHASHSIZE-1));
+    freebytes(pdinstance->pd_symhash,
+        pdinstance->pd_symhashsize * sizeof(*pdinstance->pd_symhash));
+    pdinstance->pd_symhash = newhash;
+    pdinstance->pd_symhashsize = newsize;
+}
+
+    /* normally only the main thread makes symbols, but while abstractions
+    are being read in the background (see s_loader.c) the table is locked. */
+#if PDTHREADS
+static pthread_mutex_t symtab_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int symtab_locking;
+#define SYMTAB_LOCK() if (symtab_locking) pthread_mutex_lock(&symtab_mutex)
+#define SYMTAB_UNLOCK() if (symtab_locking) pthread_mutex_unlock(&symtab_mutex)
+
+    /* turn locking on or off.  Only call this while no other thread can be
+    making symbols. */
+void pd_lockgensym(int onoff)
+{
+    symtab_locking = onoff;
+}
+#else
+#define SYMTAB_LOCK()
+#define SYMTAB_UNLOCK()
+void pd_lockgensym(int onoff) {}
+#endif
+
+static t_symbol *symtab_dofind(const char *s, unsigned int length,
+    unsigned int hash, t_symbol *oldsym, t_pdinstance *pdinstance)
+{
+    t_symbolname *symname;
+    t_symbol **symhashloc, *sym2;
+    symhashloc = pdinstance->pd_symhash +
+        (hash & (pdinstance->pd_symhashsize-1));
     while ((sym2 = *symhashloc))
     {
-        if (!strcmp(sym2->s_name, s))
-            return(sym2);
+        if (symbol_hash(sym2) == hash && symbol_length(sym2) == length &&
+            !memcmp(sym2->s_name, s, length))
+                return(sym2);
         symhashloc = &sym2->s_next;
     }
     if (oldsym)
         sym2 = oldsym;
     else sym2 = (t_symbol *)t_getbytes(sizeof(*sym2));
-    symname = t_getbytes(length+1);
+    symname = (t_symbolname *)t_getbytes(sizeof(*symname) + length + 1);
+    symname->sn_hash = hash;
+    symname->sn_length = length;
+    memcpy(symname + 1, s, length);
+    ((char *)(symname + 1))[length] = 0;
     sym2->s_next = 0;
     sym2->s_thing = 0;
-    strcpy(symname, s);
-    sym2->s_name = symname;
+    sym2->s_name = (char *)(symname + 1);
     *symhashloc = sym2;
+    if (++pdinstance->pd_nsymbols > pdinstance->pd_symhashsize)
+        symtab_resize(pdinstance, 2 * pdinstance->pd_symhashsize);
     return (sym2);
 }
 
+static t_symbol *symtab_find(const char *s, unsigned int length,
+    unsigned int hash, t_symbol *oldsym, t_pdinstance *pdinstance)
+{
+    t_symbol *sym;
+    SYMTAB_LOCK();
+    sym = symtab_dofind(s, length, hash, oldsym, pdinstance);
+    SYMTAB_UNLOCK();
+    return (sym);
+}
+
+static t_symbol *dogensym(const char *s, t_symbol *oldsym,
+    t_pdinstance *pdinstance)
+{
+    unsigned int hash = SYMHASHINIT;
+    const char *s2 = s;
+    while (*s2)
+    {
+        hash = SYMHASHSTEP(hash, *s2);
+        s2++;
+    }
+    return (symtab_find(s, (unsigned int)(s2 - s), hash, oldsym, pdinstance));
+}
+
 t_symbol *gensym(const char *s)
 {
     return(dogensym(s, 0, pd_this));
 }
 
+    /* make a symbol from the first n characters of s, which needn't be
+    null-terminated (but mustn't contain a null within the n characters) */
+t_symbol *gensymn(const char *s, int n)
+{
+    unsigned int hash = SYMHASHINIT;
+    int i;
+    for (i = 0; i < n; i++)
+        hash = SYMHASHSTEP(hash, s[i]);
+    return (symtab_find(s, n, hash, 0, pd_this));
+}
+
+    /* make n symbols at once, growing the table only once */
+void gensymv(int n, const char **names, t_symbol **syms)
+{
+    int i, size;
+    SYMTAB_LOCK();
+    size = pd_this->pd_symhashsize;
+    while (size < pd_this->pd_nsymbols + n)
+        size *= 2;
+    if (size > pd_this->pd_symhashsize)
+        symtab_resize(pd_this, size);
+    SYMTAB_UNLOCK();
+    for (i = 0; i < n; i++)
+        syms[i] = dogensym(names[i], 0, pd_this);
+}
+
 static t_symbol *addfileextent(t_symbol *s)
 {
     char namebuf[MAXPDSTRING];
@@ -954,11 +1172,9 @@ typedef t_pd *(*t_fun6)(t_int i1, t_int i2, t_int i3, t_int i4, t_int i5, t_int
 
 void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
 {
-    t_method *f;
     t_class *c = *x;
-    t_methodentry *m, *mlist;
+    t_methodentry *m;
     unsigned char *wp, wanttype;
-    int i;
     t_int ai[MAXPDARG+1], *ap = ai;
     t_floatarg ad[MAXPDARG+1], *dp = ad;
     int narg = 0;
@@ -1001,13 +1217,7 @@ void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
         else goto badarg;
         return;
     }
-#ifdef PDINSTANCE
-    mlist = c->c_methods[pd_this->pd_instanceno];
-#else
-    mlist = c->c_methods;
-#endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s)
+    if ((m = class_findmethod(c, s)))
     {
         wp = m->me_arg;
         if (*wp == A_GIMME)
@@ -1017,6 +1227,35 @@ void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
                     (*((t_newgimme)(m->me_fun)))(s, argc, argv);
             else (*((t_messgimme)(m->me_fun)))(x, s, argc, argv);
             return;
+        }
+            /* shortcuts for the most common argument lists - none, one
+            float, or one symbol - skipping the general unpacking below.
+            They call the method exactly as the general case would. */
+        if (x != &pd_objectmaker && (!wp[0] || !wp[1]))
+        {
+            switch (wp[0])
+            {
+            case A_NULL:
+                (*(t_fun1)(m->me_fun))((t_int)x, 0, 0, 0, 0, 0);
+                return;
+            case A_FLOAT: case A_DEFFLOAT:
+                if (argc && argv->a_type == A_FLOAT)
+                    (*(t_fun1)(m->me_fun))((t_int)x,
+                        argv->a_w.w_float, 0, 0, 0, 0);
+                else if (!argc && wp[0] == A_DEFFLOAT)
+                    (*(t_fun1)(m->me_fun))((t_int)x, 0, 0, 0, 0, 0);
+                else goto badarg;
+                return;
+            case A_SYMBOL: case A_DEFSYM:
+                if (argc && argv->a_type == A_SYMBOL)
+                    (*(t_fun2)(m->me_fun))((t_int)x,
+                        (t_int)(argv->a_w.w_symbol), 0, 0, 0, 0, 0);
+                else if (!argc && wp[0] == A_DEFSYM)
+                    (*(t_fun2)(m->me_fun))((t_int)x,
+                        (t_int)(&s_), 0, 0, 0, 0, 0);
+                else goto badarg;
+                return;
+            }
         }
         if (argc > MAXPDARG) argc = MAXPDARG;
         if (x != &pd_objectmaker) *(ap++) = (t_int)x, narg++;
@@ -1169,16 +1408,9 @@ void nullfn(void) {}
 t_gotfn getfn(const t_pd *x, t_symbol *s)
 {
     const t_class *c = *x;
-    t_methodentry *m, *mlist;
-    int i;
+    t_methodentry *m = class_findmethod(c, s);
 
-#ifdef PDINSTANCE
-    mlist = c->c_methods[pd_this->pd_instanceno];
-#else
-    mlist = c->c_methods;
-#endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s) return(m->me_fun);
+    if (m) return(m->me_fun);
     pd_error(x, "%s: no method for message '%s'", c->c_name->s_name, s->s_name);
     return((t_gotfn)nullfn);
 }
@@ -1186,16 +1418,9 @@ t_gotfn getfn(const t_pd *x, t_symbol *s)
 t_gotfn zgetfn(const t_pd *x, t_symbol *s)
 {
     const t_class *c = *x;
-    t_methodentry *m, *mlist;
-    int i;
+    t_methodentry *m = class_findmethod(c, s);
 
-#ifdef PDINSTANCE
-    mlist = c->c_methods[pd_this->pd_instanceno];
-#else
-    mlist = c->c_methods;
-#endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s) return(m->me_fun);
+    if (m) return(m->me_fun);
     return(0);
 }
 
@@ -4,6 +4,7 @@
 
 #include "m_pd.h"
 #include "m_imp.h"
+#include "s_stuff.h"
 
 t_class *glob_pdobject;
 static t_class *maxclass;
@@ -41,6 +42,11 @@ void glob_forgetpreferences(t_pd *dummy);
 void glob_open(t_pd *ignore, t_symbol *name, t_symbol *dir, t_floatarg f);
 void glob_fastforward(t_pd *ignore, t_floatarg f);
 void glob_settracing(void *dummy, t_float f);
+void glob_abscache(void *dummy, t_symbol *s);
+void glob_memstats(void *dummy);
+void glob_guirate(void *dummy, t_float f);
+void glob_guistats(void *dummy);
+void glob_schedstats(void *dummy);
 
 static void glob_helpintro(t_pd *dummy)
 {
@@ -54,6 +60,31 @@ static void glob_compatibility(t_pd *dummy, t_floatarg level)
     canvas_resume_dsp(dspwas);
 }
 
+    /* turn approximate math in signal objects on or off.  The perform
+    routines are chosen in the "dsp" methods, so restart DSP. */
+static void glob_fastmath(t_pd *dummy, t_floatarg f)
+{
+    int dspwas = canvas_suspend_dsp();
+    sys_fastmath = (f != 0);
+    canvas_resume_dsp(dspwas);
+}
+
+    /* report memory allocation in perform routines (m_memory.c).  DSP is
+    restarted so that the chain knows which object each routine is for. */
+static void glob_rtaudit(t_pd *dummy, t_floatarg f)
+{
+    int dspwas = canvas_suspend_dsp();
+    sys_rtaudit = (f != 0);
+    canvas_resume_dsp(dspwas);
+}
+
+    /* set the size of the pool for getrtbytes(), in kilobytes */
+static void glob_rtpool(t_pd *dummy, t_floatarg f)
+{
+    sys_rtpoolsize = (f > 0 ? f : 0);
+    rtpool_setup();
+}
+
 #ifdef _WIN32
 void glob_audio(void *dummy, t_floatarg adc, t_floatarg dac);
 #endif
@@ -179,6 +210,22 @@ void glob_init(void)
         gensym("perf"), A_FLOAT, 0);
     class_addmethod(glob_pdobject, (t_method)glob_compatibility,
         gensym("compatibility"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_fastmath,
+        gensym("fastmath"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_abscache,
+        gensym("abscache"), A_DEFSYM, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_memstats,
+        gensym("memstats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_rtaudit,
+        gensym("rtaudit"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_rtpool,
+        gensym("rtpool"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_guirate,
+        gensym("guirate"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_guistats,
+        gensym("guistats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_schedstats,
+        gensym("schedstats"), 0);
     class_addmethod(glob_pdobject, (t_method)glob_plugindispatch,
         gensym("plugin-dispatch"), A_GIMME, 0);
     class_addmethod(glob_pdobject, (t_method)glob_helpintro,
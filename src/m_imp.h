@@ -58,6 +58,12 @@ struct _class
     char c_firstin;                 /* if patchable, true if draw first inlet */
     char c_drawcommand;             /* a drawing command for a template */
     t_classfreefn c_classfreefn;    /* function to call before freeing class */
+#ifdef PDINSTANCE
+    int **c_methodhash;             /* per-instance hash tables for c_methods */
+#else
+    int *c_methodhash;              /* hash table indexing c_methods */
+#endif
+    int c_methodhashsize;           /* size of hash table or 0 if none */
 };
 
 /* m_pd.c */
@@ -66,6 +72,12 @@ EXTERN void pd_term_systems(void);
 
 /* m_class.c */
 EXTERN void pd_emptylist(t_pd *x);
+EXTERN void pd_lockgensym(int onoff);
+
+/* m_binbuf.c */
+EXTERN t_binbuf *binbuf_readpatch(t_symbol *name, t_symbol *dir);
+EXTERN void binbuf_evalpatch(const t_binbuf *b, t_symbol *name,
+    t_symbol *dir);
 
 /* m_obj.c */
 EXTERN int obj_noutlets(const t_object *x);
@@ -93,9 +105,19 @@ void pd_globalunlock(void);
 
 /* misc */
 #ifndef SYMTABHASHSIZE  /* set this to, say, 1024 for small memory footprint */
-#define SYMTABHASHSIZE 16384
+#define SYMTABHASHSIZE 16384    /* initial size; the table grows as needed */
 #endif /* SYMTABHASHSIZE */
 
+    /* the hash value and length of a symbol's name are stored just before
+    the name itself.  This is only true of symbols made by gensym(). */
+typedef struct _symbolname
+{
+    unsigned int sn_hash;
+    unsigned int sn_length;
+} t_symbolname;
+#define symbol_hash(s) (((const t_symbolname *)((s)->s_name))[-1].sn_hash)
+#define symbol_length(s) (((const t_symbolname *)((s)->s_name))[-1].sn_length)
+
 EXTERN t_pd *glob_evalfile(t_pd *ignore, t_symbol *name, t_symbol *dir);
 EXTERN void glob_initfromgui(void *dummy, t_symbol *s, int argc, t_atom *argv);
 EXTERN void glob_quit(void *dummy); /* glob_exit(0); */
@@ -2,11 +2,28 @@
 * For information on usage and redistribution, and for a DISCLAIMER OF ALL
 * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
 
+#if defined(HAVE_LIBDL) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     /* for dladdr() */
+#endif
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include "m_pd.h"
-#if (defined LOUD) || (defined DEBUGMEM)
-# include <stdio.h>
+#include "m_imp.h"
+#include "s_stuff.h"
+#if defined(HAVE_LIBDL) || defined(__FreeBSD__)
+#include <dlfcn.h>
+#define HAVE_DLADDR
+#endif
+#if PDTHREADS
+#include <pthread.h>
+#ifdef _MSC_VER
+#define MEM_THREAD __declspec(thread)
+#else
+#define MEM_THREAD __thread
+#endif
+#else
+#define MEM_THREAD
 #endif
 
 /* #define DEBUGMEM */
@@ -14,11 +31,366 @@
 static int totalmem = 0;
 #endif
 
-void *getbytes(size_t nbytes)
+/* Small allocations, which are most of them (objects, inlets, outlets,
+connections, clocks, symbols...) come from "slabs": 64K chunks of memory
+each divided into blocks of one size, in multiples of 16 bytes up to 256.
+Freed blocks go onto a free list for their size, from which they're reused.
+So that different threads (audio callbacks, libpd instances, or the threads
+that read abstractions ahead) don't have to lock each other out, each
+thread keeps its own free lists, trading blocks with a common pool in
+batches.  Blocks from any thread can be freed by any other.
+
+freebytes() doesn't trust the size it's given (callers get it wrong now and
+then) but finds out whether the memory is from a slab by looking up its
+chunk in a table.  Chunks are never given back to the system.  Compile with
+PDSLABS defined to 0 to use malloc() for everything, for instance to find
+memory errors with valgrind. */
+
+#ifndef PDSLABS
+#define PDSLABS 1
+#endif
+
+#if PDSLABS
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+    /* the chunk table is read without locking */
+#ifdef __GNUC__
+#define SLAB_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define SLAB_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#else
+#define SLAB_LOAD(x) (*(char * volatile *)&(x))
+#define SLAB_STORE(x, v) (*(char * volatile *)&(x) = (v))
+#endif
+
+#define SLABQUANTUM 16
+#define SLABMAXSIZE 256
+#define SLABNCLASS (SLABMAXSIZE / SLABQUANTUM)
+#define SLABCHUNKSIZE 65536
+#define SLABHEADSIZE 64         /* header at the start of each chunk */
+#define SLABMAXCHUNKS 65536     /* size of chunk table (for up to 4 GB) */
+#define SLABBATCH 32            /* blocks moved between a thread and the pool */
+
+typedef struct _slabblock
+{
+    struct _slabblock *b_next;
+} t_slabblock;
+
+typedef struct _slabchunk
+{
+    int c_class;                /* which size of blocks */
+} t_slabchunk;
+
+typedef struct _slabclass       /* global state for one size */
+{
+    t_slabblock *s_free;        /* pool of free blocks */
+    int s_nfree;
+    char *s_carve;              /* unused part of newest chunk */
+    char *s_carveend;
+    int s_nchunks;
+    size_t s_ncarved;           /* blocks ever taken from chunks */
+} t_slabclass;
+
+typedef struct _slabcache       /* each thread's own free lists */
+{
+    t_slabblock *t_free[SLABNCLASS];
+    int t_nfree[SLABNCLASS];
+    int t_registered;           /* thread-exit function set up */
+    size_t t_nalloc;            /* statistics for "pd memstats" */
+    size_t t_nslaballoc;
+    size_t t_nfreed;
+    size_t t_nslabfreed;
+} t_slabcache;
+
+static t_slabclass slab_class[SLABNCLASS];
+static char *slab_chunks[SLABMAXCHUNKS];
+static int slab_nchunks;
+static MEM_THREAD t_slabcache slab_cache;
+
+#if PDTHREADS
+static pthread_mutex_t slab_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t slab_key;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+#define SLAB_LOCK() pthread_mutex_lock(&slab_mutex)
+#define SLAB_UNLOCK() pthread_mutex_unlock(&slab_mutex)
+#else
+#define SLAB_LOCK()
+#define SLAB_UNLOCK()
+#endif
+
+#define SLABHASH(base) \
+    ((unsigned int)(((size_t)(base) / SLABCHUNKSIZE) * 2654435761u) % \
+        SLABMAXCHUNKS)
+
+    /* find the chunk a pointer is in, or 0 if it didn't come from a slab */
+static t_slabchunk *slab_findchunk(void *p)
+{
+    char *base = (char *)((size_t)p & ~(size_t)(SLABCHUNKSIZE-1)), *c;
+    unsigned int h;
+    for (h = SLABHASH(base); (c = SLAB_LOAD(slab_chunks[h]));
+        h = (h + 1) % SLABMAXCHUNKS)
+            if (c == base)
+                return ((t_slabchunk *)base);
+    return (0);
+}
+
+    /* get a new chunk for a class.  Called with the lock held. */
+static int slab_newchunk(t_slabclass *sc, int class)
+{
+    char *base;
+    unsigned int h;
+        /* leave the table at most half full */
+    if (slab_nchunks >= SLABMAXCHUNKS/2)
+        return (0);
+#ifdef _WIN32
+    if (!(base = (char *)_aligned_malloc(SLABCHUNKSIZE, SLABCHUNKSIZE)))
+        return (0);
+#else
+    if (posix_memalign((void **)&base, SLABCHUNKSIZE, SLABCHUNKSIZE))
+        return (0);
+#endif
+    ((t_slabchunk *)base)->c_class = class;
+    for (h = SLABHASH(base); slab_chunks[h]; h = (h + 1) % SLABMAXCHUNKS)
+        ;
+    SLAB_STORE(slab_chunks[h], base);
+    slab_nchunks++;
+    sc->s_nchunks++;
+    sc->s_carve = base + SLABHEADSIZE;
+    sc->s_carveend = base + SLABCHUNKSIZE;
+    return (1);
+}
+
+    /* give a thread's free blocks back to the pool when it exits */
+static void slab_threadexit(void *z)
+{
+    t_slabcache *tc = (t_slabcache *)z;
+    int i;
+    SLAB_LOCK();
+    for (i = 0; i < SLABNCLASS; i++)
+    {
+        t_slabblock *b;
+        while ((b = tc->t_free[i]))
+        {
+            tc->t_free[i] = b->b_next;
+            b->b_next = slab_class[i].s_free;
+            slab_class[i].s_free = b;
+            slab_class[i].s_nfree++;
+        }
+        tc->t_nfree[i] = 0;
+    }
+    SLAB_UNLOCK();
+}
+
+#if PDTHREADS
+static void slab_makekey(void)
+{
+    pthread_key_create(&slab_key, slab_threadexit);
+}
+#endif
+
+    /* refill this thread's free list for a class, from the pool if
+    possible or else from a chunk.  Returns 0 if out of memory. */
+static int slab_refill(int class)
+{
+    t_slabclass *sc = &slab_class[class];
+    t_slabcache *tc = &slab_cache;
+    long size = (class + 1) * SLABQUANTUM;
+    int n = 0;
+#if PDTHREADS
+    if (!tc->t_registered)
+    {
+        pthread_once(&slab_once, slab_makekey);
+        pthread_setspecific(slab_key, tc);
+        tc->t_registered = 1;
+    }
+#endif
+    SLAB_LOCK();
+    while (n < SLABBATCH && sc->s_free)
+    {
+        t_slabblock *b = sc->s_free;
+        sc->s_free = b->b_next;
+        b->b_next = tc->t_free[class];
+        tc->t_free[class] = b;
+        sc->s_nfree--;
+        n++;
+    }
+    if (!n && (sc->s_carveend - sc->s_carve >= size ||
+        slab_newchunk(sc, class)))
+    {
+        while (n < SLABBATCH && sc->s_carveend - sc->s_carve >= size)
+        {
+            t_slabblock *b = (t_slabblock *)sc->s_carve;
+            sc->s_carve += size;
+            b->b_next = tc->t_free[class];
+            tc->t_free[class] = b;
+            n++;
+        }
+        sc->s_ncarved += n;
+    }
+    SLAB_UNLOCK();
+    tc->t_nfree[class] += n;
+    return (n);
+}
+
+static void *slab_alloc(size_t nbytes)
+{
+    int class = (int)((nbytes - 1) / SLABQUANTUM);
+    t_slabcache *tc = &slab_cache;
+    t_slabblock *b;
+    if (!tc->t_free[class] && !slab_refill(class))
+        return (0);
+    b = tc->t_free[class];
+    tc->t_free[class] = b->b_next;
+    tc->t_nfree[class]--;
+    tc->t_nslaballoc++;
+    memset(b, 0, nbytes);
+    return (b);
+}
+
+static void slab_free(void *p, t_slabchunk *c)
+{
+    int class = c->c_class;
+    t_slabcache *tc = &slab_cache;
+    t_slabblock *b = (t_slabblock *)p;
+    b->b_next = tc->t_free[class];
+    tc->t_free[class] = b;
+        /* don't let one thread hoard blocks another might need */
+    if (++tc->t_nfree[class] > 2 * SLABBATCH)
+    {
+        t_slabclass *sc = &slab_class[class];
+        int i;
+        SLAB_LOCK();
+        for (i = 0; i < SLABBATCH; i++)
+        {
+            b = tc->t_free[class];
+            tc->t_free[class] = b->b_next;
+            b->b_next = sc->s_free;
+            sc->s_free = b;
+        }
+        sc->s_nfree += SLABBATCH;
+        SLAB_UNLOCK();
+        tc->t_nfree[class] -= SLABBATCH;
+    }
+}
+
+#endif /* PDSLABS */
+
+/* ------------- real-time allocation audit and RT pool ------------- */
+
+/* With "-rtaudit" (or "pd rtaudit 1") getbytes(), resizebytes() and
+freebytes() complain if they're called from a perform routine, since they
+may take locks or call the operating system and so miss the audio deadline
+under load.  dsp_tick() tells us which class each perform routine belongs
+to (see d_ugen.c).  Each class and call site is reported once.
+
+Perform routines that really need memory can use getrtbytes() and
+freertbytes(), which take it from a pool allocated ahead of time ("-rtpool"
+or "pd rtpool", in kilobytes).  The pool is a buddy allocator, so neither
+call ever blocks or takes more than a few steps.  Each Pd instance has its
+own pool, which like the rest of the instance is only touched with the Pd
+lock held.  If there's no pool or it's full, getbytes() is used instead
+(and reported when auditing). */
+
+static MEM_THREAD int rtaudit_indsp;        /* in dsp_tick() and auditing */
+static MEM_THREAD t_class *rtaudit_class;   /* whose perform routine */
+
+#define RTAUDITMAXREPORT 100
+
+typedef struct _rtreport
+{
+    t_class *r_class;
+    void *r_caller;
+} t_rtreport;
+
+static t_rtreport rtaudit_reported[RTAUDITMAXREPORT];
+static int rtaudit_nreported;
+static long rtaudit_count;
+#if PDTHREADS
+static pthread_mutex_t rtaudit_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#ifdef __GNUC__
+#define RTAUDIT_CALLER __builtin_return_address(0)
+#else
+#define RTAUDIT_CALLER 0
+#endif
+
+#define RTAUDIT(fn, n) \
+    if (rtaudit_indsp) rtaudit_report((fn), (n), RTAUDIT_CALLER)
+
+static void rtaudit_report(const char *fn, size_t nbytes, void *caller)
+{
+    t_class *c = rtaudit_class;
+    char where[MAXPDSTRING];
+    int i, new = 1, last = 0;
+#ifdef HAVE_DLADDR
+    Dl_info info;
+#endif
+#if PDTHREADS
+    pthread_mutex_lock(&rtaudit_mutex);
+#endif
+    rtaudit_count++;
+    for (i = 0; i < rtaudit_nreported; i++)
+        if (rtaudit_reported[i].r_class == c &&
+            rtaudit_reported[i].r_caller == caller)
+                new = 0;
+    if (new && rtaudit_nreported < RTAUDITMAXREPORT)
+    {
+        rtaudit_reported[rtaudit_nreported].r_class = c;
+        rtaudit_reported[rtaudit_nreported].r_caller = caller;
+        last = (++rtaudit_nreported == RTAUDITMAXREPORT);
+    }
+    else new = 0;
+#if PDTHREADS
+    pthread_mutex_unlock(&rtaudit_mutex);
+#endif
+    if (!new)
+        return;
+#ifdef HAVE_DLADDR
+    if (caller && dladdr(caller, &info) && info.dli_sname)
+        snprintf(where, MAXPDSTRING, "%s+0x%lx in %s", info.dli_sname,
+            (unsigned long)((char *)caller - (char *)info.dli_saddr),
+                info.dli_fname);
+    else if (caller && dladdr(caller, &info) && info.dli_fname)
+        snprintf(where, MAXPDSTRING, "%p in %s", caller, info.dli_fname);
+    else
+#endif
+    snprintf(where, MAXPDSTRING, "%p", caller);
+        /* posting might allocate memory itself */
+    rtaudit_indsp = 0;
+    post("rt audit: %s(%ld) in DSP tick, [%s] perform routine, called from %s",
+        fn, (long)nbytes, (c ? class_getname(c) : "?"), where);
+    if (last)
+        post("rt audit: (no more reports)");
+    rtaudit_indsp = 1;
+}
+
+    /* called from dsp_tick() before each perform routine */
+void rtaudit_enter(t_class *c)
+{
+    rtaudit_class = c;
+    rtaudit_indsp = 1;
+}
+
+void rtaudit_leave(void)
+{
+    rtaudit_indsp = 0;
+    rtaudit_class = 0;
+}
+
+static void *mem_getbytes(size_t nbytes)
 {
     void *ret;
     if (nbytes < 1) nbytes = 1;
+#if PDSLABS
+    slab_cache.t_nalloc++;
+    if (nbytes > SLABMAXSIZE || !(ret = slab_alloc(nbytes)))
+        ret = (void *)calloc(nbytes, 1);
+#else
     ret = (void *)calloc(nbytes, 1);
+#endif
 #ifdef LOUD
     fprintf(stderr, "new  %lx %d\n", (int)ret, nbytes);
 #endif /* LOUD */
@@ -30,15 +402,23 @@ void *getbytes(size_t nbytes)
     return (ret);
 }
 
+void *getbytes(size_t nbytes)
+{
+    RTAUDIT("getbytes", nbytes);
+    return (mem_getbytes(nbytes));
+}
+
 void *getzbytes(size_t nbytes)  /* obsolete name */
 {
-    return (getbytes(nbytes));
+    RTAUDIT("getzbytes", nbytes);
+    return (mem_getbytes(nbytes));
 }
 
 void *copybytes(const void *src, size_t nbytes)
 {
     void *ret;
-    ret = getbytes(nbytes);
+    RTAUDIT("copybytes", nbytes);
+    ret = mem_getbytes(nbytes);
     if (nbytes && ret)
         memcpy(ret, src, nbytes);
     return (ret);
@@ -47,9 +427,31 @@ void *copybytes(const void *src, size_t nbytes)
 void *resizebytes(void *old, size_t oldsize, size_t newsize)
 {
     void *ret;
+#if PDSLABS
+    t_slabchunk *c;
+#endif
+    RTAUDIT("resizebytes", newsize);
     if (newsize < 1) newsize = 1;
     if (oldsize < 1) oldsize = 1;
+#if PDSLABS
+    if (old && (c = slab_findchunk(old)))
+    {
+        size_t blocksize = (c->c_class + 1) * SLABQUANTUM;
+            /* if it still fits in the same size block, keep it */
+        if (newsize <= blocksize && newsize > blocksize - SLABQUANTUM)
+            ret = old;
+        else if ((ret = mem_getbytes(newsize)))
+        {
+            memcpy(ret, old, (oldsize < newsize ? oldsize : newsize));
+            slab_free(old, c);
+        }
+    }
+    else if (!old && newsize <= SLABMAXSIZE)
+        ret = mem_getbytes(newsize);
+    else ret = (void *)realloc((char *)old, newsize);
+#else
     ret = (void *)realloc((char *)old, newsize);
+#endif
     if (newsize > oldsize && ret)
         memset(((char *)ret) + oldsize, 0, newsize - oldsize);
 #ifdef LOUD
@@ -63,8 +465,11 @@ void *resizebytes(void *old, size_t oldsize, size_t newsize)
     return (ret);
 }
 
-void freebytes(void *fatso, size_t nbytes)
+static void mem_freebytes(void *fatso, size_t nbytes)
 {
+#if PDSLABS
+    t_slabchunk *c;
+#endif
     if (nbytes == 0)
         nbytes = 1;
 #ifdef LOUD
@@ -73,7 +478,245 @@ void freebytes(void *fatso, size_t nbytes)
 #ifdef DEBUGMEM
     totalmem -= nbytes;
 #endif
+#if PDSLABS
+    slab_cache.t_nfreed++;
+    if (fatso && (c = slab_findchunk(fatso)))
+    {
+        slab_free(fatso, c);
+        slab_cache.t_nslabfreed++;
+    }
+    else free(fatso);
+#else
     free(fatso);
+#endif
+}
+
+void freebytes(void *fatso, size_t nbytes)
+{
+    RTAUDIT("freebytes", nbytes);
+    mem_freebytes(fatso, nbytes);
+}
+
+    /* the RT pool.  Blocks are RTPOOLUNIT times a power of two ("order")
+    and each is split from, and merged back into, its "buddy" of the same
+    size.  A tag for each unit marks the start of each used or free block
+    and its order. */
+#define RTPOOLUNIT 16
+#define RTPOOLMAXORDER 26       /* up to 1 GB */
+#define RTPOOLFREE 0x40
+#define RTPOOLUSED 0x80
+#define RTPOOLORDER 0x3f
+
+typedef struct _rtfree
+{
+    struct _rtfree *f_next;
+    struct _rtfree *f_prev;
+} t_rtfree;
+
+typedef struct _rtpool
+{
+    char *p_mem;
+    size_t p_size;
+    int p_maxorder;
+    unsigned char *p_tag;           /* one per unit */
+    t_rtfree *p_free[RTPOOLMAXORDER + 1];
+    size_t p_inuse;                 /* bytes, for "pd memstats" */
+    size_t p_peak;
+    long p_nfail;                   /* requests we couldn't meet */
+} t_rtpool;
+
+static void rtpool_link(t_rtpool *x, size_t idx, int order)
+{
+    t_rtfree *f = (t_rtfree *)(x->p_mem + idx * RTPOOLUNIT);
+    f->f_prev = 0;
+    if ((f->f_next = x->p_free[order]))
+        f->f_next->f_prev = f;
+    x->p_free[order] = f;
+    x->p_tag[idx] = RTPOOLFREE | order;
+}
+
+static void rtpool_unlink(t_rtpool *x, size_t idx, int order)
+{
+    t_rtfree *f = (t_rtfree *)(x->p_mem + idx * RTPOOLUNIT);
+    if (f->f_prev)
+        f->f_prev->f_next = f->f_next;
+    else x->p_free[order] = f->f_next;
+    if (f->f_next)
+        f->f_next->f_prev = f->f_prev;
+    x->p_tag[idx] = 0;
+}
+
+static void *rtpool_alloc(t_rtpool *x, size_t nbytes)
+{
+    int order = 0, j;
+    size_t size = RTPOOLUNIT, idx;
+    while (size < nbytes)
+    {
+        if (++order > x->p_maxorder)
+            return (0);
+        size <<= 1;
+    }
+    for (j = order; j <= x->p_maxorder && !x->p_free[j]; j++)
+        ;
+    if (j > x->p_maxorder)
+        return (0);
+    idx = ((char *)x->p_free[j] - x->p_mem) / RTPOOLUNIT;
+    rtpool_unlink(x, idx, j);
+        /* split off the upper halves until it's the right size */
+    while (j > order)
+    {
+        j--;
+        rtpool_link(x, idx + ((size_t)1 << j), j);
+    }
+    x->p_tag[idx] = RTPOOLUSED | order;
+    if ((x->p_inuse += size) > x->p_peak)
+        x->p_peak = x->p_inuse;
+    memset(x->p_mem + idx * RTPOOLUNIT, 0, nbytes);
+    return (x->p_mem + idx * RTPOOLUNIT);
+}
+
+static void rtpool_dofree(t_rtpool *x, void *p)
+{
+    size_t idx = ((char *)p - x->p_mem) / RTPOOLUNIT, buddy;
+    int order;
+    if (!(x->p_tag[idx] & RTPOOLUSED))
+    {
+        bug("freertbytes");
+        return;
+    }
+    order = x->p_tag[idx] & RTPOOLORDER;
+    x->p_tag[idx] = 0;
+    x->p_inuse -= ((size_t)RTPOOLUNIT << order);
+        /* merge with the buddy as long as it's free and whole */
+    while (order < x->p_maxorder)
+    {
+        buddy = idx ^ ((size_t)1 << order);
+        if (x->p_tag[buddy] != (RTPOOLFREE | order))
+            break;
+        rtpool_unlink(x, buddy, order);
+        idx &= ~((size_t)1 << order);
+        order++;
+    }
+    rtpool_link(x, idx, order);
+}
+
+void *getrtbytes(size_t nbytes)
+{
+    t_rtpool *x = STUFF->st_rtpool;
+    void *ret;
+    if (nbytes < 1)
+        nbytes = 1;
+    if (x && (ret = rtpool_alloc(x, nbytes)))
+        return (ret);
+    if (x)
+        x->p_nfail++;
+    RTAUDIT("getrtbytes", nbytes);
+    return (mem_getbytes(nbytes));
+}
+
+void freertbytes(void *p, size_t nbytes)
+{
+    t_rtpool *x = STUFF->st_rtpool;
+    if (x && (char *)p >= x->p_mem && (char *)p < x->p_mem + x->p_size)
+        rtpool_dofree(x, p);
+    else
+    {
+        RTAUDIT("freertbytes", nbytes);
+        mem_freebytes(p, nbytes);
+    }
+}
+
+void rtpool_free(void)
+{
+    t_rtpool *x = STUFF->st_rtpool;
+    if (x)
+    {
+        free(x->p_mem);
+        freebytes(x->p_tag, x->p_size / RTPOOLUNIT);
+        freebytes(x, sizeof(*x));
+        STUFF->st_rtpool = 0;
+    }
+}
+
+    /* make this instance's pool match sys_rtpoolsize.  This is called when
+    DSP starts and from "pd rtpool". */
+void rtpool_setup(void)
+{
+    t_rtpool *x = STUFF->st_rtpool;
+    size_t size = RTPOOLUNIT, want = (size_t)sys_rtpoolsize * 1024;
+    int order = 0;
+    if (sys_rtpoolsize < 0)
+        want = 0;
+    while (order < RTPOOLMAXORDER && (size << 1) <= want)
+        size <<= 1, order++;
+    if (!want)
+        size = 0;
+    if (x && x->p_size == size)
+        return;
+    if (x && x->p_inuse)
+    {
+        pd_error(0, "rtpool: can't resize while in use");
+        return;
+    }
+    rtpool_free();
+    if (!size)
+        return;
+    x = (t_rtpool *)getbytes(sizeof(*x));
+    if (!(x->p_mem = (char *)malloc(size)) ||
+        !(x->p_tag = (unsigned char *)getbytes(size / RTPOOLUNIT)))
+    {
+        free(x->p_mem);
+        freebytes(x, sizeof(*x));
+        pd_error(0, "rtpool: couldn't allocate %ld bytes", (long)size);
+        return;
+    }
+        /* touch every page now so the audio thread doesn't fault them in */
+    memset(x->p_mem, 0, size);
+    x->p_size = size;
+    x->p_maxorder = order;
+    rtpool_link(x, 0, order);
+    STUFF->st_rtpool = x;
+}
+
+    /* "pd memstats": print statistics about allocation.  The counts of calls
+    are for the calling (main) thread only. */
+void glob_memstats(void *dummy)
+{
+#if PDSLABS
+    t_slabcache *tc = &slab_cache;
+    int i;
+    SLAB_LOCK();
+    post("slab allocator: %d chunks (%d KB)", slab_nchunks,
+        slab_nchunks * (SLABCHUNKSIZE / 1024));
+    for (i = 0; i < SLABNCLASS; i++)
+    {
+        t_slabclass *sc = &slab_class[i];
+        if (!sc->s_nchunks)
+            continue;
+            /* blocks in other threads' caches count as used */
+        post("... %3d bytes: %d chunks, %ld blocks in use, %ld free",
+            (i + 1) * SLABQUANTUM, sc->s_nchunks,
+            (long)(sc->s_ncarved - sc->s_nfree - tc->t_nfree[i]),
+            (long)(sc->s_nfree + tc->t_nfree[i]) +
+                (long)((sc->s_carveend - sc->s_carve) /
+                    ((i + 1) * SLABQUANTUM)));
+    }
+    SLAB_UNLOCK();
+    post("... %ld allocations (%ld from slabs), %ld frees (%ld to slabs)",
+        (long)tc->t_nalloc, (long)tc->t_nslaballoc, (long)tc->t_nfreed,
+        (long)tc->t_nslabfreed);
+#else
+    post("slab allocator not compiled in");
+#endif
+    if (STUFF->st_rtpool)
+    {
+        t_rtpool *x = STUFF->st_rtpool;
+        post("rt pool: %ld KB, %ld KB in use, peak %ld KB, %ld misses",
+            (long)(x->p_size / 1024), (long)(x->p_inuse / 1024),
+            (long)(x->p_peak / 1024), x->p_nfail);
+    }
+    if (sys_rtaudit)
+        post("rt audit: %ld allocations in DSP tick", rtaudit_count);
 }
 
 #ifdef DEBUGMEM
@@ -578,14 +578,23 @@ void outlet_pointer(t_outlet *x, t_gpointer *gp)
     --stackcount;
 }
 
+    /* this is the busiest path in most control patches, so we call the
+    float method directly instead of through pd_float(), and just set the
+    value for float inlets (floatinlet_new()), which is most of the
+    connections to inlets other than the first. */
 void outlet_float(t_outlet *x, t_float f)
 {
     t_outconnect *oc;
+    t_pd *to;
     if(++stackcount >= STACKITER)
         outlet_stackerror(x);
     else
     for (oc = x->o_connections; oc; oc = oc->oc_next)
-        pd_float(oc->oc_to, f);
+    {
+        if (*(to = oc->oc_to) == floatinlet_class)
+            *((t_inlet *)to)->i_floatslot = f;
+        else (*(*to)->c_floatmethod)(to, f);
+    }
     --stackcount;
 }
 
@@ -2,8 +2,10 @@
 * For information on usage and redistribution, and for a DISCLAIMER OF ALL
 * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
 
+#include <string.h>
 #include "m_pd.h"
 #include "m_imp.h"
+#include "s_stuff.h"
 #include "g_canvas.h"   /* just for LB_LOAD */
 
     /* FIXME no out-of-memory testing yet! */
@@ -54,60 +56,86 @@ to the symbol. */
 
 static t_class *bindlist_class;
 
-typedef struct _bindelem
-{
-    t_pd *e_who;
-    struct _bindelem *e_next;
-} t_bindelem;
+    /* the receivers are kept in an array in the order they were bound, and
+    messages go to the most recently bound one first.  A receiver can be
+    unbound (and even freed) while a message is being sent to the list, so
+    while sending we only null out its entry and squeeze the array later.
+    Receivers bound while sending are added at the end, and don't get the
+    message being sent, just as before. */
 
 typedef struct _bindlist
 {
     t_pd b_pd;
-    t_bindelem *b_list;
+    t_pd **b_vec;           /* receivers */
+    int b_n;                /* number of entries, including nulls */
+    int b_size;             /* allocated size of b_vec */
+    int b_nlive;            /* number of non-null entries */
+    int b_sending;          /* depth of messages being sent to us */
+    t_symbol *b_sym;        /* symbol we're bound to */
 } t_bindlist;
 
+    /* after sending, remove nulls and, if we're down to one receiver or
+    none, bind it to the symbol directly and free ourselves */
+static void bindlist_tidy(t_bindlist *x)
+{
+    if (x->b_nlive < x->b_n)
+    {
+        int i, j;
+        for (i = j = 0; i < x->b_n; i++)
+            if (x->b_vec[i])
+                x->b_vec[j++] = x->b_vec[i];
+        x->b_n = j;
+    }
+    if (x->b_nlive < 2)
+    {
+        x->b_sym->s_thing = (x->b_nlive ? x->b_vec[0] : 0);
+        freebytes(x->b_vec, x->b_size * sizeof(*x->b_vec));
+        x->b_vec = 0;
+        pd_free(&x->b_pd);
+    }
+}
+
+#define BINDLIST_SEND(x, who, send) {                   \
+    int i;                                              \
+    t_pd *who;                                          \
+    x->b_sending++;                                     \
+    for (i = x->b_n; i--; )                             \
+        if ((who = x->b_vec[i]))                        \
+            send;                                       \
+    if (!--x->b_sending && x->b_nlive < x->b_n)         \
+        bindlist_tidy(x);                               \
+}
+
 static void bindlist_bang(t_bindlist *x)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_bang(e->e_who);
+    BINDLIST_SEND(x, who, pd_bang(who));
 }
 
 static void bindlist_float(t_bindlist *x, t_float f)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_float(e->e_who, f);
+    BINDLIST_SEND(x, who, pd_float(who, f));
 }
 
 static void bindlist_symbol(t_bindlist *x, t_symbol *s)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_symbol(e->e_who, s);
+    BINDLIST_SEND(x, who, pd_symbol(who, s));
 }
 
 static void bindlist_pointer(t_bindlist *x, t_gpointer *gp)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_pointer(e->e_who, gp);
+    BINDLIST_SEND(x, who, pd_pointer(who, gp));
 }
 
 static void bindlist_list(t_bindlist *x, t_symbol *s,
     int argc, t_atom *argv)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_list(e->e_who, s, argc, argv);
+    BINDLIST_SEND(x, who, pd_list(who, s, argc, argv));
 }
 
 static void bindlist_anything(t_bindlist *x, t_symbol *s,
     int argc, t_atom *argv)
 {
-    t_bindelem *e;
-    for (e = x->b_list; e; e = e->e_next)
-        pd_typedmess(e->e_who, s, argc, argv);
+    BINDLIST_SEND(x, who, pd_typedmess(who, s, argc, argv));
 }
 
 void m_pd_setup(void)
@@ -122,28 +150,36 @@ void m_pd_setup(void)
     class_addanything(bindlist_class, bindlist_anything);
 }
 
+static void bindlist_add(t_bindlist *b, t_pd *x)
+{
+    if (b->b_n == b->b_size)
+    {
+        b->b_vec = (t_pd **)resizebytes(b->b_vec,
+            b->b_size * sizeof(*b->b_vec), 2 * b->b_size * sizeof(*b->b_vec));
+        b->b_size *= 2;
+    }
+    b->b_vec[b->b_n++] = x;
+    b->b_nlive++;
+}
+
 void pd_bind(t_pd *x, t_symbol *s)
 {
+        /* tell OSC dispatch (x_net.c) about new names that look like
+        OSC addresses */
+    if (!s->s_thing && *s->s_name == '/')
+        STUFF->st_oscbindgen++;
     if (s->s_thing)
     {
         if (*s->s_thing == bindlist_class)
-        {
-            t_bindlist *b = (t_bindlist *)s->s_thing;
-            t_bindelem *e = (t_bindelem *)getbytes(sizeof(t_bindelem));
-            e->e_next = b->b_list;
-            e->e_who = x;
-            b->b_list = e;
-        }
+            bindlist_add((t_bindlist *)s->s_thing, x);
         else
         {
             t_bindlist *b = (t_bindlist *)pd_new(bindlist_class);
-            t_bindelem *e1 = (t_bindelem *)getbytes(sizeof(t_bindelem));
-            t_bindelem *e2 = (t_bindelem *)getbytes(sizeof(t_bindelem));
-            b->b_list = e1;
-            e1->e_who = x;
-            e1->e_next = e2;
-            e2->e_who = s->s_thing;
-            e2->e_next = 0;
+            b->b_size = 4;
+            b->b_vec = (t_pd **)getbytes(b->b_size * sizeof(*b->b_vec));
+            b->b_sym = s;
+            bindlist_add(b, s->s_thing);
+            bindlist_add(b, x);
             s->s_thing = &b->b_pd;
         }
     }
@@ -157,33 +193,29 @@ void pd_unbind(t_pd *x, t_symbol *s)
     {
             /* bindlists always have at least two elements... if the number
             goes down to one, get rid of the bindlist and bind the symbol
-            straight to the remaining element. */
+            straight to the remaining element.  If we're in the middle of
+            sending, that waits until we're done. */
 
         t_bindlist *b = (t_bindlist *)s->s_thing;
-        t_bindelem *e, *e2;
-        if ((e = b->b_list)->e_who == x)
-        {
-            b->b_list = e->e_next;
-            e->e_who = 0; e->e_next = 0;
-            freebytes(e, sizeof(t_bindelem));
-        }
-        else for (e = b->b_list; (e2 = e->e_next); e = e2)
-            if (e2->e_who == x)
+        int i;
+        for (i = b->b_n; i--; )
+            if (b->b_vec[i] == x)
         {
-            e->e_next = e2->e_next;
-            e2->e_who = 0; e2->e_next = 0;
-            freebytes(e2, sizeof(t_bindelem));
+            if (b->b_sending)
+                b->b_vec[i] = 0;
+            else
+            {
+                memmove(b->b_vec + i, b->b_vec + i + 1,
+                    (b->b_n - i - 1) * sizeof(*b->b_vec));
+                b->b_n--;
+            }
+            b->b_nlive--;
             break;
         }
-        if (!b->b_list->e_next)
-        {
-
-            s->s_thing = b->b_list->e_who;
-            freebytes(b->b_list, sizeof(t_bindelem));
-            b->b_list = 0;
-            pd_free(&b->b_pd);
-            b = 0;
-        }
+        if (i < 0)
+            pd_error(x, "%s: couldn't unbind", s->s_name);
+        else if (b->b_nlive < 2 && !b->b_sending)
+            bindlist_tidy(b);
     }
     else pd_error(x, "%s: couldn't unbind", s->s_name);
 }
@@ -197,17 +229,16 @@ t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
     if (*s->s_thing == bindlist_class)
     {
         t_bindlist *b = (t_bindlist *)s->s_thing;
-        t_bindelem *e, *e2;
-        int warned = 0;
-        for (e = b->b_list; e; e = e->e_next)
-            if (*e->e_who == c)
+        int i, warned = 0;
+        for (i = b->b_n; i--; )
+            if (b->b_vec[i] && *b->b_vec[i] == c)
         {
             if (x && !warned)
             {
                 post("warning: %s: multiply defined", s->s_name);
                 warned = 1;
             }
-            x = e->e_who;
+            x = b->b_vec[i];
         }
     }
     return x;
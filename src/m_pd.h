@@ -280,6 +280,8 @@ EXTERN t_pd pd_canvasmaker;     /* factory for creating canvases */
 EXTERN void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv);
 EXTERN void pd_forwardmess(t_pd *x, int argc, t_atom *argv);
 EXTERN t_symbol *gensym(const char *s);
+EXTERN t_symbol *gensymn(const char *s, int n);
+EXTERN void gensymv(int n, const char **names, t_symbol **syms);
 EXTERN t_gotfn getfn(const t_pd *x, t_symbol *s);
 EXTERN t_gotfn zgetfn(const t_pd *x, t_symbol *s);
 EXTERN void nullfn(void);
@@ -314,6 +316,9 @@ EXTERN void *getzbytes(size_t nbytes);
 EXTERN void *copybytes(const void *src, size_t nbytes);
 EXTERN void freebytes(void *x, size_t nbytes);
 EXTERN void *resizebytes(void *x, size_t oldsize, size_t newsize);
+    /* safe to call from perform routines; see "-rtpool" */
+EXTERN void *getrtbytes(size_t nbytes);
+EXTERN void freertbytes(void *x, size_t nbytes);
 
 /* -------------------- atoms ----------------------------- */
 
@@ -347,6 +352,13 @@ EXTERN t_binbuf *binbuf_duplicate(const t_binbuf *y);
 
 EXTERN void binbuf_text(t_binbuf *x, const char *text, size_t size);
 EXTERN void binbuf_gettext(const t_binbuf *x, char **bufp, int *lengthp);
+EXTERN void binbuf_getbinary(const t_binbuf *x, char **bufp, int *lengthp);
+EXTERN int binbuf_setbinary(t_binbuf *x, const char *buf, size_t length);
+EXTERN int binbuf_isbinary(const char *buf, size_t length);
+EXTERN void binbuf_putnetmessage(char **bufp, int *sizep, int *lengthp,
+    int argc, const t_atom *argv);
+EXTERN int binbuf_netmessagesize(const char *buf, int length);
+EXTERN int binbuf_addnetmessages(t_binbuf *x, const char *buf, int length);
 EXTERN void binbuf_clear(t_binbuf *x);
 EXTERN void binbuf_add(t_binbuf *x, int argc, const t_atom *argv);
 EXTERN void binbuf_addv(t_binbuf *x, const char *fmt, ...);
@@ -605,6 +617,13 @@ typedef struct _signal
     struct _signal *s_nextfree;         /* next in freelist */
     struct _signal *s_nextused;         /* next in used list */
     int s_vecsize;      /* allocated size of array in points */
+        /* the rest is for signals that are constant over each DSP block;
+        see dsp_add_scalarsignal() and signal_getscalar() */
+    t_float *s_scalar;  /* if nonzero, the signal's value for the block */
+    t_float s_scalarvalue;  /* storage for computed constants */
+    int s_scalarfill;   /* place in DSP chain of code that fills s_vec */
+    int s_nreaders;     /* number of connections reading the signal */
+    int s_nscalarreaders;   /* how many of them took the scalar instead */
 } t_signal;
 
 typedef t_int *(*t_perfroutine)(t_int *args);
@@ -617,6 +636,8 @@ EXTERN void dsp_add_plus(t_sample *in1, t_sample *in2, t_sample *out, int n);
 EXTERN void dsp_add_copy(t_sample *in, t_sample *out, int n);
 EXTERN void dsp_add_scalarcopy(t_float *in, t_sample *out, int n);
 EXTERN void dsp_add_zero(t_sample *out, int n);
+EXTERN void dsp_add_scalarsignal(t_float *in, t_signal *sig);
+EXTERN t_float *signal_getscalar(t_signal *sig);
 
 EXTERN int sys_getblksize(void);
 EXTERN t_float sys_getsr(void);
@@ -913,6 +934,8 @@ struct _pdinstance
 #if PDTHREADS
     int pd_islocked;
 #endif
+    int pd_symhashsize;         /* number of slots in pd_symhash */
+    int pd_nsymbols;            /* number of symbols in pd_symhash */
 };
 #define t_pdinstance struct _pdinstance
 EXTERN t_pdinstance pd_maininstance;
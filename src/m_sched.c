@@ -252,7 +252,8 @@ void sched_tick(void)
         if (!countdown--)
         {
             countdown = 5000;
-            (void)sys_pollgui();
+            if (!sys_headless)
+                (void)sys_pollgui();
         }
         if (sys_quit)
             return;
@@ -328,6 +329,31 @@ static int sched_idletask( void)
     return (rtn || sys_idlehook && sys_idlehook());
 }
 
+    /* see whether it's time for another DSP tick: either real time has
+    caught up with logical time, or the audio device took a block.  Call with
+    the Pd lock unset. */
+static int sched_timeforward(void)
+{
+    if (sched_useaudio == SCHED_AUDIO_NONE)
+    {
+            /* no audio; use system clock */
+        double lateness = 1000. *
+            (sys_getrealtime() - sched_referencerealtime) -
+                clock_gettimesince(sched_referencelogicaltime);
+        if (lateness > 20000)   /* if 20" late, don't try to catch up */
+        {
+            sched_referencerealtime = sys_getrealtime();
+            sched_referencelogicaltime = pd_this->pd_systime;
+        }
+        return (lateness > 0 ? SENDDACS_YES : SENDDACS_NO);
+    }
+    else return (sys_send_dacs());
+}
+
+    /* for "pd schedstats" */
+static int sched_nwakeups, sched_statcounter;
+static double sched_stattime;
+
 static void m_pollingscheduler(void)
 {
     sys_lock();
@@ -356,20 +382,7 @@ static void m_pollingscheduler(void)
             int timeforward; /* SENDDACS_YES if audio was transferred, SENDDACS_NO if not,
                                 or SENDDACS_SLEPT if yes but time elapsed during xfer */
             sys_unlock();
-            if (sched_useaudio == SCHED_AUDIO_NONE)
-            {
-                    /* no audio; use system clock */
-                double lateness = 1000. *
-                    (sys_getrealtime() - sched_referencerealtime) -
-                        clock_gettimesince(sched_referencelogicaltime);
-                if (lateness > 20000)   /* if 20" late, don't try to catch up */
-                {
-                    sched_referencerealtime = sys_getrealtime();
-                    sched_referencelogicaltime = pd_this->pd_systime;
-                }
-                timeforward = (lateness > 0 ? SENDDACS_YES : SENDDACS_NO);
-            }
-            else timeforward = sys_send_dacs();
+            timeforward = sched_timeforward();
             sys_addhist(3);
                 /* test for idle; if so, do graphics updates. */
             if (timeforward != SENDDACS_YES && !sched_idletask() && !sys_nosleep)
@@ -383,10 +396,69 @@ static void m_pollingscheduler(void)
             if (timeforward != SENDDACS_NO)
                 break;
         }
+        sched_nwakeups++;
+    }
+    sys_unlock();
+}
+
+    /* the scheduler for "-headless".  With no GUI to keep lively, we run all
+    the DSP ticks that are due (up to SCHED_MAXBATCH at a time) without
+    stopping, and only then poll for MIDI and other input and go back to
+    sleep.  Input arriving while we sleep still wakes us up at once. */
+#define SCHED_MAXBATCH 64
+
+static void m_leanscheduler(void)
+{
+    int nticks = 0;
+    sys_lock();
+    sys_initmidiqueue();
+    while (!sys_quit)
+    {
+        sched_tick();
+        if (sched_fastforward > 0)
+        {
+            sched_fastforward -= SYSTIMEPERTICK;
+            sched_referencerealtime = sys_getrealtime();
+            sched_referencelogicaltime = pd_this->pd_systime;
+            continue;
+        }
+        sys_unlock();
+        if (++nticks < SCHED_MAXBATCH && sched_timeforward() != SENDDACS_NO)
+        {
+            sys_lock();
+            continue;
+        }
+            /* end of a batch */
+        nticks = 0;
+        sched_nwakeups++;
+        sys_lock();
+        sys_pollmidiqueue();
+        sys_unlock();
+        (void)sched_idletask();
+        while (!sys_quit && sched_timeforward() == SENDDACS_NO)
+            if (!sched_idletask() && !sys_nosleep)
+                sys_microsleep();
+        sys_lock();
     }
     sys_unlock();
 }
 
+    /* "pd schedstats": print how fast the scheduler has gone since last asked.
+    "wakeups" are the times it stopped to look for input. */
+void glob_schedstats(void *dummy)
+{
+    double now = sys_getrealtime(), elapsed = now - sched_stattime;
+    int nticks = sched_counter - sched_statcounter;
+    if (elapsed > 0)
+        post("scheduler: %.0f ticks/sec (%.2f times real time), "
+            "%.0f wakeups/sec", nticks / elapsed,
+                nticks * SYSTIMEPERTICK / (TIMEUNITPERSECOND * elapsed),
+                    sched_nwakeups / elapsed);
+    sched_stattime = now;
+    sched_statcounter = sched_counter;
+    sched_nwakeups = 0;
+}
+
 void sched_audio_callbackfn(void)
 {
     sys_lock();
@@ -429,6 +501,8 @@ int m_mainloop(void)
     {
         if (sched_useaudio == SCHED_AUDIO_CALLBACK)
             m_callbackscheduler();
+        else if (sys_headless)
+            m_leanscheduler();
         else m_pollingscheduler();
         if (sys_quit == SYS_QUIT_RESTART)
         {
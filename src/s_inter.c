@@ -84,6 +84,21 @@ static int stderr_isatty;
 
 #if PDTHREADS
 #include "pthread.h"
+#endif
+
+    /* on Unix a separate thread writes to the GUI socket (see below) */
+#if PDTHREADS && !defined(_WIN32) && defined(__GNUC__)
+#define GUITHREAD
+#endif
+
+    /* on Linux, poll file descriptors with epoll and sleep on a timerfd, so
+    that the cost of polling doesn't grow with the number of open sockets and
+    incoming data can cut a sleep short.  Elsewhere we use select(). */
+#if defined(__linux__) && !defined(PD_NOEPOLL)
+#define HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#define MAXEPOLLEVENTS 64
 #endif
 
 typedef struct _fdpoll
@@ -91,13 +106,19 @@ typedef struct _fdpoll
     int fdp_fd;
     t_fdpollfn fdp_fn;
     void *fdp_ptr;
+#ifdef HAVE_EPOLL
+    int fdp_noepoll;    /* epoll refused it (a regular file, say) */
+#endif
 } t_fdpoll;
 
 struct _socketreceiver
 {
     char *sr_inbuf;
-    int sr_inhead;
-    int sr_intail;
+    int sr_inhead;      /* end of received data */
+    int sr_intail;      /* start of the first unparsed message */
+    int sr_inscan;      /* no message boundary before this point */
+    int sr_insize;      /* allocated size of sr_inbuf */
+    int sr_netmessages; /* binary messages as from "netsend -t", not FUDI */
     void *sr_owner;
     int sr_udp;
     struct sockaddr_storage *sr_fromaddr; /* optional */
@@ -112,17 +133,56 @@ typedef struct _guiqueue
     t_glist *gq_glist;
     t_guicallbackfn gq_fn;
     struct _guiqueue *gq_next;
+    struct _guiqueue *gq_prev;
+    struct _guiqueue *gq_hashnext;  /* next in hash bucket */
 } t_guiqueue;
 
+#ifdef GUITHREAD
+    /* The GUI sender thread.  The scheduler copies outgoing text into a ring
+    buffer and the thread writes it to the socket, so that a slow GUI can't
+    hold DSP up.  There's one writer and one reader: only the scheduler
+    moves gs_write and only the thread moves gs_read. */
+typedef struct _guisender
+{
+    pthread_t gs_thread;
+    int gs_sock;
+    char *gs_ring;
+    unsigned int gs_write;  /* bytes put in so far, modulo 2^32 */
+    unsigned int gs_read;   /* bytes sent so far */
+    int gs_sleeping;        /* thread is waiting for a wakeup on gs_pipe */
+    int gs_quit;            /* send what's left and exit */
+    int gs_err;             /* errno from a failed send(), or 0 */
+    int gs_pipe[2];
+} t_guisender;
+#endif
+
 struct _instanceinter
 {
     int i_havegui;
     int i_nfdpoll;
     t_fdpoll *i_fdpoll;
+    int i_fdpollsize;   /* allocated size of i_fdpoll */
+    int *i_fdindex;     /* position of each fd in i_fdpoll, or -1 */
+    int i_fdindexsize;
     int i_maxfd;
+#ifdef HAVE_EPOLL
+    int i_epollfd;      /* epoll instance, or -1 to fall back to select() */
+    int i_timerfd;      /* timer to sleep on in epoll_wait() */
+    int i_nnoepoll;     /* fds epoll refused; while any, we use select() */
+#endif
     int i_guisock;
     t_socketreceiver *i_socketreceiver;
     t_guiqueue *i_guiqueuehead;
+    t_guiqueue *i_guiqueuetail;
+    t_guiqueue **i_guiqueuehash;    /* queued updates by client */
+    int i_guiqueuehashsize;
+    int i_guiqueuen;
+    double i_guinextframe;  /* when we may start on the queue again */
+    int i_guidraining;      /* updates left to send in the current frame */
+    double i_guistattime;   /* statistics since this time, for "guistats" */
+    double i_guinbytes;
+    double i_guinupdates;
+    double i_guinmerged;
     t_binbuf *i_inbinbuf;
     char *i_guibuf;
     int i_guihead;
@@ -131,6 +191,9 @@ struct _instanceinter
     int i_waitingforping;
     int i_bytessincelastping;
     int i_fdschanged;   /* flag to break fdpoll loop if fd list changes */
+#ifdef GUITHREAD
+    t_guisender *i_guisender;   /* zero if we write to the socket ourselves */
+#endif
 
 #ifdef _WIN32
     LARGE_INTEGER i_inittime;
@@ -203,6 +266,87 @@ double sys_getrealtime(void)
 #endif
 }
 
+#ifdef HAVE_EPOLL
+static int sys_epolladd(int fd)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    return (epoll_ctl(INTER->i_epollfd, EPOLL_CTL_ADD, fd, &ev));
+}
+
+static void sys_init_epoll(void)
+{
+    INTER->i_timerfd = -1;
+    if ((INTER->i_epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        perror("epoll: falling back to select");
+    else if ((INTER->i_timerfd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_NONBLOCK|TFD_CLOEXEC)) < 0 ||
+            sys_epolladd(INTER->i_timerfd) < 0)
+    {
+        perror("epoll: falling back to select");
+        if (INTER->i_timerfd >= 0)
+            close(INTER->i_timerfd);
+        close(INTER->i_epollfd);
+        INTER->i_epollfd = INTER->i_timerfd = -1;
+    }
+}
+
+    /* empty the timerfd so that it stops reporting ready */
+static void sys_epolldrain(int fd)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("microsleep read");
+}
+
+    /* epoll version of sys_domicrosleep() below.  Sleeping is done by waiting
+    on the fd set itself with a timerfd armed for the sleep time, so we wake
+    up as soon as anything arrives rather than at the end of the sleep grain. */
+static int sys_epollsleep(int microsec)
+{
+    struct epoll_event ev[MAXEPOLLEVENTS];
+    int i, n, didsomething = 0;
+    if ((n = epoll_wait(INTER->i_epollfd, ev, MAXEPOLLEVENTS, 0)) < 0 &&
+        errno != EINTR)
+            perror("microsleep epoll");
+    INTER->i_fdschanged = 0;
+    for (i = 0; i < n && !INTER->i_fdschanged; i++)
+    {
+        int fd = ev[i].data.fd, index;
+        if (fd == INTER->i_timerfd)
+            sys_epolldrain(fd);
+        else if (fd < INTER->i_fdindexsize &&
+            (index = INTER->i_fdindex[fd]) >= 0)
+        {
+            (*INTER->i_fdpoll[index].fdp_fn)
+                (INTER->i_fdpoll[index].fdp_ptr, fd);
+            didsomething = 1;
+        }
+    }
+    if (didsomething)
+        return (1);
+    if (microsec)
+    {
+        struct itimerspec when;
+        when.it_interval.tv_sec = when.it_interval.tv_nsec = 0;
+        when.it_value.tv_sec = microsec / 1000000;
+        when.it_value.tv_nsec = (microsec % 1000000) * 1000;
+        if (timerfd_settime(INTER->i_timerfd, 0, &when, 0) < 0)
+            perror("microsleep timerfd");
+        sys_unlock();
+        n = epoll_wait(INTER->i_epollfd, ev, MAXEPOLLEVENTS, -1);
+        sys_lock();
+            /* other fds are left for the next poll to dispatch */
+        for (i = 0; i < n; i++)
+            if (ev[i].data.fd == INTER->i_timerfd)
+                sys_epolldrain(ev[i].data.fd);
+    }
+    return (0);
+}
+#endif /* HAVE_EPOLL */
+
 /* sleep (but cancel the sleeping if any file descriptors are
 ready - in that case, dispatch any resulting Pd messages and return.  Called
 with sys_lock() set.  We will temporarily release the lock if we actually
@@ -212,6 +356,10 @@ static int sys_domicrosleep(int microsec)
     struct timeval timeout;
     int i, didsomething = 0;
     t_fdpoll *fp;
+#ifdef HAVE_EPOLL
+    if (INTER->i_fdpoll && INTER->i_epollfd >= 0 && !INTER->i_nnoepoll)
+        return (sys_epollsleep(microsec));
+#endif
     timeout.tv_sec = 0;
     timeout.tv_usec = 0;
     if (INTER->i_nfdpoll)
@@ -418,57 +566,94 @@ void sys_sockerror(const char *s)
 
 void sys_addpollfn(int fd, t_fdpollfn fn, void *ptr)
 {
-    int nfd, size;
+    int nfd;
     t_fdpoll *fp;
     sys_init_fdpoll();
     nfd = INTER->i_nfdpoll;
-    size = nfd * sizeof(t_fdpoll);
-    INTER->i_fdpoll = (t_fdpoll *)t_resizebytes(
-        INTER->i_fdpoll, size, size + sizeof(t_fdpoll));
+    if (nfd == INTER->i_fdpollsize)
+    {
+        int newsize = 2 * INTER->i_fdpollsize;
+        INTER->i_fdpoll = (t_fdpoll *)t_resizebytes(INTER->i_fdpoll,
+            INTER->i_fdpollsize * sizeof(t_fdpoll), newsize * sizeof(t_fdpoll));
+        INTER->i_fdpollsize = newsize;
+    }
+    if (fd >= INTER->i_fdindexsize)
+    {
+        int i, newsize = 2 * INTER->i_fdindexsize;
+        while (fd >= newsize)
+            newsize *= 2;
+        INTER->i_fdindex = (int *)t_resizebytes(INTER->i_fdindex,
+            INTER->i_fdindexsize * sizeof(int), newsize * sizeof(int));
+        for (i = INTER->i_fdindexsize; i < newsize; i++)
+            INTER->i_fdindex[i] = -1;
+        INTER->i_fdindexsize = newsize;
+    }
     fp = INTER->i_fdpoll + nfd;
     fp->fdp_fd = fd;
     fp->fdp_fn = fn;
     fp->fdp_ptr = ptr;
+    INTER->i_fdindex[fd] = nfd;
     INTER->i_nfdpoll = nfd + 1;
     if (fd >= INTER->i_maxfd)
         INTER->i_maxfd = fd + 1;
     INTER->i_fdschanged = 1;
+#ifdef HAVE_EPOLL
+    fp->fdp_noepoll = 0;
+        /* epoll won't take regular files and some devices, which select()
+        just reports as always ready.  Fall back to select() while we have
+        any of those. */
+    if (INTER->i_epollfd >= 0 && sys_epolladd(fd) < 0)
+    {
+        if (errno != EPERM)
+            perror("epoll_ctl");
+        fp->fdp_noepoll = 1;
+        INTER->i_nnoepoll++;
+    }
+#endif
 }
 
 void sys_rmpollfn(int fd)
 {
-    int nfd = INTER->i_nfdpoll;
-    int i, size = nfd * sizeof(t_fdpoll);
-    t_fdpoll *fp;
+    int nfd = INTER->i_nfdpoll, index;
     INTER->i_fdschanged = 1;
-    for (i = nfd, fp = INTER->i_fdpoll; i--; fp++)
+    if (fd >= 0 && fd < INTER->i_fdindexsize &&
+        (index = INTER->i_fdindex[fd]) >= 0)
     {
-        if (fp->fdp_fd == fd)
-        {
-            while (i--)
-            {
-                fp[0] = fp[1];
-                fp++;
-            }
-            INTER->i_fdpoll = (t_fdpoll *)t_resizebytes(
-                INTER->i_fdpoll, size, size - sizeof(t_fdpoll));
-            INTER->i_nfdpoll = nfd - 1;
-            return;
-        }
+#ifdef HAVE_EPOLL
+        int noepoll = INTER->i_fdpoll[index].fdp_noepoll;
+#endif
+            /* move the last entry into the hole */
+        INTER->i_fdpoll[index] = INTER->i_fdpoll[nfd - 1];
+        INTER->i_fdindex[INTER->i_fdpoll[index].fdp_fd] = index;
+        INTER->i_fdindex[fd] = -1;
+        INTER->i_nfdpoll = nfd - 1;
+#ifdef HAVE_EPOLL
+            /* the fd may already have been closed, which removes it */
+        if (noepoll)
+            INTER->i_nnoepoll--;
+        else if (INTER->i_epollfd >= 0 &&
+            epoll_ctl(INTER->i_epollfd, EPOLL_CTL_DEL, fd, 0) < 0 &&
+                errno != EBADF && errno != ENOENT)
+                    perror("epoll_ctl");
+#endif
+        return;
     }
     post("warning: %d removed from poll list but not found", fd);
 }
 
-    /* Size of the buffer used for parsing FUDI messages
-    received over TCP. Must be a power of two!
-    LATER make this settable per socketreceiver instance */
+    /* Initial size of the buffer used for parsing messages received over
+    TCP.  It's doubled as needed up to MAXINBUFSIZE; messages longer than
+    that are dropped. */
 #define INBUFSIZE 4096
+#define MAXINBUFSIZE (1<<20)
 
 t_socketreceiver *socketreceiver_new(void *owner, t_socketnotifier notifier,
     t_socketreceivefn socketreceivefn, int udp)
 {
     t_socketreceiver *x = (t_socketreceiver *)getbytes(sizeof(*x));
-    x->sr_inhead = x->sr_intail = 0;
+    x->sr_inhead = x->sr_intail = x->sr_inscan = 0;
+    x->sr_insize = INBUFSIZE;
+    x->sr_netmessages = 0;
     x->sr_owner = owner;
     x->sr_notifier = notifier;
     x->sr_socketreceivefn = socketreceivefn;
@@ -493,56 +678,88 @@ void socketreceiver_free(t_socketreceiver *x)
     freebytes(x, sizeof(*x));
 }
 
-    /* this is in a separately called subroutine so that the buffer isn't
-    sitting on the stack while the messages are getting passed. */
+    /* find the first semicolon between s and e that ends a FUDI message,
+    that is, one preceded by an even number of backslashes.  Backslashes
+    before s are taken to be unescaped.  This is also called from the
+    network thread in x_net.c. */
+char *socketreceiver_findsemi(char *s, char *e)
+{
+    char *semi, *bp;
+    while ((semi = (char *)memchr(s, ';', e - s)))
+    {
+        for (bp = semi; bp > s && bp[-1] == '\\'; bp--)
+            ;
+        if (!((semi - bp) & 1))
+            return (semi);
+        s = semi + 1;
+    }
+    return (0);
+}
+
+    /* parse the next complete message in the input buffer into the
+    instance's input binbuf.  The buffer is linear (it's shifted down
+    before reading when it fills up) so messages can be tokenized straight
+    out of it. */
 static int socketreceiver_doread(t_socketreceiver *x)
 {
-    char messbuf[INBUFSIZE], *bp = messbuf;
-    int indx, first = 1;
-    int inhead = x->sr_inhead;
-    int intail = x->sr_intail;
-    char *inbuf = x->sr_inbuf;
-    for (indx = intail; first || (indx != inhead);
-        first = 0, (indx = (indx+1)&(INBUFSIZE-1)))
+    char *inbuf = x->sr_inbuf, *msg = inbuf + x->sr_intail, *semi;
+    if (x->sr_netmessages)
     {
-            /* if we hit a semi that isn't preceded by a \, it's a message
-            boundary. LATER we should deal with the possibility that the
-            preceding \ might itself be escaped! */
-        char c = *bp++ = inbuf[indx];
-        if (c == ';' && (!indx || inbuf[indx-1] != '\\'))
+        int size = binbuf_netmessagesize(msg, x->sr_inhead - x->sr_intail);
+        if (size > MAXINBUFSIZE / 2)
         {
-            intail = (indx+1)&(INBUFSIZE-1);
-            binbuf_text(INTER->i_inbinbuf, messbuf, bp - messbuf);
-            if (sys_debuglevel & DEBUG_MESSDOWN)
-            {
-                size_t bufsize = (bp>messbuf)?(bp-messbuf):0;
-                int colorize = stderr_isatty && (sys_debuglevel & DEBUG_COLORIZE);
-                const char*msg = messbuf;
-                if (('\r' == messbuf[0]) && ('\n' == messbuf[1]))
-                {
-                    bufsize-=2;
-                    msg+=2;
-                }
-        #ifdef _WIN32
-            #ifdef _MSC_VER
-                fwprintf(stderr, L"<< %.*S\n", (int)bufsize, msg);
-            #else
-                fwprintf(stderr, L"<< %.*s\n", (int)bufsize, msg);
-            #endif
-                fflush(stderr);
+            pd_error(x->sr_owner, "bad message length");
+            x->sr_inhead = x->sr_intail = x->sr_inscan = 0;
+            return (0);
+        }
+        if (!size || size > x->sr_inhead - x->sr_intail)
+            return (0);
+        binbuf_clear(INTER->i_inbinbuf);
+        if (binbuf_addnetmessages(INTER->i_inbinbuf, msg, size))
+            pd_error(x->sr_owner, "bad binary message dropped");
+        x->sr_intail = x->sr_inscan = x->sr_intail + size;
+        if (x->sr_intail == x->sr_inhead)
+            x->sr_inhead = x->sr_intail = x->sr_inscan = 0;
+        return (1);
+    }
+    if (!(semi = socketreceiver_findsemi(inbuf + x->sr_inscan,
+        inbuf + x->sr_inhead)))
+    {
+            /* the semi might be escaped by a backslash we haven't seen
+            yet, so leave one trailing backslash for the next scan */
+        x->sr_inscan = x->sr_inhead;
+        while (x->sr_inscan > x->sr_intail && inbuf[x->sr_inscan - 1] == '\\')
+            x->sr_inscan--;
+        return (0);
+    }
+    binbuf_text(INTER->i_inbinbuf, msg, semi + 1 - msg);
+    if (sys_debuglevel & DEBUG_MESSDOWN)
+    {
+        size_t bufsize = semi + 1 - msg;
+        int colorize = stderr_isatty && (sys_debuglevel & DEBUG_COLORIZE);
+        if (bufsize >= 2 && ('\r' == msg[0]) && ('\n' == msg[1]))
+        {
+            bufsize-=2;
+            msg+=2;
+        }
+    #ifdef _WIN32
+        #ifdef _MSC_VER
+        fwprintf(stderr, L"<< %.*S\n", (int)bufsize, msg);
         #else
-                if(colorize)
-                    fprintf(stderr, "\e[0;1;36m<< %.*s\e[0m\n", (int)bufsize, msg);
-                else
-                    fprintf(stderr, "<< %.*s\n", (int)bufsize, msg);
+        fwprintf(stderr, L"<< %.*s\n", (int)bufsize, msg);
         #endif
-            }
-            x->sr_inhead = inhead;
-            x->sr_intail = intail;
-            return (1);
-        }
+        fflush(stderr);
+    #else
+        if(colorize)
+            fprintf(stderr, "\e[0;1;36m<< %.*s\e[0m\n", (int)bufsize, msg);
+        else
+            fprintf(stderr, "<< %.*s\n", (int)bufsize, msg);
+    #endif
     }
-    return (0);
+    x->sr_intail = x->sr_inscan = (int)(semi + 1 - inbuf);
+    if (x->sr_intail == x->sr_inhead)
+        x->sr_inhead = x->sr_intail = x->sr_inscan = 0;
+    return (1);
 }
 
 static void socketreceiver_getudp(t_socketreceiver *x, int fd)
@@ -583,7 +800,19 @@ static void socketreceiver_getudp(t_socketreceiver *x, int fd)
     #if 0
             post("%s", buf);
     #endif
-            if (buf[ret-1] != '\n')
+            if (x->sr_netmessages)
+            {
+                binbuf_clear(INTER->i_inbinbuf);
+                if (binbuf_addnetmessages(INTER->i_inbinbuf, buf, ret))
+                    pd_error(x->sr_owner, "bad binary message dropped");
+                if (x->sr_fromaddrfn)
+                    (*x->sr_fromaddrfn)(x->sr_owner, (const void *)x->sr_fromaddr);
+                outlet_setstacklim();
+                if (x->sr_socketreceivefn)
+                    (*x->sr_socketreceivefn)(x->sr_owner,
+                        INTER->i_inbinbuf);
+            }
+            else if (buf[ret-1] != '\n')
             {
     #if 0
                 pd_error(0, "dropped bad buffer %s\n", buf);
@@ -620,22 +849,36 @@ void socketreceiver_read(t_socketreceiver *x, int fd)
         socketreceiver_getudp(x, fd);
     else  /* TCP ("streaming") socket protocol */
     {
-        char *semi;
-        int readto =
-            (x->sr_inhead >= x->sr_intail ? INBUFSIZE : x->sr_intail-1);
         int ret;
 
+            /* move a partial message down to the start of the buffer */
+        if (x->sr_inhead == x->sr_insize && x->sr_intail > 0)
+        {
+            memmove(x->sr_inbuf, x->sr_inbuf + x->sr_intail,
+                x->sr_inhead - x->sr_intail);
+            x->sr_inhead -= x->sr_intail;
+            x->sr_inscan -= x->sr_intail;
+            x->sr_intail = 0;
+        }
+            /* if it's still full, make it bigger */
+        if (x->sr_inhead == x->sr_insize && x->sr_insize < MAXINBUFSIZE)
+        {
+            char *newbuf = realloc(x->sr_inbuf, 2 * x->sr_insize);
+            if (newbuf)
+                x->sr_inbuf = newbuf, x->sr_insize *= 2;
+        }
             /* the input buffer might be full. If so, drop the whole thing */
-        if (readto == x->sr_inhead)
+        if (x->sr_inhead == x->sr_insize)
         {
-            fprintf(stderr, "pd: dropped message from gui\n");
-            x->sr_inhead = x->sr_intail = 0;
-            readto = INBUFSIZE;
+            if (x == INTER->i_socketreceiver)
+                fprintf(stderr, "pd: dropped message from gui\n");
+            else pd_error(x->sr_owner, "message too long; dropped");
+            x->sr_inhead = x->sr_intail = x->sr_inscan = 0;
         }
         else
         {
             ret = (int)recv(fd, x->sr_inbuf + x->sr_inhead,
-                readto - x->sr_inhead, 0);
+                x->sr_insize - x->sr_inhead, 0);
             if (ret <= 0)
             {
                 if (ret < 0)
@@ -666,7 +909,6 @@ void socketreceiver_read(t_socketreceiver *x, int fd)
             else
             {
                 x->sr_inhead += ret;
-                if (x->sr_inhead >= INBUFSIZE) x->sr_inhead = 0;
                 while (socketreceiver_doread(x))
                 {
                     if (x->sr_fromaddrfn)
@@ -691,6 +933,13 @@ void socketreceiver_read(t_socketreceiver *x, int fd)
     }
 }
 
+    /* exchange binary messages (see binbuf_putnetmessage()) instead of FUDI
+    text */
+void socketreceiver_set_netmessages(t_socketreceiver *x, int netmessages)
+{
+    x->sr_netmessages = netmessages;
+}
+
 void socketreceiver_set_fromaddrfn(t_socketreceiver *x,
     t_socketfromaddrfn fromaddrfn)
 {
@@ -716,6 +965,189 @@ void sys_closesocket(int sockfd)
 #define GUI_ALLOCCHUNK 8192
 #define GUI_UPDATESLICE 512 /* how much we try to do in one idle period */
 #define GUI_BYTESPERPING 1024 /* how much we send up per ping */
+#define GUI_QUITWAIT 2. /* seconds to wait for a stuck GUI when quitting */
+
+#ifdef GUITHREAD
+
+#define GUI_RINGSIZE (1<<20)    /* power of two */
+
+static void *guisender_run(void *z)
+{
+    t_guisender *x = (t_guisender *)z;
+    while (1)
+    {
+        unsigned int rd = x->gs_read,
+            wr = __atomic_load_n(&x->gs_write, __ATOMIC_ACQUIRE);
+        if (rd == wr)
+        {
+            char buf[64];
+            if (__atomic_load_n(&x->gs_quit, __ATOMIC_ACQUIRE))
+                break;
+                /* check again after saying we're asleep, so that the
+                scheduler either sees gs_sleeping or we see its data */
+            __atomic_store_n(&x->gs_sleeping, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&x->gs_write, __ATOMIC_SEQ_CST) == rd &&
+                !__atomic_load_n(&x->gs_quit, __ATOMIC_SEQ_CST) &&
+                    read(x->gs_pipe[0], buf, sizeof(buf)) < 0 &&
+                        errno != EINTR)
+                            perror("GUI sender");
+            __atomic_store_n(&x->gs_sleeping, 0, __ATOMIC_SEQ_CST);
+        }
+        else
+        {
+            unsigned int onset = rd & (GUI_RINGSIZE - 1), n = wr - rd;
+            int res;
+            if (n > GUI_RINGSIZE - onset)
+                n = GUI_RINGSIZE - onset;
+            if ((res = (int)send(x->gs_sock, x->gs_ring + onset, n, 0)) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                __atomic_store_n(&x->gs_err, errno, __ATOMIC_RELEASE);
+                break;
+            }
+            __atomic_store_n(&x->gs_read, rd + res, __ATOMIC_RELEASE);
+        }
+    }
+    return (0);
+}
+
+static void guisender_wake(t_guisender *x)
+{
+    if (__atomic_exchange_n(&x->gs_sleeping, 0, __ATOMIC_SEQ_CST))
+    {
+        char c = 0;
+        if (write(x->gs_pipe[1], &c, 1) < 0 && errno != EAGAIN)
+            perror("GUI sender");
+    }
+}
+
+static void guisender_new(int sock)
+{
+    t_guisender *x;
+    if (sys_noguithread)
+        return;
+    x = (t_guisender *)getbytes(sizeof(*x));
+    x->gs_sock = sock;
+    x->gs_ring = (char *)getbytes(GUI_RINGSIZE);
+    if (pipe(x->gs_pipe) < 0)
+        goto fail;
+    fcntl(x->gs_pipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(x->gs_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(x->gs_pipe[1], F_SETFD, FD_CLOEXEC);
+    if (pthread_create(&x->gs_thread, 0, guisender_run, x))
+    {
+        close(x->gs_pipe[0]);
+        close(x->gs_pipe[1]);
+        goto fail;
+    }
+    INTER->i_guisender = x;
+    return;
+fail:
+    fprintf(stderr, "Pd: couldn't start GUI sender thread\n");
+    freebytes(x->gs_ring, GUI_RINGSIZE);
+    freebytes(x, sizeof(*x));
+}
+
+    /* copy as much as fits into the ring.  Returns the number of bytes
+    taken, or -1 (with errno set) if the thread has failed to send. */
+static int guisender_put(t_guisender *x, const char *buf, int n)
+{
+    unsigned int wr = x->gs_write,
+        room = GUI_RINGSIZE - (wr - __atomic_load_n(&x->gs_read,
+            __ATOMIC_ACQUIRE)),
+        onset = wr & (GUI_RINGSIZE - 1), n1;
+    int err = __atomic_load_n(&x->gs_err, __ATOMIC_ACQUIRE);
+    if (err)
+    {
+        errno = err;
+        return (-1);
+    }
+    if ((unsigned int)n > room)
+        n = room;
+    if (!n)
+        return (0);
+    n1 = GUI_RINGSIZE - onset;
+    if ((unsigned int)n <= n1)
+        memcpy(x->gs_ring + onset, buf, n);
+    else
+    {
+        memcpy(x->gs_ring + onset, buf, n1);
+        memcpy(x->gs_ring, buf + n1, n - n1);
+    }
+    __atomic_store_n(&x->gs_write, wr + n, __ATOMIC_SEQ_CST);
+    guisender_wake(x);
+    return (n);
+}
+
+    /* true if the GUI is reading more slowly than we're writing */
+static int guisender_busy(t_guisender *x)
+{
+    return (x->gs_write - __atomic_load_n(&x->gs_read, __ATOMIC_ACQUIRE) >
+        GUI_RINGSIZE/2);
+}
+
+    /* let the thread send everything that's in the ring, and stop it.  If
+    the GUI doesn't read it in time, shut the socket down so that the thread
+    can't stay stuck in send(). */
+static void guisender_free(void)
+{
+    t_guisender *x = INTER->i_guisender;
+    double giveup = sys_getrealtime() + GUI_QUITWAIT;
+    char c = 0;
+    if (!x)
+        return;
+    __atomic_store_n(&x->gs_quit, 1, __ATOMIC_SEQ_CST);
+    if (write(x->gs_pipe[1], &c, 1) < 0 && errno != EAGAIN)
+        perror("GUI sender");
+    while (__atomic_load_n(&x->gs_read, __ATOMIC_ACQUIRE) != x->gs_write &&
+        !__atomic_load_n(&x->gs_err, __ATOMIC_ACQUIRE) &&
+            sys_getrealtime() < giveup)
+                usleep(1000);
+    if (__atomic_load_n(&x->gs_read, __ATOMIC_ACQUIRE) != x->gs_write)
+        shutdown(x->gs_sock, SHUT_RDWR);
+    pthread_join(x->gs_thread, 0);
+    close(x->gs_pipe[0]);
+    close(x->gs_pipe[1]);
+    freebytes(x->gs_ring, GUI_RINGSIZE);
+    freebytes(x, sizeof(*x));
+    INTER->i_guisender = 0;
+}
+
+#endif /* GUITHREAD */
+
+static int sys_doflushtogui(void);
+
+    /* write out everything in the buffer, waiting if we have to.  If the
+    socket fails we bail out, or when quitting, just stop trying; we also
+    give up on a GUI that hasn't read anything for a while. */
+static void sys_drainguibuf(int bail)
+{
+    double giveup = sys_getrealtime() + GUI_QUITWAIT;
+    int nwrote;
+    while (INTER->i_guihead > INTER->i_guitail)
+    {
+        if ((nwrote = sys_doflushtogui()) < 0)
+        {
+            if (!bail)
+                return;
+            perror("pd-to-gui socket");
+            sys_bail(1);
+        }
+        else if (nwrote)
+            giveup = sys_getrealtime() + GUI_QUITWAIT;
+        else if (!bail && sys_getrealtime() > giveup)
+            return;
+        else
+        {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+    }
+}
 
 static void sys_trytogetmoreguibuf(int newsize)
 {
@@ -751,29 +1183,7 @@ static void sys_trytogetmoreguibuf(int newsize)
         synchronously writing out the existing contents.  LATER test
         this by intentionally setting newbuf to zero */
     if (!newbuf)
-    {
-        int bytestowrite = INTER->i_guihead - INTER->i_guitail;
-        int written = 0;
-        while (1)
-        {
-            int res = (int)send(
-                INTER->i_guisock,
-                INTER->i_guibuf + INTER->i_guitail + written,
-                bytestowrite, 0);
-            if (res < 0)
-            {
-                perror("pd output pipe");
-                sys_bail(1);
-            }
-            else
-            {
-                written += res;
-                if (written >= bytestowrite)
-                    break;
-            }
-        }
-        INTER->i_guihead = INTER->i_guitail = 0;
-    }
+        sys_drainguibuf(1);
     else
     {
         INTER->i_guisize = newsize;
@@ -786,6 +1196,8 @@ int sys_havegui(void)
     return (INTER->i_havegui);
 }
 
+static void sys_didgui(int msglen);
+
 void sys_vgui(const char *fmt, ...)
 {
     int msglen, bytesleft, headwas, nwrote;
@@ -837,6 +1249,13 @@ void sys_vgui(const char *fmt, ...)
         if (msglen >= INTER->i_guisize - INTER->i_guihead)
             msglen  = INTER->i_guisize - INTER->i_guihead;
     }
+    sys_didgui(msglen);
+}
+
+    /* common tail of sys_vgui() and sys_gui(): the new text is at
+    i_guihead */
+static void sys_didgui(int msglen)
+{
     if (sys_debuglevel & DEBUG_MESSUP)
     {
         const char *mess = INTER->i_guibuf + INTER->i_guihead;
@@ -862,15 +1281,33 @@ void sys_vgui(const char *fmt, ...)
     INTER->i_bytessincelastping += msglen;
 }
 
+    /* the same as sys_vgui("%s", s) but without the formatting */
 void sys_gui(const char *s)
 {
-    sys_vgui("%s", s);
+    int msglen = (int)strlen(s);
+    if (!sys_havegui())
+        return;
+    if (!INTER->i_guibuf || msglen >= INTER->i_guisize - INTER->i_guihead)
+    {
+        sys_vgui("%s", s);
+        return;
+    }
+    memcpy(INTER->i_guibuf + INTER->i_guihead, s, msglen + 1);
+    sys_didgui(msglen);
 }
 
-static int sys_flushtogui(void)
+    /* send what we can without waiting.  Returns the number of bytes
+    written, or -1 on error. */
+static int sys_doflushtogui(void)
 {
     int writesize = INTER->i_guihead - INTER->i_guitail,
         nwrote = 0;
+#ifdef GUITHREAD
+    if (INTER->i_guisender)
+        nwrote = guisender_put(INTER->i_guisender,
+            INTER->i_guibuf + INTER->i_guitail, writesize);
+    else
+#endif
     if (writesize > 0)
         nwrote = (int)send(
             INTER->i_guisock,
@@ -882,16 +1319,12 @@ static int sys_flushtogui(void)
         fprintf(stderr, "wrote %d of %d\n", nwrote, writesize);
 #endif
 
-    if (nwrote < 0)
-    {
-        perror("pd-to-gui socket");
-        sys_bail(1);
-    }
-    else if (!nwrote)
-        return (0);
-    else if (nwrote >= INTER->i_guihead - INTER->i_guitail)
+    if (nwrote <= 0)
+        return (nwrote < 0 ? -1 : 0);
+    INTER->i_guinbytes += nwrote;
+    if (nwrote >= INTER->i_guihead - INTER->i_guitail)
         INTER->i_guihead = INTER->i_guitail = 0;
-    else if (nwrote)
+    else
     {
         INTER->i_guitail += nwrote;
         if (INTER->i_guitail > (INTER->i_guisize >> 2))
@@ -903,7 +1336,18 @@ static int sys_flushtogui(void)
             INTER->i_guitail = 0;
         }
     }
-    return (1);
+    return (nwrote);
+}
+
+static int sys_flushtogui(void)
+{
+    int nwrote = sys_doflushtogui();
+    if (nwrote < 0)
+    {
+        perror("pd-to-gui socket");
+        sys_bail(1);
+    }
+    return (nwrote > 0);
 }
 
 void glob_ping(t_pd *dummy)
@@ -911,6 +1355,63 @@ void glob_ping(t_pd *dummy)
     INTER->i_waitingforping = 0;
 }
 
+    /* Objects ask to be redrawn with sys_queuegui(), and are called back
+    when the scheduler is idle.  A client is only in the queue once, so a
+    number box that changes every tick is redrawn once per pass through the
+    queue; a hash table finds it in constant time.  Passes start at most
+    sys_guirate times per second (-guirate flag or "pd guirate" message; 0
+    means as often as possible). */
+
+int sys_guirate = 60;
+
+#define GUIQUEUEHASH(client, size) \
+    ((((unsigned int)((size_t)(client) >> 3) * 2654435761u) >> 12) & \
+        ((size) - 1))
+
+static t_guiqueue **sys_guiqueuefind(void *client)
+{
+    t_guiqueue **gqp;
+    if (!INTER->i_guiqueuehashsize)
+        return (0);
+    for (gqp = &INTER->i_guiqueuehash[GUIQUEUEHASH(client,
+        INTER->i_guiqueuehashsize)]; *gqp; gqp = &(*gqp)->gq_hashnext)
+            if ((*gqp)->gq_client == client)
+                return (gqp);
+    return (0);
+}
+
+    /* take an item off the queue; "gqp" is its place in its hash bucket */
+static void sys_guiqueueremove(t_guiqueue **gqp)
+{
+    t_guiqueue *gq = *gqp;
+    *gqp = gq->gq_hashnext;
+    if (gq->gq_prev)
+        gq->gq_prev->gq_next = gq->gq_next;
+    else INTER->i_guiqueuehead = gq->gq_next;
+    if (gq->gq_next)
+        gq->gq_next->gq_prev = gq->gq_prev;
+    else INTER->i_guiqueuetail = gq->gq_prev;
+    INTER->i_guiqueuen--;
+}
+
+static void sys_guiqueuerehash(int newsize)
+{
+    t_guiqueue **newhash = (t_guiqueue **)getbytes(newsize * sizeof(*newhash)),
+        *gq;
+    unsigned int h;
+    for (gq = INTER->i_guiqueuehead; gq; gq = gq->gq_next)
+    {
+        h = GUIQUEUEHASH(gq->gq_client, newsize);
+        gq->gq_hashnext = newhash[h];
+        newhash[h] = gq;
+    }
+    if (INTER->i_guiqueuehash)
+        freebytes(INTER->i_guiqueuehash,
+            INTER->i_guiqueuehashsize * sizeof(*INTER->i_guiqueuehash));
+    INTER->i_guiqueuehash = newhash;
+    INTER->i_guiqueuehashsize = newsize;
+}
+
 static int sys_flushqueue(void)
 {
     int wherestop = INTER->i_bytessincelastping + GUI_UPDATESLICE;
@@ -919,7 +1420,18 @@ static int sys_flushqueue(void)
     if (INTER->i_waitingforping)
         return (0);
     if (!INTER->i_guiqueuehead)
+    {
+        INTER->i_guidraining = 0;
         return (0);
+    }
+    if (!INTER->i_guidraining)
+    {
+        double now = sys_getrealtime();
+        if (sys_guirate > 0 && now < INTER->i_guinextframe)
+            return (0);
+        INTER->i_guinextframe = now + (sys_guirate > 0 ? 1. / sys_guirate : 0);
+        INTER->i_guidraining = INTER->i_guiqueuen;
+    }
     while (1)
     {
         if (INTER->i_bytessincelastping >= GUI_BYTESPERPING)
@@ -929,12 +1441,14 @@ static int sys_flushqueue(void)
             INTER->i_waitingforping = 1;
             return (1);
         }
-        if (INTER->i_guiqueuehead)
+        if (INTER->i_guiqueuehead && INTER->i_guidraining > 0)
         {
             t_guiqueue *headwas = INTER->i_guiqueuehead;
-            INTER->i_guiqueuehead = headwas->gq_next;
+            sys_guiqueueremove(sys_guiqueuefind(headwas->gq_client));
             (*headwas->gq_fn)(headwas->gq_client, headwas->gq_glist);
             t_freebytes(headwas, sizeof(*headwas));
+            INTER->i_guinupdates++;
+            INTER->i_guidraining--;
             if (INTER->i_bytessincelastping >= wherestop)
                 break;
         }
@@ -951,9 +1465,14 @@ static int sys_poll_togui(void) /* returns 1 if did anything */
         return (0);
         /* in case there is stuff still in the buffer, try to flush it. */
     sys_flushtogui();
-        /* if the flush wasn't complete, wait. */
+        /* if the flush wasn't complete, wait.  Meanwhile redraws stay in
+        the queue, where repeated ones are merged. */
     if (INTER->i_guihead > INTER->i_guitail)
         return (0);
+#ifdef GUITHREAD
+    if (INTER->i_guisender && guisender_busy(INTER->i_guisender))
+        return (0);
+#endif
 
         /* check for queued updates */
     if (sys_flushqueue())
@@ -971,46 +1490,61 @@ void sys_pretendguibytes(int n)
 
 void sys_queuegui(void *client, t_glist *glist, t_guicallbackfn f)
 {
-    t_guiqueue **gqnextptr, *gq;
-    if (!INTER->i_guiqueuehead)
-        gqnextptr = &INTER->i_guiqueuehead;
-    else
+    t_guiqueue *gq;
+    unsigned int h;
+    if (sys_guiqueuefind(client))
     {
-        for (gq = INTER->i_guiqueuehead; gq->gq_next;
-            gq = gq->gq_next)
-                if (gq->gq_client == client)
-                    return;
-        if (gq->gq_client == client)
-            return;
-        gqnextptr = &gq->gq_next;
+        INTER->i_guinmerged++;
+        return;
     }
+    if (INTER->i_guiqueuen >= INTER->i_guiqueuehashsize)
+        sys_guiqueuerehash(INTER->i_guiqueuehashsize ?
+            2 * INTER->i_guiqueuehashsize : 64);
     gq = t_getbytes(sizeof(*gq));
-    gq->gq_next = 0;
     gq->gq_client = client;
     gq->gq_glist = glist;
     gq->gq_fn = f;
     gq->gq_next = 0;
-    *gqnextptr = gq;
+    gq->gq_prev = INTER->i_guiqueuetail;
+    if (INTER->i_guiqueuetail)
+        INTER->i_guiqueuetail->gq_next = gq;
+    else INTER->i_guiqueuehead = gq;
+    INTER->i_guiqueuetail = gq;
+    h = GUIQUEUEHASH(client, INTER->i_guiqueuehashsize);
+    gq->gq_hashnext = INTER->i_guiqueuehash[h];
+    INTER->i_guiqueuehash[h] = gq;
+    INTER->i_guiqueuen++;
 }
 
 void sys_unqueuegui(void *client)
 {
-    t_guiqueue *gq, *gq2;
-    while (INTER->i_guiqueuehead && INTER->i_guiqueuehead->gq_client == client)
+    t_guiqueue **gqp = sys_guiqueuefind(client), *gq;
+    if (gqp)
     {
-        gq = INTER->i_guiqueuehead;
-        INTER->i_guiqueuehead = INTER->i_guiqueuehead->gq_next;
+        gq = *gqp;
+        sys_guiqueueremove(gqp);
         t_freebytes(gq, sizeof(*gq));
     }
-    if (!INTER->i_guiqueuehead)
-        return;
-    for (gq = INTER->i_guiqueuehead; (gq2 = gq->gq_next); gq = gq2)
-        if (gq2->gq_client == client)
-        {
-            gq->gq_next = gq2->gq_next;
-            t_freebytes(gq2, sizeof(*gq2));
-            break;
-        }
+}
+
+    /* "pd guirate": the most times per second to update the GUI.  Since 0
+    means no limit, positive rates below 1 are taken as 1. */
+void glob_guirate(void *dummy, t_float f)
+{
+    sys_guirate = (f > 0 ? (f < 1 ? 1 : f) : 0);
+}
+
+    /* "pd guistats": print how much we've sent to the GUI since last asked */
+void glob_guistats(void *dummy)
+{
+    double now = sys_getrealtime(), elapsed = now - INTER->i_guistattime;
+    if (elapsed > 0)
+        post("GUI: %.0f bytes/sec, %.0f updates/sec (%.0f more merged), "
+            "%d queued", INTER->i_guinbytes / elapsed,
+                INTER->i_guinupdates / elapsed,
+                    INTER->i_guinmerged / elapsed, INTER->i_guiqueuen);
+    INTER->i_guistattime = now;
+    INTER->i_guinbytes = INTER->i_guinupdates = INTER->i_guinmerged = 0;
 }
 
     /* poll for any incoming packets, or for GUI updates to send.  call with
@@ -1034,9 +1568,17 @@ void sys_init_fdpoll(void)
     if (INTER->i_fdpoll)
         return;
     /* create an empty FD poll list */
-    INTER->i_fdpoll = (t_fdpoll *)t_getbytes(0);
+    INTER->i_fdpollsize = 8;
+    INTER->i_fdpoll = (t_fdpoll *)t_getbytes(
+        INTER->i_fdpollsize * sizeof(t_fdpoll));
     INTER->i_nfdpoll = 0;
+    INTER->i_fdindexsize = 64;
+    INTER->i_fdindex = (int *)t_getbytes(INTER->i_fdindexsize * sizeof(int));
+    memset(INTER->i_fdindex, -1, INTER->i_fdindexsize * sizeof(int));
     INTER->i_inbinbuf = binbuf_new();
+#ifdef HAVE_EPOLL
+    sys_init_epoll();
+#endif
 }
 
 /* --------------------- starting up the GUI connection ------------- */
@@ -1410,6 +1952,9 @@ static int sys_do_startgui(const char *libdir)
         INTER->i_guihead = INTER->i_guitail = 0;
     }
 
+#ifdef GUITHREAD
+    guisender_new(INTER->i_guisock);
+#endif
     INTER->i_socketreceiver = socketreceiver_new(0, 0, 0, 0);
     sys_addpollfn(INTER->i_guisock,
         (t_fdpollfn)socketreceiver_read,
@@ -1582,8 +2127,19 @@ void glob_exit(void *dummy, t_float status)
     sys_exit();
     sys_close_audio();
     sys_close_midi();
+        /* send what [netsend] objects are holding, and let the network
+        thread send what it has queued */
+    netsend_flushall();
+    netthread_free();
     if (sys_havegui())
     {
+#ifdef GUITHREAD
+        if (INTER->i_guisender)
+        {
+            sys_drainguibuf(0);
+            guisender_free();
+        }
+#endif
         sys_closesocket(INTER->i_guisock);
         sys_rmpollfn(INTER->i_guisock);
     }
@@ -1641,6 +2197,13 @@ void sys_stopgui(void)
     sys_vgui("%s", "exit\n");
     if (INTER->i_guisock >= 0)
     {
+#ifdef GUITHREAD
+        if (INTER->i_guisender)
+        {
+            sys_drainguibuf(0);
+            guisender_free();
+        }
+#endif
         sys_closesocket(INTER->i_guisock);
         sys_rmpollfn(INTER->i_guisock);
         INTER->i_guisock = -1;
@@ -1669,10 +2232,29 @@ void s_inter_free(t_instanceinter *inter)
     {
         binbuf_free(inter->i_inbinbuf);
         inter->i_inbinbuf = 0;
-        t_freebytes(inter->i_fdpoll, inter->i_nfdpoll * sizeof(t_fdpoll));
+        t_freebytes(inter->i_fdpoll, inter->i_fdpollsize * sizeof(t_fdpoll));
         inter->i_fdpoll = 0;
-        inter->i_nfdpoll = 0;
+        inter->i_nfdpoll = inter->i_fdpollsize = 0;
+        t_freebytes(inter->i_fdindex, inter->i_fdindexsize * sizeof(int));
+        inter->i_fdindex = 0;
+        inter->i_fdindexsize = 0;
+#ifdef HAVE_EPOLL
+        if (inter->i_epollfd >= 0)
+        {
+            close(inter->i_timerfd);
+            close(inter->i_epollfd);
+        }
+#endif
+    }
+    while (inter->i_guiqueuehead)
+    {
+        t_guiqueue *gq = inter->i_guiqueuehead;
+        inter->i_guiqueuehead = gq->gq_next;
+        t_freebytes(gq, sizeof(*gq));
     }
+    if (inter->i_guiqueuehash)
+        freebytes(inter->i_guiqueuehash,
+            inter->i_guiqueuehashsize * sizeof(*inter->i_guiqueuehash));
 #if PDTHREADS
     pthread_mutex_destroy(&INTER->i_mutex);
 #endif
@@ -192,13 +192,13 @@ static void sendatoms(int argc, t_atom*argv, int raw) {
             sys_vgui("%p ", a->a_w.w_gpointer);
             break;
         case A_SEMI:
-            sys_vgui("\\; ");
+            sys_gui("\\; ");
             break;
         case A_COMMA:
             if (raw)
-                sys_vgui(", ");
+                sys_gui(", ");
             else
-                sys_vgui("{,} ");
+                sys_gui("{,} ");
             break;
         }
     }
@@ -222,7 +222,7 @@ static int addmess(const t_val *v)
         sys_vgui("#%06x", v->value.i & 0xFFFFFF);
         break;
     case GUI_VMESS__RAWSTRING:
-        sys_vgui("%s", v->value.p);
+        sys_gui(v->value.p);
         break;
     case GUI_VMESS__STRING:
         sys_vgui("{%s}", str_escape(v->value.p, 0));
@@ -235,13 +235,13 @@ static int addmess(const t_val *v)
         sys_vgui("%p", v->value.p);
         break;
     case GUI_VMESS__MESSAGE:
-        sys_vgui("{");
+        sys_gui("{");
         if (v->string)
             sys_vgui("%s ", v->string);
         else
             ;
         sendatoms(v->size, (t_atom*)v->value.p, 1);
-        sys_vgui("}");
+        sys_gui("}");
         break;
     case GUI_VMESS__WINDOW:
         sys_vgui(".x%lx", v->value.p);
@@ -252,19 +252,19 @@ static int addmess(const t_val *v)
     case GUI_VMESS__CANVASARRAY:
     {
         const t_canvas**data = (const t_canvas**)v->value.p;
-        sys_vgui("{");
+        sys_gui("{");
         for(i=0; i<v->size; i++)
             sys_vgui(".x%lx.c ", data[i]);
-        sys_vgui("}");
+        sys_gui("}");
         break;
     }
     case GUI_VMESS__FLOATARRAY:
     {
         const t_float*data = (const t_float*)v->value.p;
-        sys_vgui("{");
+        sys_gui("{");
         for(i=0; i<v->size; i++)
             sys_vgui("%f ", *data++);
-        sys_vgui("}");
+        sys_gui("}");
         break;
     }
     case GUI_VMESS__FLOATWORDS:
@@ -272,18 +272,18 @@ static int addmess(const t_val *v)
     {
         const t_word*data = (const t_word*)v->value.p;
         if (GUI_VMESS__FLOATWORDARRAY == v->type)
-            sys_vgui("{");
+            sys_gui("{");
         for(i=0; i<v->size; i++)
             sys_vgui("%g ", data[i].w_float);
         if (GUI_VMESS__FLOATWORDARRAY == v->type)
-            sys_vgui("}");
+            sys_gui("}");
         break;
     }
     case GUI_VMESS__RAWSTRINGARRAY:
     case GUI_VMESS__STRINGARRAY:
     {
         const char**data = (const char**)v->value.p;
-        sys_vgui("{");
+        sys_gui("{");
         for(i=0; i<v->size; i++)
         {
             const char*s=data[i];
@@ -292,17 +292,17 @@ static int addmess(const t_val *v)
             else
                 sys_vgui("{%s} ", str_escape(s, 0));
         }
-        sys_vgui("}");
+        sys_gui("}");
         break;
     }
     case GUI_VMESS__ATOMS:
     case GUI_VMESS__ATOMARRAY:
     {
         if (GUI_VMESS__ATOMARRAY == v->type)
-            sys_vgui("{");
+            sys_gui("{");
         sendatoms(v->size, (t_atom*)v->value.p, 0);
         if (GUI_VMESS__ATOMARRAY == v->type)
-            sys_vgui("}");
+            sys_gui("}");
         break;
     }
     default:
@@ -380,7 +380,7 @@ void pdgui_vamess(const char* message, const char* format, va_list args_)
 
     if(message) {
         addmess(&v);
-        sys_vgui("%s", " ");
+        sys_gui(" ");
     }
 
     va_copy(args, args_);
@@ -390,7 +390,7 @@ void pdgui_vamess(const char* message, const char* format, va_list args_)
             continue;
         addmess(&v);
         if(GUI_VMESS__IGNORE != v.type)
-            sys_vgui("%s", " ");
+            sys_gui(" ");
     }
     va_end(args);
 }
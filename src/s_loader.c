@@ -19,6 +19,7 @@
 #endif
 #include <string.h>
 #include "m_pd.h"
+#include "m_imp.h"
 #include "s_stuff.h"
 #include <stdio.h>
 #include <sys/stat.h>
@@ -435,13 +436,398 @@ int sys_run_scheduler(const char *externalschedlibname,
 void canvas_popabstraction(t_canvas *x);
 int pd_setloadingabstraction(t_symbol *sym);
 
+/* ------------------ cache of parsed abstractions ---------------------- */
+
+    /* Without this, each instance of an abstraction reads and parses its
+    file all over again.  We keep the parsed contents of each file, checked
+    against its size and modification time before being reused.  Since that
+    can't catch a file rewritten within the same second, the cache is also
+    cleared whenever Pd saves a patch (see canvas_reload()). */
+
+typedef struct _absfile
+{
+    t_symbol *f_name;           /* file name and directory as found */
+    t_symbol *f_dir;
+    t_binbuf *f_binbuf;         /* contents, converted if from Max */
+    time_t f_mtime;
+    long long f_size;
+    int f_inuse;                /* being evaluated; don't free */
+    struct _absfile *f_next;
+} t_absfile;
+
+struct _abscache
+{
+    t_absfile *c_files;
+    int c_hits;                 /* statistics since startup */
+    int c_misses;
+    double c_readtime;          /* seconds spent reading and parsing */
+    double c_evaltime;          /* seconds spent creating the abstractions */
+    int c_prefetched;           /* files read ahead by sys_abscache_prefetch */
+};
+
+static struct _abscache *abscache_get(void)
+{
+    if (!STUFF->st_abscache)
+    {
+        STUFF->st_abscache = (struct _abscache *)getbytes(
+            sizeof(*STUFF->st_abscache));
+        STUFF->st_abscache->c_files = 0;
+    }
+    return (STUFF->st_abscache);
+}
+
+static void absfile_free(t_absfile *f)
+{
+    binbuf_free(f->f_binbuf);
+    freebytes(f, sizeof(*f));
+}
+
+    /* forget all cached files (except any being evaluated right now) */
+void sys_abscache_clear(void)
+{
+    t_absfile **fp, *f;
+    if (!STUFF->st_abscache)
+        return;
+    for (fp = &STUFF->st_abscache->c_files; (f = *fp); )
+    {
+        if (f->f_inuse)
+            fp = &f->f_next;
+        else
+        {
+            *fp = f->f_next;
+            absfile_free(f);
+        }
+    }
+}
+
+void sys_abscache_free(void)
+{
+    if (!STUFF->st_abscache)
+        return;
+    sys_abscache_clear();
+    freebytes(STUFF->st_abscache, sizeof(*STUFF->st_abscache));
+    STUFF->st_abscache = 0;
+}
+
+    /* "pd abscache": print statistics, or "pd abscache clear" */
+void glob_abscache(void *dummy, t_symbol *s)
+{
+    struct _abscache *c = abscache_get();
+    t_absfile *f;
+    int nfiles = 0, natoms = 0;
+    if (s == gensym("clear"))
+    {
+        sys_abscache_clear();
+        return;
+    }
+    for (f = c->c_files; f; f = f->f_next)
+        nfiles++, natoms += binbuf_getnatom(f->f_binbuf);
+    post("abstraction cache: %d files (%d atoms)", nfiles, natoms);
+    post("... %d loaded from cache, %d read from file", c->c_hits,
+        c->c_misses);
+    post("... %.1f msec reading files, %.1f msec creating abstractions",
+        1000 * c->c_readtime, 1000 * c->c_evaltime);
+    post("... %d read ahead when opening patches", c->c_prefetched);
+}
+
+static t_absfile *abscache_add(struct _abscache *c, t_symbol *name,
+    t_symbol *dir, t_binbuf *b, const struct stat *statbuf)
+{
+    t_absfile *f = (t_absfile *)getbytes(sizeof(*f));
+    f->f_name = name;
+    f->f_dir = dir;
+    f->f_binbuf = b;
+    f->f_mtime = statbuf->st_mtime;
+    f->f_size = statbuf->st_size;
+    f->f_inuse = 0;
+    f->f_next = c->c_files;
+    c->c_files = f;
+    return (f);
+}
+
+    /* evaluate an abstraction file found by canvas_open(), reading it
+    only if we don't already have it. */
+static void abscache_evalfile(t_symbol *name, t_symbol *dir)
+{
+    struct _abscache *c = abscache_get();
+    t_absfile **fp, *f;
+    char path[MAXPDSTRING];
+    struct stat statbuf;
+    double starttime = sys_getrealtime();
+    t_binbuf *b;
+
+    snprintf(path, MAXPDSTRING, "%s/%s", dir->s_name, name->s_name);
+    path[MAXPDSTRING-1] = 0;
+    if (stat(path, &statbuf) < 0)
+    {
+            /* let binbuf_evalfile() report the error */
+        binbuf_evalfile(name, dir);
+        return;
+    }
+    for (fp = &c->c_files; (f = *fp); fp = &f->f_next)
+        if (f->f_name == name && f->f_dir == dir)
+            break;
+    if (f && (f->f_mtime != statbuf.st_mtime ||
+        f->f_size != (long long)statbuf.st_size) && !f->f_inuse)
+    {
+            /* the file has changed since we read it */
+        *fp = f->f_next;
+        absfile_free(f);
+        f = 0;
+    }
+    if (f)
+        c->c_hits++;
+    else
+    {
+        if (!(b = binbuf_readpatch(name, dir)))
+            return;
+        f = abscache_add(c, name, dir, b, &statbuf);
+        c->c_misses++;
+        c->c_readtime += sys_getrealtime() - starttime;
+        starttime = sys_getrealtime();
+    }
+        /* the cache might get cleared while we're evaluating (if a
+        loadbang saves a patch, say) so protect this one from being freed. */
+    f->f_inuse++;
+    binbuf_evalpatch(f->f_binbuf, name, dir);
+    f->f_inuse--;
+    c->c_evaltime += sys_getrealtime() - starttime;
+}
+
+/* ------------------ reading abstractions ahead ---------------------- */
+
+    /* When a patch is opened we look through it for objects that might be
+    abstractions, find their files, and read and parse them on several
+    threads at once into the cache above; then the same for any abstractions
+    those use, and so on.  The objects are still created afterward, on the
+    main thread, but then only have to be taken from the cache.  The search
+    here only uses the patch's directory and the global search path, not
+    paths from [declare]; anything missed is just loaded as usual. */
+
+#if PDTHREADS
+#include <pthread.h>
+
+#define PREFETCHMAXTHREADS 8
+
+typedef struct _prefetch
+{
+    t_symbol *p_name;           /* file name and directory as found */
+    t_symbol *p_dir;
+    t_binbuf *p_binbuf;         /* contents, or 0 if reading failed */
+    struct stat p_stat;
+} t_prefetch;
+
+typedef struct _prefetcher
+{
+    t_prefetch *r_files;        /* files to read */
+    int r_nfiles;
+    int r_next;                 /* next one for a thread to take */
+    t_symbol **r_looked;        /* pairs of names and directories already */
+    int r_nlooked;              /* looked for */
+    pthread_mutex_t r_mutex;
+    t_pdinstance *r_instance;
+} t_prefetcher;
+
+    /* look for an abstraction named "s" as the patch in "dir" would; add
+    it to the list if we find it and haven't already got it */
+static void prefetch_lookfor(t_prefetcher *r, t_symbol *s, t_symbol *dir)
+{
+    char dirbuf[MAXPDSTRING], classslashclass[MAXPDSTRING], *nameptr;
+    t_symbol *name;
+    t_absfile *f;
+    t_prefetch *p;
+    int fd, i;
+    if (!*s->s_name || zgetfn(&pd_objectmaker, s))
+        return;     /* empty or already a class */
+    for (i = 0; i < r->r_nlooked; i += 2)
+        if (r->r_looked[i] == s && r->r_looked[i+1] == dir)
+            return;
+    r->r_looked = (t_symbol **)resizebytes(r->r_looked,
+        r->r_nlooked * sizeof(*r->r_looked),
+            (r->r_nlooked + 2) * sizeof(*r->r_looked));
+    r->r_looked[r->r_nlooked++] = s;
+    r->r_looked[r->r_nlooked++] = dir;
+    snprintf(classslashclass, MAXPDSTRING, "%s/%s", s->s_name, s->s_name);
+    if ((fd = open_via_path(dir->s_name, s->s_name, ".pd",
+            dirbuf, &nameptr, MAXPDSTRING, 0)) < 0 &&
+        (fd = open_via_path(dir->s_name, classslashclass, ".pd",
+            dirbuf, &nameptr, MAXPDSTRING, 0)) < 0)
+                return;
+    sys_close(fd);
+    name = gensym(nameptr);
+    dir = gensym(dirbuf);
+    for (f = abscache_get()->c_files; f; f = f->f_next)
+        if (f->f_name == name && f->f_dir == dir)
+            return;
+    for (i = 0; i < r->r_nfiles; i++)
+        if (r->r_files[i].p_name == name && r->r_files[i].p_dir == dir)
+            return;
+    r->r_files = (t_prefetch *)resizebytes(r->r_files,
+        r->r_nfiles * sizeof(*r->r_files),
+            (r->r_nfiles + 1) * sizeof(*r->r_files));
+    p = &r->r_files[r->r_nfiles++];
+    p->p_name = name;
+    p->p_dir = dir;
+    p->p_binbuf = 0;
+}
+
+    /* find "#X obj" messages in a patch and look for their classes.  For
+    [clone] it's the first argument that isn't a flag. */
+static void prefetch_scan(t_prefetcher *r, const t_binbuf *b, t_symbol *dir)
+{
+    int n = binbuf_getnatom(b), i, j;
+    const t_atom *vec = binbuf_getvec(b);
+    t_symbol *s_obj = gensym("obj"), *s_clone = gensym("clone");
+    for (i = 0; i < n; i++)
+    {
+        if (!(i == 0 || vec[i-1].a_type == A_SEMI) ||
+            vec[i].a_type != A_SYMBOL || vec[i].a_w.w_symbol != &s__X ||
+            i + 4 >= n || vec[i+1].a_type != A_SYMBOL ||
+            vec[i+1].a_w.w_symbol != s_obj || vec[i+4].a_type != A_SYMBOL)
+                continue;
+        if (vec[i+4].a_w.w_symbol == s_clone)
+        {
+            for (j = i + 5; j < n && vec[j].a_type != A_SEMI; j++)
+                if (vec[j].a_type == A_SYMBOL &&
+                    vec[j].a_w.w_symbol->s_name[0] != '-')
+            {
+                prefetch_lookfor(r, vec[j].a_w.w_symbol, dir);
+                break;
+            }
+        }
+        else prefetch_lookfor(r, vec[i+4].a_w.w_symbol, dir);
+    }
+}
+
+    /* read a file on a worker thread.  We don't use binbuf_read() since it
+    may post errors, which isn't safe here; if anything goes wrong we leave
+    p_binbuf zero and the file gets read (and complained about) as usual. */
+static void prefetch_read(t_prefetch *p)
+{
+    char path[MAXPDSTRING], *buf;
+    long length;
+    int fd;
+    snprintf(path, MAXPDSTRING, "%s/%s", p->p_dir->s_name, p->p_name->s_name);
+    path[MAXPDSTRING-1] = 0;
+    if (stat(path, &p->p_stat) < 0 || (length = (long)p->p_stat.st_size) <= 0)
+        return;
+    if ((fd = sys_open(path, 0)) < 0)
+        return;
+    buf = (char *)getbytes(length);
+    if (read(fd, buf, length) == length)
+    {
+        p->p_binbuf = binbuf_new();
+        if (!binbuf_isbinary(buf, length))
+            binbuf_text(p->p_binbuf, buf, length);
+        else if (binbuf_setbinary(p->p_binbuf, buf, length))
+        {
+            binbuf_free(p->p_binbuf);
+            p->p_binbuf = 0;
+        }
+    }
+    freebytes(buf, length);
+    close(fd);
+}
+
+static void *prefetch_thread(void *z)
+{
+    t_prefetcher *r = (t_prefetcher *)z;
+    int i;
+#ifdef PDINSTANCE
+    pd_setinstance(r->r_instance);
+#endif
+    while (1)
+    {
+        pthread_mutex_lock(&r->r_mutex);
+        i = r->r_next++;
+        pthread_mutex_unlock(&r->r_mutex);
+        if (i >= r->r_nfiles)
+            break;
+        prefetch_read(&r->r_files[i]);
+    }
+    return (0);
+}
+
+static int prefetch_nthreads(void)
+{
+    int n = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n < 1 ? 1 : (n > PREFETCHMAXTHREADS ? PREFETCHMAXTHREADS : n));
+}
+
+    /* read ahead the abstractions a patch, read from "dir", will need.
+    Returns the number of files read and the number of passes (each level
+    of nesting needs another) and threads used. */
+int sys_abscache_prefetch(const t_binbuf *b, t_symbol *dir, int *npassp,
+    int *nthreadp)
+{
+    t_prefetcher r;
+    struct _abscache *c = abscache_get();
+    int nthreads = prefetch_nthreads(), npass = 0, start = 0, nread = 0, i;
+    r.r_files = (t_prefetch *)getbytes(0);
+    r.r_nfiles = 0;
+    r.r_looked = (t_symbol **)getbytes(0);
+    r.r_nlooked = 0;
+    r.r_instance = pd_this;
+    pthread_mutex_init(&r.r_mutex, 0);
+    prefetch_scan(&r, b, dir);
+    while (start < r.r_nfiles)
+    {
+        int end = r.r_nfiles, nt = end - start;
+        pthread_t threads[PREFETCHMAXTHREADS];
+        if (nt > nthreads)
+            nt = nthreads;
+        r.r_next = start;
+        if (nt > 1)
+        {
+            pd_lockgensym(1);
+            for (i = 0; i < nt; i++)
+                if (pthread_create(&threads[i], 0, prefetch_thread, &r))
+                    break;
+            nt = i;
+        }
+            /* the main thread works too, and does it all if there aren't
+            other threads */
+        prefetch_thread(&r);
+        for (i = 0; i < nt; i++)
+            pthread_join(threads[i], 0);
+        pd_lockgensym(0);
+        for (i = start; i < end; i++)
+        {
+            t_prefetch *p = &r.r_files[i];
+            if (!p->p_binbuf)
+                continue;
+            abscache_add(c, p->p_name, p->p_dir, p->p_binbuf, &p->p_stat);
+            nread++;
+            prefetch_scan(&r, p->p_binbuf, p->p_dir);
+        }
+        start = end;
+        npass++;
+    }
+    pthread_mutex_destroy(&r.r_mutex);
+    freebytes(r.r_files, r.r_nfiles * sizeof(*r.r_files));
+    freebytes(r.r_looked, r.r_nlooked * sizeof(*r.r_looked));
+    c->c_prefetched += nread;
+    *npassp = npass;
+    *nthreadp = nthreads;
+    return (nread);
+}
+
+#else /* PDTHREADS */
+
+int sys_abscache_prefetch(const t_binbuf *b, t_symbol *dir, int *npassp,
+    int *nthreadp)
+{
+    *npassp = *nthreadp = 0;
+    return (0);
+}
+
+#endif /* PDTHREADS */
+
 static t_pd *do_create_abstraction(t_symbol*s, int argc, t_atom *argv)
 {
-    /*
-     * TODO: check if the there is a binbuf cached for <canvas::symbol>
-        and use that instead.  We'll have to invalidate the cache once we
-        are done (either with a clock_delay(0) or something else)
-     */
     if (!pd_setloadingabstraction(s))
     {
         const char *objectname = s->s_name;
@@ -462,7 +848,7 @@ static t_pd *do_create_abstraction(t_symbol*s, int argc, t_atom *argv)
             close(fd);
             canvas_setargs(argc, argv);
 
-            binbuf_evalfile(gensym(nameptr), gensym(dirbuf));
+            abscache_evalfile(gensym(nameptr), gensym(dirbuf));
             if (s__X.s_thing && was != s__X.s_thing)
                 canvas_popabstraction((t_canvas *)(s__X.s_thing));
             else s__X.s_thing = was;
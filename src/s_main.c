@@ -57,6 +57,13 @@ int sys_hipriority = -1;    /* -1 = not specified; 0 = no; 1 = yes */
 int sys_guisetportnumber;   /* if started from the GUI, this is the port # */
 int sys_nosleep = 0;  /* skip all "sleep" calls and spin instead */
 int sys_defeatrt;       /* flag to cancel real-time */
+int sys_fastmath;       /* use fast approximations in DSP math (d_fastmath.h) */
+int sys_loadtrace;      /* print how long it takes to open each patch */
+int sys_rtaudit;        /* report memory allocation in perform routines */
+int sys_rtpoolsize;     /* kilobytes preallocated for getrtbytes() */
+int sys_nonetthread;    /* netsend/netreceive do I/O in the scheduler thread */
+int sys_noguithread;    /* write to the GUI socket from the scheduler thread */
+int sys_headless;       /* no GUI, and a scheduler that batches DSP ticks */
 t_symbol *sys_flags;    /* more command-line flags */
 
 const char *sys_guicmd;
@@ -514,6 +521,14 @@ static char *(usagemessage[]) = {
 "-autopatch       -- enable auto-patching to new objects (true by default)\n",
 "-noautopatch     -- defeat auto-patching\n",
 "-compatibility <f> -- set back-compatibility to version <f>\n",
+"-fastmath        -- use faster, approximate math in signal objects\n",
+"-loadtrace       -- print the time taken by each stage of opening patches\n",
+"-rtaudit         -- report memory allocation in signal perform routines\n",
+"-rtpool <n>      -- preallocate n kilobytes for perform-time allocation\n",
+"-nonetthread     -- do netsend/netreceive I/O in the scheduler thread\n",
+"-noguithread     -- write to the GUI from the scheduler thread\n",
+"-headless        -- no GUI; run DSP ticks in batches between polls for input\n",
+"-guirate <n>     -- redraw GUI objects at most n times a second (0: no limit)\n",
 };
 
 static void sys_printusage(void)
@@ -1329,6 +1344,48 @@ int sys_argparse(int argc, const char **argv)
             argc--; argv++;
         }
 #endif
+        else if (!strcmp(*argv, "-fastmath"))
+        {
+            sys_fastmath = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-loadtrace"))
+        {
+            sys_loadtrace = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-rtaudit"))
+        {
+            sys_rtaudit = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-rtpool") && argc > 1)
+        {
+            sys_rtpoolsize = atoi(argv[1]);
+            argc -= 2; argv += 2;
+        }
+        else if (!strcmp(*argv, "-nonetthread"))
+        {
+            sys_nonetthread = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-noguithread"))
+        {
+            sys_noguithread = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-headless"))
+        {
+            sys_headless = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-guirate") && argc > 1)
+        {
+            sys_guirate = atoi(argv[1]);
+            if (sys_guirate < 0)
+                sys_guirate = 0;
+            argc -= 2; argv += 2;
+        }
         else if (!strcmp(*argv, "-sleep"))
         {
             sys_nosleep = 0;
@@ -1350,7 +1407,7 @@ int sys_argparse(int argc, const char **argv)
             return (1);
         }
     }
-    if (sys_batch)
+    if (sys_batch || sys_headless)
         sys_dontstartgui = 1;
     if (sys_dontstartgui)
         sys_printtostderr = 1;
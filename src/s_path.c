@@ -38,6 +38,13 @@
 #include "s_utf8.h"
 #include <stdio.h>
 #include <fcntl.h>
+#include <time.h>
+
+    /* see "directory cache" below */
+#if defined(HAVE_UNISTD_H) && !defined(__APPLE__) && !defined(_WIN32)
+#define PATHCACHE
+#include <dirent.h>
+#endif
 
 #ifdef _LARGEFILE64_SOURCE
 # define open  open64
@@ -265,6 +272,206 @@ void sys_setextrapath(const char *p)
     STUFF->st_staticpath = namelist_append(STUFF->st_staticpath, p, 0);
 }
 
+/********************* directory cache for path searches ******************/
+
+    /* Loading a patch probes every directory on the search path for each
+    object name Pd doesn't know, with several extensions each, and nearly
+    all of these opens fail.  To save the system calls we keep a listing of
+    each directory we look in and only try to open files that appear in it.
+    A listing is checked against the directory's modification time at most
+    once a second, so a file added from outside Pd can take up to a second
+    to be found; files created through sys_open() or sys_fopen() clear the
+    cache.
+    Listings made in the same second the directory changed might miss a
+    file, so those aren't trusted until they're made again.
+    This is only done where file names are compared byte for byte: not on
+    Windows or macOS, whose file systems ignore case and (on macOS) Unicode
+    normalization. */
+
+#ifdef PATHCACHE
+
+#define PATHCACHE_NHASH 256     /* size of hash table of directories */
+#define PATHCACHE_RECHECK 1.    /* seconds between checks of a directory */
+
+typedef struct _pathdir
+{
+    char *d_path;
+    char **d_names;         /* hash table of the files in it */
+    int d_hashsize;         /* size of table, a power of two */
+    int d_nnames;
+    int d_exists;
+    int d_racy;             /* listed too soon after a change to trust */
+    time_t d_mtime;
+    double d_checktime;     /* sys_getrealtime() when last checked */
+    struct _pathdir *d_next;
+} t_pathdir;
+
+struct _pathcache
+{
+    t_pathdir *c_dirs[PATHCACHE_NHASH];
+};
+
+static unsigned int pathcache_hash(const char *s)
+{
+    unsigned int h = 5381;
+    while (*s)
+        h = h * 33 + (unsigned char)*s++;
+    return (h);
+}
+
+static void pathdir_freenames(t_pathdir *d)
+{
+    int i;
+    for (i = 0; i < d->d_hashsize; i++)
+        if (d->d_names[i])
+            freebytes(d->d_names[i], strlen(d->d_names[i]) + 1);
+    freebytes(d->d_names, d->d_hashsize * sizeof(*d->d_names));
+    d->d_names = 0;
+    d->d_hashsize = d->d_nnames = 0;
+}
+
+static void pathdir_addname(t_pathdir *d, const char *name)
+{
+    int i;
+    if (2 * (d->d_nnames + 1) > d->d_hashsize)
+    {
+        char **oldnames = d->d_names;
+        int oldsize = d->d_hashsize, newsize = (oldsize ? 2 * oldsize : 16);
+        d->d_names = (char **)getbytes(newsize * sizeof(*d->d_names));
+        d->d_hashsize = newsize;
+        for (i = 0; i < oldsize; i++)
+        {
+            if (oldnames[i])
+            {
+                int j = pathcache_hash(oldnames[i]) & (newsize - 1);
+                while (d->d_names[j])
+                    j = (j + 1) & (newsize - 1);
+                d->d_names[j] = oldnames[i];
+            }
+        }
+        freebytes(oldnames, oldsize * sizeof(*oldnames));
+    }
+    i = pathcache_hash(name) & (d->d_hashsize - 1);
+    while (d->d_names[i])
+        i = (i + 1) & (d->d_hashsize - 1);
+    d->d_names[i] = (char *)getbytes(strlen(name) + 1);
+    strcpy(d->d_names[i], name);
+    d->d_nnames++;
+}
+
+static int pathdir_hasname(t_pathdir *d, const char *name)
+{
+    int i;
+    if (!d->d_hashsize)
+        return (0);
+    for (i = pathcache_hash(name) & (d->d_hashsize - 1); d->d_names[i];
+        i = (i + 1) & (d->d_hashsize - 1))
+            if (!strcmp(d->d_names[i], name))
+                return (1);
+    return (0);
+}
+
+static void pathdir_list(t_pathdir *d)
+{
+    struct stat statbuf;
+    DIR *dir;
+    struct dirent *ent;
+    if (d->d_hashsize)
+        pathdir_freenames(d);
+    d->d_exists = (stat(d->d_path, &statbuf) >= 0 &&
+        S_ISDIR(statbuf.st_mode) && (dir = opendir(d->d_path)));
+    d->d_checktime = sys_getrealtime();
+    if (!d->d_exists)
+    {
+        d->d_racy = 0;
+        return;
+    }
+    d->d_mtime = statbuf.st_mtime;
+    d->d_racy = (d->d_mtime >= time(0) - 1);
+    while ((ent = readdir(dir)))
+        if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, ".."))
+            pathdir_addname(d, ent->d_name);
+    closedir(dir);
+}
+
+    /* return 0 if the file "name" is known not to be in directory "dir" */
+static int pathcache_mayexist(const char *dir, const char *name)
+{
+    t_pathdir *d, **bucket;
+    if (!STUFF->st_pathcache)
+        STUFF->st_pathcache = (struct _pathcache *)getbytes(
+            sizeof(*STUFF->st_pathcache));
+    bucket = STUFF->st_pathcache->c_dirs +
+        (pathcache_hash(dir) & (PATHCACHE_NHASH - 1));
+    for (d = *bucket; d; d = d->d_next)
+        if (!strcmp(d->d_path, dir))
+            break;
+    if (!d)
+    {
+        d = (t_pathdir *)getbytes(sizeof(*d));
+        d->d_path = (char *)getbytes(strlen(dir) + 1);
+        strcpy(d->d_path, dir);
+        d->d_next = *bucket;
+        *bucket = d;
+        pathdir_list(d);
+    }
+    else if (sys_getrealtime() - d->d_checktime >= PATHCACHE_RECHECK)
+    {
+        struct stat statbuf;
+        int exists = (stat(d->d_path, &statbuf) >= 0);
+        if (d->d_racy || exists != d->d_exists ||
+            (exists && statbuf.st_mtime != d->d_mtime))
+                pathdir_list(d);
+        else d->d_checktime = sys_getrealtime();
+    }
+    if (d->d_racy)
+        return (1);
+    return (d->d_exists && pathdir_hasname(d, name));
+}
+
+void sys_pathcache_clear(void)
+{
+    int i;
+    t_pathdir *d;
+    if (!STUFF->st_pathcache)
+        return;
+    for (i = 0; i < PATHCACHE_NHASH; i++)
+    {
+        while ((d = STUFF->st_pathcache->c_dirs[i]))
+        {
+            STUFF->st_pathcache->c_dirs[i] = d->d_next;
+            if (d->d_hashsize)
+                pathdir_freenames(d);
+            freebytes(d->d_path, strlen(d->d_path) + 1);
+            freebytes(d, sizeof(*d));
+        }
+    }
+    freebytes(STUFF->st_pathcache, sizeof(*STUFF->st_pathcache));
+    STUFF->st_pathcache = 0;
+}
+
+    /* check the full path of a file we're about to try opening */
+static int pathcache_check(const char *path)
+{
+    char dirbuf[MAXPDSTRING];
+    const char *slash = strrchr(path, '/');
+    if (!slash || slash == path || slash - path >= MAXPDSTRING)
+        return (1);
+    strncpy(dirbuf, path, slash - path);
+    dirbuf[slash - path] = 0;
+    return (pathcache_mayexist(dirbuf, slash + 1));
+}
+
+#else /* PATHCACHE */
+
+void sys_pathcache_clear(void)
+{
+}
+
+#define pathcache_check(path) 1
+
+#endif /* PATHCACHE */
+
     /* try to open a file in the directory "dir", named "name""ext",
     for reading.  "Name" may have slashes.  The directory is copied to
     "dirresult" which must be at least "size" bytes.  "nameresult" is set
@@ -288,7 +495,7 @@ int sys_trytoopenone(const char *dir, const char *name, const char* ext,
 
     DEBUG(post("looking for %s",dirresult));
         /* see if we can open the file for reading */
-    if ((fd=sys_open(dirresult, O_RDONLY)) >= 0)
+    if (pathcache_check(dirresult) && (fd=sys_open(dirresult, O_RDONLY)) >= 0)
     {
             /* in unix, further check that it's not a directory */
 #ifdef HAVE_UNISTD_H
@@ -463,6 +670,8 @@ int sys_open(const char *path, int oflag, ...)
         mode = (mode_t)imode;
         va_end(ap);
         fd = open(pathbuf, oflag, mode);
+            /* we might have created a file; make sure it can be found */
+        sys_pathcache_clear();
     }
     else
         fd = open(pathbuf, oflag);
@@ -473,6 +682,8 @@ FILE *sys_fopen(const char *filename, const char *mode)
 {
   char namebuf[MAXPDSTRING];
   sys_bashfilename(filename, namebuf);
+  if (*mode != 'r')
+      sys_pathcache_clear();    /* as in sys_open() above */
   return fopen(namebuf, mode);
 }
 #endif /* _WIN32 */
@@ -27,6 +27,7 @@ int sys_open_absolute(const char *name, const char* ext,
 int sys_trytoopenone(const char *dir, const char *name, const char* ext,
     char *dirresult, char **nameresult, unsigned int size, int bin);
 t_symbol *sys_decodedialog(t_symbol *s);
+void sys_pathcache_clear(void);
 
 /* s_file.c */
 
@@ -39,6 +40,13 @@ extern t_symbol *sys_flags;
 extern int sys_debuglevel;
 extern int sys_verbose;
 extern int sys_noloadbang;
+extern int sys_fastmath;      /* use approximate math in signal objects */
+extern int sys_loadtrace;     /* print timing when opening patches */
+extern int sys_rtaudit;       /* report allocation in perform routines */
+extern int sys_rtpoolsize;    /* kilobytes for getrtbytes() */
+extern int sys_nonetthread;   /* do network I/O in the scheduler thread */
+extern int sys_noguithread;   /* write to the GUI socket in the scheduler */
+extern int sys_headless;      /* no GUI; run DSP ticks in batches */
 EXTERN int sys_havegui(void);
 extern const char *sys_guicmd;
 
@@ -47,11 +55,26 @@ EXTERN int sys_nearestfontsize(int fontsize);
 extern int sys_defaultfont;
 EXTERN t_symbol *sys_libdir;    /* library directory for auxiliary files */
 
+/* m_memory.c */
+void rtaudit_enter(t_class *c);
+void rtaudit_leave(void);
+void rtpool_setup(void);
+void rtpool_free(void);
+
+/* x_net.c */
+void netthread_free(void);
+void osctrie_free(void);
+void netsend_flushall(void);
+
 /* s_loader.c */
 
 typedef int (*loader_t)(t_canvas *canvas, const char *classname, const char*path); /* callback type */
 EXTERN int sys_load_lib(t_canvas *canvas, const char *classname);
 EXTERN void sys_register_loader(loader_t loader);
+EXTERN void sys_abscache_clear(void);
+EXTERN void sys_abscache_free(void);
+EXTERN int sys_abscache_prefetch(const t_binbuf *b, t_symbol *dir,
+    int *npassp, int *nthreadp);
 
                         /* s_audio.c */
 
@@ -319,6 +342,7 @@ EXTERN void sys_init_fdpoll(void);
 
 EXTERN void sys_bail(int exitcode);
 EXTERN int sys_pollgui(void);
+extern int sys_guirate;       /* most GUI update passes per second */
 
 EXTERN_STRUCT _socketreceiver;
 #define t_socketreceiver struct _socketreceiver
@@ -333,6 +357,9 @@ EXTERN t_socketreceiver *socketreceiver_new(void *owner,
 EXTERN void socketreceiver_read(t_socketreceiver *x, int fd);
 EXTERN void socketreceiver_set_fromaddrfn(t_socketreceiver *x,
     t_socketfromaddrfn fromaddrfn);
+EXTERN char *socketreceiver_findsemi(char *s, char *e);
+EXTERN void socketreceiver_set_netmessages(t_socketreceiver *x,
+    int netmessages);
 EXTERN void sys_sockerror(const char *s);
 EXTERN void sys_closesocket(int fd);
 EXTERN unsigned char *sys_getrecvbuf(unsigned int *size);
@@ -409,6 +436,13 @@ struct _instancestuff
     double st_time_per_dsp_tick;    /* obsolete - included for GEM?? */
     t_printhook st_printhook;   /* set this to override per-instance printing */
     void *st_impdata; /* optional implementation-specific data for libpd, etc */
+    struct _abscache *st_abscache;  /* parsed abstractions (s_loader.c) */
+    struct _pathcache *st_pathcache;    /* directory listings (s_path.c) */
+    struct _rtpool *st_rtpool;  /* memory for getrtbytes() (m_memory.c) */
+    struct _netthread *st_netthread;    /* network I/O thread (x_net.c) */
+    unsigned int st_oscbindgen; /* counts new bindings of "/..." names */
+    struct _osctrie *st_osctrie;    /* bound OSC addresses (x_net.c) */
+    struct _netsend *st_netpending; /* objects holding output (x_net.c) */
 };
 
 #define STUFF (pd_this->pd_stuff)
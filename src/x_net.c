@@ -4,79 +4,1709 @@
 
 /* network */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     /* for sendmmsg() and recvmmsg() */
+#endif
+
 #include "m_pd.h"
+#include "m_imp.h"
 #include "s_stuff.h"
 #include "s_net.h"
 
-#include <string.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+#if PDTHREADS && !defined(_WIN32) && defined(__GNUC__)
+#define NETTHREAD
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#endif
+
+#ifdef _WIN32
+# include <malloc.h> /* MSVC or mingw on windows */
+#elif defined(__linux__) || defined(__APPLE__) || defined(HAVE_ALLOCA_H)
+# include <alloca.h> /* linux, mac, mingw, cygwin */
+#endif
+
+/* print addrinfo lists for debugging */
+/* #define PRINT_ADDRINFO */
+
+/* ----------------------------- helpers ------------------------- */
+
+void socketreceiver_free(t_socketreceiver *x);
+
+static void outlet_sockaddr(t_outlet *o, const struct sockaddr *sa)
+{
+    char addrstr[INET6_ADDRSTRLEN];
+    unsigned short port = sockaddr_get_port(sa);
+    if (sockaddr_get_addrstr(sa, addrstr, INET6_ADDRSTRLEN))
+    {
+        t_atom ap[2];
+        SETSYMBOL(&ap[0], gensym(addrstr));
+        SETFLOAT(&ap[1], (t_float)port);
+        outlet_list(o, NULL, 2, ap);
+    }
+}
+
+/* ----------------------- network thread ------------------------- */
+
+/* With threads, [netsend] and [netreceive] hand their sockets to a network
+thread that does the reading and writing.  The scheduler formats outgoing
+messages and queues them; the thread writes them without blocking, holding
+whatever the socket won't take yet, and splits incoming data into complete
+FUDI messages (or packets, in binary mode) which it queues back.  So a slow
+peer or a burst of traffic never makes the scheduler wait on a socket.
+
+The messages are tokenized by binbuf_text() when they reach the scheduler,
+since gensym() isn't safe to call from another thread.  Listening TCP sockets
+stay with the scheduler too; accepting is rare and creates objects' state.
+
+The queues are lock-free linked lists, one in each direction, with a pipe to
+wake the consumer up.  A connection is freed only after the thread has
+acknowledged closing it, so that anything still queued can refer to it. */
+
+#ifdef NETTHREAD
+
+#define NET_ADD     1   /* scheduler to thread: start polling connection */
+#define NET_SEND    2   /* ... send data */
+#define NET_CLOSE   3   /* ... close connection (sent exactly once) */
+#define NET_QUIT    4   /* ... flush everything and exit */
+#define NET_DATA    5   /* thread to scheduler: a message or packet arrived */
+#define NET_ERROR   6   /* ... an error (err = 0 for other trouble) */
+#define NET_EOF     7   /* ... connection lost, by error or end of file */
+#define NET_FREED   8   /* ... connection closed; scheduler may free it */
+
+#define NETBATCH 16             /* packets per recvmmsg() and sendmmsg() */
+#define NETMAXDISPATCH 256      /* items handled per scheduler poll */
+#define NETMAXINBUF (1<<20)     /* longest message we'll buffer */
+#define NETMAXOUTBUF (1<<24)    /* most output we'll hold for a socket */
+#define NETCLOSEWAIT 5.         /* seconds to finish sending after a close */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct _netconn;
+
+typedef void (*t_netdatafn)(void *owner, struct _netconn *c,
+    const char *buf, int size, const struct sockaddr_storage *from);
+typedef void (*t_neterrorfn)(void *owner, struct _netconn *c,
+    int err, const char *what, int dead);
+
+typedef struct _netconn
+{
+    int c_fd;
+    int c_udp;
+    int c_framing;          /* how to split input into messages (below) */
+    int c_wantfrom;         /* report sender address for UDP packets */
+    struct sockaddr_storage c_addr; /* UDP destination or TCP peer */
+        /* used only by the scheduler: */
+    void *c_owner;          /* zero once we've asked to close */
+    t_netdatafn c_datafn;
+    t_neterrorfn c_errorfn;
+        /* used only by the network thread: */
+    int c_polled;           /* in the poll set */
+    int c_pollout;          /* ... and waiting to be writable */
+    int c_dirty;            /* has output to flush */
+    int c_closing;          /* closed, but still sending what was left */
+    double c_closetime;     /* ... until this time at the latest */
+    char *c_inbuf;
+    int c_inonset, c_inn, c_insize, c_inscan;
+    char *c_outbuf;
+    int c_outonset, c_outn, c_outsize;
+    struct _netconn *c_next;        /* list of open connections */
+    struct _netconn *c_nextdirty;
+#ifndef __linux__
+    int c_pollindex;
+#endif
+} t_netconn;
+
+#define NETFRAME_NONE 0     /* raw bytes ("-b") */
+#define NETFRAME_FUDI 1     /* text messages ending in semicolons */
+#define NETFRAME_BINARY 2   /* binary messages ("-t"), see m_binbuf.c */
+
+typedef struct _netitem
+{
+    struct _netitem *i_next;
+    int i_type;
+    t_netconn *i_conn;
+    int i_err;
+    const char *i_what;
+    struct sockaddr_storage *i_from;
+    char *i_data;
+    int i_size;
+    int i_allocsize;
+} t_netitem;
+
+typedef struct _netqueue
+{
+    t_netitem *q_head;      /* consumer's end */
+    t_netitem *q_tail;      /* producers' end */
+    t_netitem q_stub;
+    int q_pending;          /* a wakeup is already in the pipe */
+    int q_pipe[2];
+} t_netqueue;
+
+typedef struct _netthread
+{
+    pthread_t n_thread;
+    t_netqueue n_cmd;       /* scheduler to network thread */
+    t_netqueue n_result;    /* network thread to scheduler */
+    t_binbuf *n_binbuf;     /* for parsing incoming messages */
+        /* used only by the network thread: */
+    int n_quit;
+    int n_pushed;           /* have queued results since waking up */
+    t_netconn *n_conns;
+    t_netconn *n_dirty;
+    int n_nclosing;         /* connections with c_closing set */
+    char *n_recvbuf;        /* NETBATCH packets */
+#ifdef __linux__
+    int n_epollfd;
+#else
+    struct pollfd *n_pollfds;   /* first one is the command pipe */
+    t_netconn **n_pollconns;
+    int n_npoll;
+    int n_pollsize;
+#endif
+} t_netthread;
+
+static t_netitem *netitem_new(int type, t_netconn *c, int size, int from)
+{
+    int allocsize = sizeof(t_netitem) +
+        (from ? sizeof(struct sockaddr_storage) : 0) + size;
+    t_netitem *y = (t_netitem *)getbytes(allocsize);
+    y->i_type = type;
+    y->i_conn = c;
+    y->i_from = (from ? (struct sockaddr_storage *)(y + 1) : 0);
+    y->i_data = (char *)(y + 1) + (from ? sizeof(struct sockaddr_storage) : 0);
+    y->i_size = size;
+    y->i_allocsize = allocsize;
+    return (y);
+}
+
+static void netitem_free(t_netitem *y)
+{
+    freebytes(y, y->i_allocsize);
+}
+
+static int netqueue_init(t_netqueue *q)
+{
+    q->q_head = q->q_tail = &q->q_stub;
+    q->q_stub.i_next = 0;
+    q->q_pending = 0;
+    if (pipe(q->q_pipe) < 0)
+        return (-1);
+    fcntl(q->q_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(q->q_pipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(q->q_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(q->q_pipe[1], F_SETFD, FD_CLOEXEC);
+    return (0);
+}
+
+    /* this and the following are D. Vyukov's intrusive queue. */
+static void netqueue_push(t_netqueue *q, t_netitem *y)
+{
+    t_netitem *prev;
+    y->i_next = 0;
+    prev = __atomic_exchange_n(&q->q_tail, y, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->i_next, y, __ATOMIC_RELEASE);
+}
+
+    /* only the consumer calls this.  It can return zero while a push is half
+    done; the pusher then wakes us up again. */
+static t_netitem *netqueue_pop(t_netqueue *q)
+{
+    t_netitem *head = q->q_head,
+        *next = __atomic_load_n(&head->i_next, __ATOMIC_ACQUIRE);
+    if (head == &q->q_stub)
+    {
+        if (!next)
+            return (0);
+        q->q_head = head = next;
+        next = __atomic_load_n(&head->i_next, __ATOMIC_ACQUIRE);
+    }
+    if (!next)
+    {
+        if (head != __atomic_load_n(&q->q_tail, __ATOMIC_ACQUIRE))
+            return (0);
+        netqueue_push(q, &q->q_stub);
+        next = __atomic_load_n(&head->i_next, __ATOMIC_ACQUIRE);
+        if (!next)
+            return (0);
+    }
+    q->q_head = next;
+    return (head);
+}
+
+    /* wake the consumer up, unless a wakeup is pending already */
+static void netqueue_wake(t_netqueue *q)
+{
+    if (!__atomic_exchange_n(&q->q_pending, 1, __ATOMIC_SEQ_CST))
+    {
+        char c = 0;
+        if (write(q->q_pipe[1], &c, 1) < 0 && errno != EAGAIN)
+            perror("netqueue_wake");
+    }
+}
+
+    /* consumer calls this before popping */
+static void netqueue_clearwake(t_netqueue *q)
+{
+    char buf[64];
+    while (read(q->q_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+    __atomic_store_n(&q->q_pending, 0, __ATOMIC_SEQ_CST);
+}
+
+static void netqueue_free(t_netqueue *q)
+{
+    t_netitem *y;
+    while ((y = netqueue_pop(q)))
+    {
+        if (y->i_type == NET_FREED)
+            freebytes(y->i_conn, sizeof(*y->i_conn));
+        netitem_free(y);
+    }
+    close(q->q_pipe[0]);
+    close(q->q_pipe[1]);
+}
+
+/* ---- network thread side ---- */
+
+static void netthread_result(t_netthread *x, t_netitem *y)
+{
+    netqueue_push(&x->n_result, y);
+    x->n_pushed = 1;
+}
+
+static void netthread_error(t_netthread *x, t_netconn *c, int err,
+    const char *what, int dead)
+{
+    t_netitem *y = netitem_new((dead ? NET_EOF : NET_ERROR), c, 0, 0);
+    y->i_err = err;
+    y->i_what = what;
+    netthread_result(x, y);
+}
+
+static void netthread_setpoll(t_netthread *x, t_netconn *c, int polled,
+    int pollout)
+{
+#ifdef __linux__
+    struct epoll_event ev;
+    ev.events = (c->c_closing ? 0 : EPOLLIN) | (pollout ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(x->n_epollfd, (!polled ? EPOLL_CTL_DEL :
+        (c->c_polled ? EPOLL_CTL_MOD : EPOLL_CTL_ADD)), c->c_fd, &ev) < 0)
+            perror("netthread: epoll_ctl");
+#else
+    if (polled && !c->c_polled)
+    {
+        if (x->n_npoll == x->n_pollsize)
+        {
+            int newsize = 2 * x->n_pollsize;
+            x->n_pollfds = (struct pollfd *)resizebytes(x->n_pollfds,
+                x->n_pollsize * sizeof(*x->n_pollfds),
+                    newsize * sizeof(*x->n_pollfds));
+            x->n_pollconns = (t_netconn **)resizebytes(x->n_pollconns,
+                x->n_pollsize * sizeof(*x->n_pollconns),
+                    newsize * sizeof(*x->n_pollconns));
+            x->n_pollsize = newsize;
+        }
+        c->c_pollindex = x->n_npoll++;
+        x->n_pollfds[c->c_pollindex].fd = c->c_fd;
+        x->n_pollconns[c->c_pollindex] = c;
+    }
+    else if (!polled && c->c_polled)
+    {
+        int last = --x->n_npoll;
+        x->n_pollfds[c->c_pollindex] = x->n_pollfds[last];
+        x->n_pollconns[c->c_pollindex] = x->n_pollconns[last];
+        x->n_pollconns[c->c_pollindex]->c_pollindex = c->c_pollindex;
+    }
+    if (polled)
+        x->n_pollfds[c->c_pollindex].events =
+            (c->c_closing ? 0 : POLLIN) | (pollout ? POLLOUT : 0);
+#endif
+    c->c_polled = polled;
+    c->c_pollout = (polled && pollout);
+}
+
+    /* stop polling a connection that hit an error or end of file.  The
+    socket stays open (so its number can't be reused) until the scheduler
+    closes it. */
+static void netthread_dead(t_netthread *x, t_netconn *c, int err,
+    const char *what)
+{
+    if (c->c_polled)
+        netthread_setpoll(x, c, 0, 0);
+    c->c_outn = 0;
+    netthread_error(x, c, err, what, 1);
+}
+
+static void netthread_doclose(t_netthread *x, t_netconn *c, int drain);
+
+    /* send as much pending TCP output as the socket will take */
+static void netthread_flush(t_netthread *x, t_netconn *c)
+{
+    while (c->c_outn)
+    {
+        int res = (int)send(c->c_fd, c->c_outbuf + c->c_outonset,
+            c->c_outn, MSG_NOSIGNAL);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                netthread_dead(x, c, errno, "send");
+            break;
+        }
+        c->c_outonset += res;
+        c->c_outn -= res;
+    }
+    if (!c->c_outn)
+        c->c_outonset = 0;
+    if (c->c_closing && !c->c_outn)     /* sent it all, or died trying */
+        netthread_doclose(x, c, 0);
+    else if (c->c_polled && (c->c_outn != 0) != c->c_pollout)
+        netthread_setpoll(x, c, 1, (c->c_outn != 0));
+}
+
+static void netthread_addoutput(t_netthread *x, t_netconn *c,
+    const char *buf, int size)
+{
+    if (!c->c_polled)   /* dead */
+        return;
+    if (c->c_outn + size > NETMAXOUTBUF)
+    {
+        netthread_error(x, c, 0, "send buffer full; message dropped", 0);
+        return;
+    }
+    if (c->c_outonset + c->c_outn + size > c->c_outsize)
+    {
+        if (c->c_outn + size > c->c_outsize)
+        {
+            int newsize = (c->c_outsize ? 2 * c->c_outsize : 4096);
+            while (newsize < c->c_outn + size)
+                newsize *= 2;
+            c->c_outbuf = (char *)resizebytes(c->c_outbuf, c->c_outsize,
+                newsize);
+            c->c_outsize = newsize;
+        }
+        memmove(c->c_outbuf, c->c_outbuf + c->c_outonset, c->c_outn);
+        c->c_outonset = 0;
+    }
+    memcpy(c->c_outbuf + c->c_outonset + c->c_outn, buf, size);
+    c->c_outn += size;
+    if (!c->c_dirty)
+    {
+        c->c_dirty = 1;
+        c->c_nextdirty = x->n_dirty;
+        x->n_dirty = c;
+    }
+}
+
+    /* send a batch of UDP packets, all to the same connection */
+static void netthread_sendudp(t_netthread *x, t_netitem **vec, int n)
+{
+    t_netconn *c = vec[0]->i_conn;
+    socklen_t addrlen = (c->c_addr.ss_family == AF_INET6 ?
+        sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+    int i = 0, res;
+    while (i < n)
+    {
+#ifdef __linux__
+        struct mmsghdr msgs[NETBATCH];
+        struct iovec iov[NETBATCH];
+        int j;
+        for (j = 0; j < n - i; j++)
+        {
+            iov[j].iov_base = vec[i + j]->i_data;
+            iov[j].iov_len = vec[i + j]->i_size;
+            memset(&msgs[j], 0, sizeof(msgs[j]));
+            msgs[j].msg_hdr.msg_name = &c->c_addr;
+            msgs[j].msg_hdr.msg_namelen = addrlen;
+            msgs[j].msg_hdr.msg_iov = &iov[j];
+            msgs[j].msg_hdr.msg_iovlen = 1;
+        }
+        res = sendmmsg(c->c_fd, msgs, n - i, 0);
+#else
+        res = (sendto(c->c_fd, vec[i]->i_data, vec[i]->i_size, 0,
+            (struct sockaddr *)&c->c_addr, addrlen) < 0 ? -1 : 1);
+#endif
+        if (res > 0)
+            i += res;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+                /* socket buffer full: wait a little rather than drop */
+            struct pollfd pfd;
+            pfd.fd = c->c_fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, 100) <= 0)
+                break;
+        }
+        else if (errno != EINTR)
+        {
+            netthread_error(x, c, errno, "send", 0);
+            break;
+        }
+    }
+    for (i = 0; i < n; i++)
+        netitem_free(vec[i]);
+}
+
+static void netthread_readudp(t_netthread *x, t_netconn *c)
+{
+    int i, n;
+    struct sockaddr_storage from[NETBATCH];
+    int size[NETBATCH];
+#ifdef __linux__
+    struct mmsghdr msgs[NETBATCH];
+    struct iovec iov[NETBATCH];
+    for (i = 0; i < NETBATCH; i++)
+    {
+        iov[i].iov_base = x->n_recvbuf + i * NET_MAXPACKETSIZE;
+        iov[i].iov_len = NET_MAXPACKETSIZE;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    n = recvmmsg(c->c_fd, msgs, NETBATCH, 0, 0);
+    for (i = 0; i < n; i++)
+        size[i] = msgs[i].msg_len;
+#else
+    for (n = 0; n < NETBATCH; n++)
+    {
+        socklen_t fromlen = sizeof(from[n]);
+        if ((size[n] = (int)recvfrom(c->c_fd, x->n_recvbuf +
+            n * NET_MAXPACKETSIZE, NET_MAXPACKETSIZE, 0,
+                (struct sockaddr *)&from[n], &fromlen)) < 0)
+                    break;
+    }
+    if (!n && size[0] < 0)
+        n = -1;
+#endif
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        netthread_error(x, c, errno, "recv (udp)", 0);
+    for (i = 0; i < n; i++)
+    {
+        char *buf = x->n_recvbuf + i * NET_MAXPACKETSIZE, *semi;
+        int len = size[i];
+        t_netitem *y;
+        if (c->c_framing == NETFRAME_FUDI)
+        {
+                /* as in socketreceiver_getudp(): the packet must end in a
+                newline, and anything after the first semicolon is ignored */
+            if (!len || buf[len-1] != '\n')
+                continue;
+            if ((semi = memchr(buf, ';', len)))
+                len = (int)(semi - buf);
+        }
+        y = netitem_new(NET_DATA, c, len, c->c_wantfrom);
+        memcpy(y->i_data, buf, len);
+        if (c->c_wantfrom)
+            *y->i_from = from[i];
+        netthread_result(x, y);
+    }
+}
+
+static void netthread_readtcp(t_netthread *x, t_netconn *c)
+{
+    int res;
+    if (c->c_insize - (c->c_inonset + c->c_inn) < 4096)
+    {
+        if (c->c_inonset)
+        {
+            memmove(c->c_inbuf, c->c_inbuf + c->c_inonset, c->c_inn);
+            c->c_inscan -= c->c_inonset;
+            c->c_inonset = 0;
+        }
+        if (c->c_insize - c->c_inn < 4096)
+        {
+            if (c->c_insize >= NETMAXINBUF)
+            {
+                netthread_error(x, c, 0, "message too long; dropped", 0);
+                c->c_inn = c->c_inscan = 0;
+            }
+            else
+            {
+                c->c_inbuf = (char *)resizebytes(c->c_inbuf, c->c_insize,
+                    2 * c->c_insize);
+                c->c_insize *= 2;
+            }
+        }
+    }
+    res = (int)recv(c->c_fd, c->c_inbuf + c->c_inonset + c->c_inn,
+        c->c_insize - (c->c_inonset + c->c_inn), 0);
+    if (res <= 0)
+    {
+        if (res == 0)
+            netthread_dead(x, c, 0, "recv (tcp)");
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            netthread_dead(x, c, errno, "recv (tcp)");
+        return;
+    }
+    if (c->c_framing == NETFRAME_NONE)
+    {
+        t_netitem *y = netitem_new(NET_DATA, c, res, 0);
+        memcpy(y->i_data, c->c_inbuf, res);
+        netthread_result(x, y);
+        return;
+    }
+    c->c_inn += res;
+    if (c->c_framing == NETFRAME_BINARY)
+    {
+            /* pass on all the complete messages in one piece */
+        char *start = c->c_inbuf + c->c_inonset;
+        int len, n = 0;
+        while ((len = binbuf_netmessagesize(start + n, c->c_inn - n)) &&
+            len <= c->c_inn - n)
+                n += len;
+        if (n)
+        {
+            t_netitem *y = netitem_new(NET_DATA, c, n, 0);
+            memcpy(y->i_data, start, n);
+            netthread_result(x, y);
+            c->c_inonset += n;
+            c->c_inn -= n;
+        }
+        if (len > NETMAXINBUF / 2)
+        {
+                /* we'd never get all of it and couldn't find the next one */
+            netthread_error(x, c, 0, "bad message length", 0);
+            netthread_dead(x, c, 0, "recv (tcp)");
+            c->c_inn = 0;
+        }
+    }
+    while (c->c_framing == NETFRAME_FUDI)
+    {
+        char *start = c->c_inbuf + c->c_inonset,
+            *semi = socketreceiver_findsemi(c->c_inbuf + c->c_inscan,
+                start + c->c_inn);
+        int len;
+        t_netitem *y;
+        if (!semi)
+        {
+                /* rescan the trailing backslashes, if any, next time */
+            char *bp = start + c->c_inn;
+            while (bp > start && bp[-1] == '\\')
+                bp--;
+            c->c_inscan = (int)(bp - c->c_inbuf);
+            break;
+        }
+        len = (int)(semi - start) + 1;
+        y = netitem_new(NET_DATA, c, len, 0);
+        memcpy(y->i_data, start, len);
+        netthread_result(x, y);
+        c->c_inonset += len;
+        c->c_inn -= len;
+        c->c_inscan = c->c_inonset;
+    }
+    if (!c->c_inn)
+        c->c_inonset = c->c_inscan = 0;
+}
+
+static double netthread_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + 1e-9 * ts.tv_nsec);
+}
+
+    /* close a connection and tell the scheduler it can be freed.  Any output
+    that's left is thrown away, unless "drain", which we only do when quitting
+    since it blocks everything else while we wait for the socket. */
+static void netthread_doclose(t_netthread *x, t_netconn *c, int drain)
+{
+    t_netconn **cp;
+    if (c->c_closing)
+    {
+        c->c_closing = 0;
+        x->n_nclosing--;
+    }
+    if (c->c_polled)
+        netthread_setpoll(x, c, 0, 0);
+    if (drain && c->c_outn)
+    {
+        struct pollfd pfd;
+        pfd.fd = c->c_fd;
+        pfd.events = POLLOUT;
+        while (c->c_outn && poll(&pfd, 1, 1000) > 0)
+        {
+            int res = (int)send(c->c_fd, c->c_outbuf + c->c_outonset,
+                c->c_outn, MSG_NOSIGNAL);
+            if (res < 0 && errno != EAGAIN && errno != EINTR)
+                break;
+            else if (res > 0)
+                c->c_outonset += res, c->c_outn -= res;
+        }
+    }
+    sys_closesocket(c->c_fd);
+    for (cp = &x->n_conns; *cp; cp = &(*cp)->c_next)
+        if (*cp == c)
+    {
+        *cp = c->c_next;
+        break;
+    }
+    if (c->c_dirty)
+    {
+        for (cp = &x->n_dirty; *cp; cp = &(*cp)->c_nextdirty)
+            if (*cp == c)
+        {
+            *cp = c->c_nextdirty;
+            break;
+        }
+    }
+    if (c->c_inbuf)
+        freebytes(c->c_inbuf, c->c_insize);
+    if (c->c_outbuf)
+        freebytes(c->c_outbuf, c->c_outsize);
+    c->c_inbuf = c->c_outbuf = 0;
+    netthread_result(x, netitem_new(NET_FREED, c, 0, 0));
+}
+
+    /* the scheduler closed a connection.  If there's output left we keep
+    polling the socket for room to send it, and only close it once that's
+    done or NETCLOSEWAIT has gone by, so other connections don't wait. */
+static void netthread_close(t_netthread *x, t_netconn *c)
+{
+    if (c->c_outn && c->c_polled)
+    {
+        c->c_closing = 1;
+        c->c_closetime = netthread_now() + NETCLOSEWAIT;
+        x->n_nclosing++;
+        netthread_setpoll(x, c, 1, 1);
+    }
+    else netthread_doclose(x, c, 0);
+}
+
+    /* how long we may sleep before a closing connection's time is up, in
+    msec for poll(), closing those whose time has already come */
+static int netthread_expire(t_netthread *x)
+{
+    t_netconn *c, *next;
+    double now, wait = -1;
+    if (!x->n_nclosing)
+        return (-1);
+    now = netthread_now();
+    for (c = x->n_conns; c; c = next)
+    {
+        next = c->c_next;
+        if (!c->c_closing)
+            continue;
+        if (c->c_closetime <= now)
+            netthread_doclose(x, c, 0);
+        else if (wait < 0 || c->c_closetime - now < wait)
+            wait = c->c_closetime - now;
+    }
+    return (wait < 0 ? -1 : (int)(1000 * wait) + 1);
+}
+
+static void netthread_docommands(t_netthread *x)
+{
+    t_netitem *y, *batch[NETBATCH];
+    int nbatch = 0;
+    netqueue_clearwake(&x->n_cmd);
+    while ((y = netqueue_pop(&x->n_cmd)))
+    {
+        t_netconn *c = y->i_conn;
+        if (y->i_type == NET_SEND && c->c_udp)
+        {
+            if (nbatch && (nbatch == NETBATCH || batch[0]->i_conn != c))
+                netthread_sendudp(x, batch, nbatch), nbatch = 0;
+            batch[nbatch++] = y;
+            continue;
+        }
+        if (nbatch)
+            netthread_sendudp(x, batch, nbatch), nbatch = 0;
+        switch (y->i_type)
+        {
+        case NET_ADD:
+            c->c_next = x->n_conns;
+            x->n_conns = c;
+            if (!c->c_udp)
+            {
+                c->c_insize = 4096;
+                c->c_inbuf = (char *)getbytes(c->c_insize);
+            }
+            netthread_setpoll(x, c, 1, 0);
+            break;
+        case NET_SEND:
+            netthread_addoutput(x, c, y->i_data, y->i_size);
+            break;
+        case NET_CLOSE:
+            netthread_close(x, c);
+            break;
+        case NET_QUIT:
+            x->n_quit = 1;
+            break;
+        }
+        netitem_free(y);
+    }
+    if (nbatch)
+        netthread_sendudp(x, batch, nbatch);
+        /* TCP output is collected above and sent here, a socket at a time */
+    while (x->n_dirty)
+    {
+        t_netconn *c = x->n_dirty;
+        x->n_dirty = c->c_nextdirty;
+        c->c_dirty = 0;
+        if (!c->c_pollout)
+            netthread_flush(x, c);
+    }
+}
+
+static void netthread_event(t_netthread *x, t_netconn *c, int in, int out)
+{
+        /* a closing connection only waits to send; on an error or hangup
+        the send fails and that closes it */
+    if (c->c_closing)
+    {
+        netthread_flush(x, c);
+        return;
+    }
+    if (in && c->c_polled)
+    {
+        if (c->c_udp)
+            netthread_readudp(x, c);
+        else netthread_readtcp(x, c);
+    }
+    if (out && c->c_polled)
+        netthread_flush(x, c);
+}
+
+static void *netthread_run(void *z)
+{
+    t_netthread *x = (t_netthread *)z;
+    while (!x->n_quit)
+    {
+        int i, n, commands = 0, timeout = netthread_expire(x);
+#ifdef __linux__
+        struct epoll_event ev[64];
+        if ((n = epoll_wait(x->n_epollfd, ev, 64, timeout)) < 0 &&
+            errno != EINTR)
+            perror("netthread: epoll_wait");
+        for (i = 0; i < n; i++)
+        {
+            if (!ev[i].data.ptr)
+                commands = 1;
+            else netthread_event(x, (t_netconn *)ev[i].data.ptr,
+                (ev[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP)) != 0,
+                    (ev[i].events & EPOLLOUT) != 0);
+        }
+#else
+        if ((n = poll(x->n_pollfds, x->n_npoll, timeout)) < 0 &&
+            errno != EINTR)
+            perror("netthread: poll");
+            /* go backward, since dead connections move the last one down */
+        for (i = x->n_npoll; i-- > 1 && n > 0; )
+            if (x->n_pollfds[i].revents)
+        {
+            int revents = x->n_pollfds[i].revents;
+            netthread_event(x, x->n_pollconns[i],
+                (revents & (POLLIN|POLLERR|POLLHUP)) != 0,
+                    (revents & POLLOUT) != 0);
+        }
+        commands = (n > 0 && x->n_pollfds[0].revents);
+#endif
+            /* after reading, so that no event refers to a closed connection */
+        if (commands)
+            netthread_docommands(x);
+        if (x->n_pushed)
+        {
+            netqueue_wake(&x->n_result);
+            x->n_pushed = 0;
+        }
+    }
+    while (x->n_conns)
+        netthread_doclose(x, x->n_conns, 1);
+    return (0);
+}
+
+/* ---- scheduler side ---- */
+
+    /* handle what the network thread sends back */
+static void netthread_poll(t_netthread *x, int fd)
+{
+    t_netitem *y;
+    int n = 0;
+    netqueue_clearwake(&x->n_result);
+    while ((y = netqueue_pop(&x->n_result)))
+    {
+        t_netconn *c = y->i_conn;
+        if (y->i_type == NET_FREED)
+            freebytes(c, sizeof(*c));
+        else if (c->c_owner)
+        {
+            outlet_setstacklim();
+            if (y->i_type == NET_DATA)
+                (*c->c_datafn)(c->c_owner, c, y->i_data, y->i_size,
+                    (y->i_from ? y->i_from : (c->c_udp ? 0 : &c->c_addr)));
+            else (*c->c_errorfn)(c->c_owner, c, y->i_err, y->i_what,
+                (y->i_type == NET_EOF));
+        }
+        netitem_free(y);
+            /* don't hog the scheduler; come back for the rest */
+        if (++n == NETMAXDISPATCH)
+        {
+            netqueue_wake(&x->n_result);
+            break;
+        }
+    }
+}
+
+static t_netthread *netthread_get(void)
+{
+    t_netthread *x = STUFF->st_netthread;
+    if (x || sys_nonetthread)
+        return (x);
+    x = (t_netthread *)getbytes(sizeof(*x));
+    if (netqueue_init(&x->n_cmd) < 0)
+        goto fail;
+    if (netqueue_init(&x->n_result) < 0)
+    {
+        close(x->n_cmd.q_pipe[0]);
+        close(x->n_cmd.q_pipe[1]);
+        goto fail;
+    }
+#ifdef __linux__
+    if ((x->n_epollfd = epoll_create1(EPOLL_CLOEXEC)) >= 0)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = 0;
+        epoll_ctl(x->n_epollfd, EPOLL_CTL_ADD, x->n_cmd.q_pipe[0], &ev);
+    }
+#else
+    x->n_pollsize = 16;
+    x->n_pollfds = (struct pollfd *)getbytes(
+        x->n_pollsize * sizeof(*x->n_pollfds));
+    x->n_pollconns = (t_netconn **)getbytes(
+        x->n_pollsize * sizeof(*x->n_pollconns));
+    x->n_pollfds[0].fd = x->n_cmd.q_pipe[0];
+    x->n_pollfds[0].events = POLLIN;
+    x->n_npoll = 1;
+#endif
+    x->n_recvbuf = (char *)getbytes(NETBATCH * NET_MAXPACKETSIZE);
+    x->n_binbuf = binbuf_new();
+    if (
+#ifdef __linux__
+        x->n_epollfd < 0 ||
+#endif
+        pthread_create(&x->n_thread, 0, netthread_run, x))
+    {
+#ifdef __linux__
+        if (x->n_epollfd >= 0)
+            close(x->n_epollfd);
+#else
+        freebytes(x->n_pollfds, x->n_pollsize * sizeof(*x->n_pollfds));
+        freebytes(x->n_pollconns, x->n_pollsize * sizeof(*x->n_pollconns));
+#endif
+        freebytes(x->n_recvbuf, NETBATCH * NET_MAXPACKETSIZE);
+        binbuf_free(x->n_binbuf);
+        netqueue_free(&x->n_cmd);
+        netqueue_free(&x->n_result);
+        goto fail;
+    }
+    sys_addpollfn(x->n_result.q_pipe[0], (t_fdpollfn)netthread_poll, x);
+    return (STUFF->st_netthread = x);
+fail:
+    pd_error(0, "netsend/netreceive: couldn't start network thread");
+    freebytes(x, sizeof(*x));
+    sys_nonetthread = 1;
+    return (0);
+}
+
+    /* stop the network thread, sending whatever output is still queued */
+void netthread_free(void)
+{
+    t_netthread *x = STUFF->st_netthread;
+    if (!x)
+        return;
+    netqueue_push(&x->n_cmd, netitem_new(NET_QUIT, 0, 0, 0));
+    netqueue_wake(&x->n_cmd);
+    pthread_join(x->n_thread, 0);
+    sys_rmpollfn(x->n_result.q_pipe[0]);
+#ifdef __linux__
+    close(x->n_epollfd);
+#else
+    freebytes(x->n_pollfds, x->n_pollsize * sizeof(*x->n_pollfds));
+    freebytes(x->n_pollconns, x->n_pollsize * sizeof(*x->n_pollconns));
+#endif
+    freebytes(x->n_recvbuf, NETBATCH * NET_MAXPACKETSIZE);
+    binbuf_free(x->n_binbuf);
+    netqueue_free(&x->n_cmd);
+    netqueue_free(&x->n_result);
+    freebytes(x, sizeof(*x));
+    STUFF->st_netthread = 0;
+}
+
+    /* hand a connected socket to the network thread */
+static t_netconn *netconn_new(t_netthread *x, int fd, int udp, int framing,
+    int wantfrom, const struct sockaddr_storage *addr,
+    void *owner, t_netdatafn datafn, t_neterrorfn errorfn)
+{
+    t_netconn *c = (t_netconn *)getbytes(sizeof(*c));
+    c->c_fd = fd;
+    c->c_udp = udp;
+    c->c_framing = framing;
+    c->c_wantfrom = wantfrom;
+    if (addr)
+        c->c_addr = *addr;
+    c->c_owner = owner;
+    c->c_datafn = datafn;
+    c->c_errorfn = errorfn;
+    socket_set_nonblocking(fd, 1);
+    netqueue_push(&x->n_cmd, netitem_new(NET_ADD, c, 0, 0));
+    netqueue_wake(&x->n_cmd);
+    return (c);
+}
+
+static void netconn_send(t_netconn *c, const char *buf, int size)
+{
+    t_netthread *x = STUFF->st_netthread;
+    t_netitem *y = netitem_new(NET_SEND, c, size, 0);
+    memcpy(y->i_data, buf, size);
+    netqueue_push(&x->n_cmd, y);
+    netqueue_wake(&x->n_cmd);
+}
+
+    /* close the socket.  Nothing more is reported to the owner. */
+static void netconn_close(t_netconn *c)
+{
+    t_netthread *x = STUFF->st_netthread;
+    c->c_owner = 0;
+    netqueue_push(&x->n_cmd, netitem_new(NET_CLOSE, c, 0, 0));
+    netqueue_wake(&x->n_cmd);
+}
+
+#else /* NETTHREAD */
+
+void netthread_free(void)
+{
+}
+
+#endif /* NETTHREAD */
+
+/* ----------------------------- net ------------------------- */
+
+static t_class *netsend_class;
+
+typedef struct _netsend
+{
+    t_object x_obj;
+    t_outlet *x_msgout;
+    t_outlet *x_connectout;
+    t_outlet *x_fromout;
+    int x_sockfd;
+    int x_protocol;
+    int x_bin;
+    t_socketreceiver *x_receiver;
+    struct _netconn *x_conn;    /* if the network thread has the socket */
+    struct sockaddr_storage x_server;
+    t_float x_timeout; /* TCP connect timeout in seconds */
+    int x_osc;                  /* OSC over UDP ("-o" flag) */
+    double x_oscoffset;         /* wall clock minus logical time, msec */
+    struct _oscevent *x_oscevents;  /* bundled messages to send later */
+    int x_netmsg;               /* binary messages ("-t" flag) */
+    char *x_sendbuf;            /* outgoing data, formatted */
+    int x_sendsize;             /* allocated size of x_sendbuf */
+    int x_sendn;                /* bytes waiting to be sent */
+    t_clock *x_flushclock;      /* sends them at the end of the tick */
+    int x_pending;              /* on the list of objects with output */
+    struct _netsend *x_nextpending;
+} t_netsend;
+
+static t_class *netreceive_class;
+
+typedef struct _netreceive
+{
+    t_netsend x_ns;
+    int x_nconnections;
+    int x_sockfd;
+    int *x_connections;
+    int x_old;
+    t_socketreceiver **x_receivers;
+    struct _netconn **x_conns;
+} t_netreceive;
+
+static void netsend_disconnect(t_netsend *x);
+static void netreceive_notify(t_netreceive *x, int fd);
+
+/* ----------------------------- OSC ------------------------- */
+
+/* With the "-o" flag, [netsend] and [netreceive] send and receive Open Sound
+Control over UDP, encoding and decoding packets directly in the socket
+buffers instead of going byte by byte through [oscformat] and [oscparse].
+
+An incoming message goes to the [receive] objects named by its address, for
+instance "/synth/freq" to [r /synth/freq].  Addresses with OSC wildcards are
+matched against all bound names that start with a slash; these are kept in a
+trie that's rebuilt after pd_bind() reports a new one by bumping
+STUFF->st_oscbindgen.  Messages that nobody receives come out of the left
+outlet, in the format [oscparse] uses.
+
+Bundles whose timetags are in the future are held back and dispatched at the
+corresponding logical time, so that their relative timing survives network
+jitter.  To convert timetags we keep a smoothed estimate of the difference
+between the wall clock and logical time. */
+
+#define OSC_PAD(n) (((n) + 3) & ~3)
+#define OSC_MAXDEPTH 8              /* maximum nesting of bundles */
+#define OSC_NTPOFFSET 2208988800.   /* seconds from 1900 to 1970 */
+#define OSC_RESYNC 50.              /* msec; bigger clock jumps resync */
+
+#define HUGEMSG 1000    /* bigger than this we use getbytes(), not alloca() */
+#define ATOMS_ALLOCA(x, n) ((x) = (t_atom *)((n) < HUGEMSG ?  \
+        alloca((n) * sizeof(t_atom)) : getbytes((n) * sizeof(t_atom))))
+#define ATOMS_FREEA(x, n) ( \
+    ((n) < HUGEMSG || (freebytes((x), (n) * sizeof(t_atom)), 0)))
+
+typedef struct _oscnode
+{
+    const char *n_name;         /* address component (in a symbol's name) */
+    int n_size;                 /* length of the component */
+    t_symbol *n_sym;            /* the whole address, if one ends here */
+    struct _oscnode *n_child;
+    struct _oscnode *n_next;
+} t_oscnode;
+
+typedef struct _osctrie
+{
+    unsigned int o_gen;         /* value of st_oscbindgen when built */
+    t_oscnode o_root;
+} t_osctrie;
+
+typedef struct _oscevent
+{
+    t_clock *e_clock;
+    t_netsend *e_owner;
+    struct _oscevent *e_next;
+    int e_size;
+    char e_buf[4];              /* the message (e_size bytes) */
+} t_oscevent;
+
+typedef struct _oscmsg
+{
+    const char *m_addr;         /* null-terminated address */
+    const char *m_types;        /* type tags, after the comma */
+    const char *m_data;         /* arguments */
+    const char *m_end;
+} t_oscmsg;
+
+static const char *osc_name(t_netsend *x)
+{
+    return (class_getname(pd_class(&x->x_obj.ob_pd)));
+}
+
+static uint32_t osc_getint(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) |
+        ((uint32_t)u[2] << 8) | u[3]);
+}
+
+static void osc_putint(char *p, uint32_t i)
+{
+    p[0] = (char)(i >> 24);
+    p[1] = (char)(i >> 16);
+    p[2] = (char)(i >> 8);
+    p[3] = (char)i;
+}
+
+    /* padded size of the string at p, or -1 if it isn't terminated
+    before e.  A missing final pad is forgiven. */
+static int osc_strsize(const char *p, const char *e)
+{
+    const char *z = (p < e ? (const char *)memchr(p, 0, e - p) : 0);
+    int size;
+    if (!z)
+        return (-1);
+    size = OSC_PAD((int)(z - p) + 1);
+    return (size > e - p ? (int)(e - p) : size);
+}
+
+static int osc_parse(t_oscmsg *m, const char *buf, int size)
+{
+    const char *e = buf + size, *p;
+    int n;
+    if (*buf != '/' || (n = osc_strsize(buf, e)) < 0)
+        return (0);
+    m->m_addr = buf;
+    m->m_end = e;
+    p = buf + n;
+    if (p < e && *p == ',')
+    {
+        if ((n = osc_strsize(p, e)) < 0)
+            return (0);
+        m->m_types = p + 1;
+        m->m_data = p + n;
+    }
+    else    /* no type tags (very old OSC): ignore any arguments */
+    {
+        m->m_types = "";
+        m->m_data = p;
+    }
+    return (1);
+}
+
+    /* decode the arguments of a message into atoms, of which there can be
+    at most 4 per type tag plus one per data byte.  Returns the number of
+    atoms, or -1 if the message is bad. */
+static int osc_getargs(t_netsend *x, t_oscmsg *m, t_atom *av)
+{
+    const char *tp, *dp = m->m_data, *e = m->m_end;
+    int n = 0, i, size;
+    for (tp = m->m_types; *tp; tp++)
+    {
+        union
+        {
+            float z_f;
+            uint32_t z_i;
+        } z;
+        union
+        {
+            double z_d;
+            uint64_t z_i;
+        } z2;
+        t_float f;
+        switch (*tp)
+        {
+        case 'f':
+            if (e - dp < 4)
+                goto tooshort;
+            z.z_i = osc_getint(dp);
+            f = z.z_f;
+            if (PD_BADFLOAT(f))
+                f = 0;
+            SETFLOAT(av + n, f);
+            n++; dp += 4;
+            break;
+        case 'i': case 'c': case 'r':
+            if (e - dp < 4)
+                goto tooshort;
+            SETFLOAT(av + n, (*tp == 'r' ? (t_float)osc_getint(dp) :
+                (t_float)(int32_t)osc_getint(dp)));
+            n++; dp += 4;
+            break;
+        case 'h': case 'd':
+            if (e - dp < 8)
+                goto tooshort;
+            z2.z_i = ((uint64_t)osc_getint(dp) << 32) | osc_getint(dp + 4);
+            if (*tp == 'd')
+            {
+                f = (t_float)z2.z_d;
+                if (PD_BADFLOAT(f))
+                    f = 0;
+            }
+            else f = (t_float)(int64_t)z2.z_i;
+            SETFLOAT(av + n, f);
+            n++; dp += 8;
+            break;
+        case 's': case 'S':
+            if ((size = osc_strsize(dp, e)) < 0)
+                goto tooshort;
+            SETSYMBOL(av + n, gensym(dp));
+            n++; dp += size;
+            break;
+        case 'b':
+            if (e - dp < 4)
+                goto tooshort;
+            size = (int)osc_getint(dp);
+            dp += 4;
+            if (size < 0 || size > e - dp)
+                goto tooshort;
+            SETFLOAT(av + n, size);
+            n++;
+            for (i = 0; i < size; i++)
+                SETFLOAT(av + n + i, (unsigned char)dp[i]);
+            n += size;
+            dp += (OSC_PAD(size) > e - dp ? e - dp : OSC_PAD(size));
+            break;
+        case 'm':
+            if (e - dp < 4)
+                goto tooshort;
+            for (i = 0; i < 4; i++)
+                SETFLOAT(av + n + i, (unsigned char)dp[i]);
+            n += 4; dp += 4;
+            break;
+        case 'T':
+            SETFLOAT(av + n, 1);
+            n++;
+            break;
+        case 'F':
+            SETFLOAT(av + n, 0);
+            n++;
+            break;
+        case 'N': case 'I':
+            break;
+        default:
+            pd_error(x, "%s: unknown OSC type tag '%c' (%d)", osc_name(x),
+                *tp, *tp);
+            return (-1);
+        }
+    }
+    return (n);
+tooshort:
+    pd_error(x, "%s: OSC message ended prematurely", osc_name(x));
+    return (-1);
+}
+
+    /* match one address component against an OSC pattern component */
+static int osc_match(const char *p, const char *pe, const char *s,
+    const char *se)
+{
+    while (p < pe)
+    {
+        const char *close, *alt, *comma;
+        int neg, hit;
+        switch (*p)
+        {
+        case '*':
+            while (p < pe && *p == '*')
+                p++;
+            if (p == pe)
+                return (1);
+            for (; s <= se; s++)
+                if (osc_match(p, pe, s, se))
+                    return (1);
+            return (0);
+        case '?':
+            if (s == se)
+                return (0);
+            p++, s++;
+            break;
+        case '[':
+            if (s == se)
+                return (0);
+            p++;
+            neg = (p < pe && *p == '!');
+            p += neg;
+            for (hit = 0; p < pe && *p != ']'; )
+            {
+                if (pe - p > 2 && p[1] == '-' && p[2] != ']')
+                {
+                    if (*s >= p[0] && *s <= p[2])
+                        hit = 1;
+                    p += 3;
+                }
+                else hit |= (*s == *p++);
+            }
+            if (p == pe || hit == neg)
+                return (0);
+            p++, s++;
+            break;
+        case '{':
+            if (!(close = (const char *)memchr(p, '}', pe - p)))
+                return (0);
+            for (alt = p + 1; alt <= close; alt = comma + 1)
+            {
+                for (comma = alt; comma < close && *comma != ','; comma++)
+                    ;
+                if (se - s >= comma - alt && !memcmp(alt, s, comma - alt) &&
+                    osc_match(close + 1, pe, s + (comma - alt), se))
+                        return (1);
+            }
+            return (0);
+        default:
+            if (s == se || *s != *p)
+                return (0);
+            p++, s++;
+        }
+    }
+    return (s == se);
+}
+
+static void oscnode_free(t_oscnode *n)
+{
+    t_oscnode *c, *next;
+    for (c = n->n_child; c; c = next)
+    {
+        next = c->n_next;
+        oscnode_free(c);
+        freebytes(c, sizeof(*c));
+    }
+    n->n_child = 0;
+}
 
-#ifdef _WIN32
-# include <malloc.h> /* MSVC or mingw on windows */
-#elif defined(__linux__) || defined(__APPLE__) || defined(HAVE_ALLOCA_H)
-# include <alloca.h> /* linux, mac, mingw, cygwin */
-#endif
+static void osctrie_add(t_osctrie *t, t_symbol *s)
+{
+    t_oscnode *n = &t->o_root, *c;
+    const char *cp = s->s_name, *ep;
+    while (1)
+    {
+        while (*cp == '/')
+            cp++;
+        if (!*cp)
+            break;
+        for (ep = cp; *ep && *ep != '/'; ep++)
+            ;
+        for (c = n->n_child; c; c = c->n_next)
+            if (c->n_size == ep - cp && !memcmp(c->n_name, cp, ep - cp))
+                break;
+        if (!c)
+        {
+            c = (t_oscnode *)getbytes(sizeof(*c));
+            c->n_name = cp;
+            c->n_size = (int)(ep - cp);
+            c->n_next = n->n_child;
+            n->n_child = c;
+        }
+        n = c;
+        cp = ep;
+    }
+    if (n != &t->o_root)
+        n->n_sym = s;
+}
 
-/* print addrinfo lists for debugging */
-/* #define PRINT_ADDRINFO */
+    /* get the trie of bound "/..." names, rebuilding it if new ones have
+    been bound since.  Names that have been unbound stay in it until the
+    next rebuild; their s_thing is zero. */
+static t_osctrie *osctrie_get(void)
+{
+    t_osctrie *t = STUFF->st_osctrie;
+    t_symbol *s;
+    int i;
+    if (t && t->o_gen == STUFF->st_oscbindgen)
+        return (t);
+    if (!t)
+        t = STUFF->st_osctrie = (t_osctrie *)getbytes(sizeof(*t));
+    else oscnode_free(&t->o_root);
+    for (i = 0; i < pd_this->pd_symhashsize; i++)
+        for (s = pd_this->pd_symhash[i]; s; s = s->s_next)
+            if (*s->s_name == '/' && s->s_thing)
+                osctrie_add(t, s);
+    t->o_gen = STUFF->st_oscbindgen;
+    return (t);
+}
 
-/* ----------------------------- helpers ------------------------- */
+void osctrie_free(void)
+{
+    if (STUFF->st_osctrie)
+    {
+        oscnode_free(&STUFF->st_osctrie->o_root);
+        freebytes(STUFF->st_osctrie, sizeof(t_osctrie));
+        STUFF->st_osctrie = 0;
+    }
+}
 
-void socketreceiver_free(t_socketreceiver *x);
+    /* collect bound names matching the rest of a pattern, starting at cp */
+static void oscnode_match(t_oscnode *n, const char *cp, t_symbol ***vecp,
+    int *np, int *sizep)
+{
+    const char *ep;
+    t_oscnode *c;
+    while (*cp == '/')
+        cp++;
+    if (!*cp)
+    {
+        if (n->n_sym && n->n_sym->s_thing)
+        {
+            if (*np == *sizep)
+            {
+                *vecp = (t_symbol **)resizebytes(*vecp,
+                    *sizep * sizeof(t_symbol *),
+                        (*sizep * 2 + 4) * sizeof(t_symbol *));
+                *sizep = *sizep * 2 + 4;
+            }
+            (*vecp)[(*np)++] = n->n_sym;
+        }
+        return;
+    }
+    for (ep = cp; *ep && *ep != '/'; ep++)
+        ;
+    for (c = n->n_child; c; c = c->n_next)
+        if (osc_match(cp, ep, c->n_name, c->n_name + c->n_size))
+            oscnode_match(c, ep, vecp, np, sizep);
+}
 
-static void outlet_sockaddr(t_outlet *o, const struct sockaddr *sa)
+static void osc_send(t_pd *target, int argc, t_atom *argv)
 {
-    char addrstr[INET6_ADDRSTRLEN];
-    unsigned short port = sockaddr_get_port(sa);
-    if (sockaddr_get_addrstr(sa, addrstr, INET6_ADDRSTRLEN))
+    if (!argc)
+        pd_bang(target);
+    else if (argc == 1 && argv->a_type == A_FLOAT)
+        pd_float(target, argv->a_w.w_float);
+    else if (argc == 1 && argv->a_type == A_SYMBOL)
+        pd_symbol(target, argv->a_w.w_symbol);
+    else pd_list(target, &s_list, argc, argv);
+}
+
+    /* dispatch one OSC message */
+static void osc_message(t_netsend *x, const char *buf, int size)
+{
+    t_oscmsg m;
+    t_atom *av;
+    int ac, nalloc, naddr = 0, i;
+    const char *cp;
+    t_symbol *addr;
+    if (!osc_parse(&m, buf, size))
     {
-        t_atom ap[2];
-        SETSYMBOL(&ap[0], gensym(addrstr));
-        SETFLOAT(&ap[1], (t_float)port);
-        outlet_list(o, NULL, 2, ap);
+        pd_error(x, "%s: bad OSC message", osc_name(x));
+        return;
+    }
+    for (cp = m.m_addr; *cp; cp++)
+        naddr += (*cp == '/');
+    nalloc = naddr + 4 * (int)strlen(m.m_types) + (int)(m.m_end - m.m_data);
+    ATOMS_ALLOCA(av, nalloc);
+    if ((ac = osc_getargs(x, &m, av + naddr)) < 0)
+        goto done;
+    addr = gensym(m.m_addr);
+    if (strpbrk(m.m_addr, "*?[{"))
+    {
+        t_symbol **vec = 0;
+        int n = 0, vecsize = 0;
+        oscnode_match(&osctrie_get()->o_root, m.m_addr, &vec, &n, &vecsize);
+            /* receivers might unbind each other, so check each time */
+        for (i = 0; i < n; i++)
+            if (vec[i]->s_thing)
+                osc_send(vec[i]->s_thing, ac, av + naddr);
+        if (vec)
+            freebytes(vec, vecsize * sizeof(t_symbol *));
+        if (n)
+            goto done;
+    }
+    else if (addr->s_thing)
+    {
+        osc_send(addr->s_thing, ac, av + naddr);
+        goto done;
+    }
+    if (x->x_msgout)
+    {
+            /* no receiver; output address components and arguments */
+        char compbuf[MAXPDSTRING];
+        int ncomp = 0;
+        t_atom *ap;
+        for (cp = m.m_addr; *cp; )
+        {
+            const char *ep;
+            while (*cp == '/')
+                cp++;
+            if (!*cp)
+                break;
+            for (ep = cp; *ep && *ep != '/'; ep++)
+                ;
+            ncomp++;
+            cp = ep;
+        }
+        ap = av + naddr - ncomp;
+        for (cp = m.m_addr, i = 0; i < ncomp; i++)
+        {
+            int len;
+            while (*cp == '/')
+                cp++;
+            for (len = 0; cp[len] && cp[len] != '/'; len++)
+                ;
+            if (len > MAXPDSTRING-1)
+                len = MAXPDSTRING-1;
+            memcpy(compbuf, cp, len);
+            compbuf[len] = 0;
+            SETSYMBOL(ap + i, gensym(compbuf));
+            while (*cp && *cp != '/')
+                cp++;
+        }
+        outlet_list(x->x_msgout, 0, ncomp + ac, ap);
     }
+done:
+    ATOMS_FREEA(av, nalloc);
 }
 
-/* ----------------------------- net ------------------------- */
+static void osc_eventtick(t_oscevent *e)
+{
+    t_netsend *x = e->e_owner;
+    t_oscevent **ep;
+    for (ep = &x->x_oscevents; *ep != e; ep = &(*ep)->e_next)
+        ;
+    *ep = e->e_next;
+    osc_message(x, e->e_buf, e->e_size);
+    clock_free(e->e_clock);
+    freebytes(e, sizeof(*e) + e->e_size);
+}
 
-static t_class *netsend_class;
+static void osc_freeevents(t_netsend *x)
+{
+    t_oscevent *e;
+    while ((e = x->x_oscevents))
+    {
+        x->x_oscevents = e->e_next;
+        clock_free(e->e_clock);
+        freebytes(e, sizeof(*e) + e->e_size);
+    }
+}
 
-typedef struct _netsend
+static double osc_walltime(void)
 {
-    t_object x_obj;
-    t_outlet *x_msgout;
-    t_outlet *x_connectout;
-    t_outlet *x_fromout;
-    int x_sockfd;
-    int x_protocol;
-    int x_bin;
-    t_socketreceiver *x_receiver;
-    struct sockaddr_storage x_server;
-    t_float x_timeout; /* TCP connect timeout in seconds */
-} t_netsend;
+#ifdef _WIN32
+    FILETIME ft;
+    ULARGE_INTEGER u;
+    GetSystemTimeAsFileTime(&ft);
+    u.LowPart = ft.dwLowDateTime;
+    u.HighPart = ft.dwHighDateTime;
+        /* 100-nanosecond units since 1601 */
+    return ((double)u.QuadPart * 1e-4 - 11644473600000.);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return (tv.tv_sec * 1000. + tv.tv_usec * 0.001);
+#endif
+}
 
-static t_class *netreceive_class;
+    /* how many msec from now a timetag is, in logical time */
+static double osc_timetagdelay(t_netsend *x, uint32_t sec, uint32_t frac)
+{
+    double logical, diff, when;
+    if (sec == 0 && frac == 1)  /* "immediately" */
+        return (0);
+    logical = clock_gettimesince(0);
+    diff = osc_walltime() - logical;
+        /* a one-pole filter removes the jitter from the scheduler's
+        granularity; clock jumps (DSP switched on, for instance) resync */
+    if (x->x_oscoffset == 0 || fabs(diff - x->x_oscoffset) > OSC_RESYNC)
+        x->x_oscoffset = diff;
+    else x->x_oscoffset += 0.001 * (diff - x->x_oscoffset);
+    when = ((double)sec - OSC_NTPOFFSET) * 1000. +
+        (double)frac * (1000. / 4294967296.);
+    return (when - x->x_oscoffset - logical);
+}
 
-typedef struct _netreceive
+static void osc_schedule(t_netsend *x, const char *buf, int size,
+    double delay)
 {
-    t_netsend x_ns;
-    int x_nconnections;
-    int x_sockfd;
-    int *x_connections;
-    int x_old;
-    t_socketreceiver **x_receivers;
-} t_netreceive;
+    t_oscevent *e = (t_oscevent *)getbytes(sizeof(*e) + size);
+    e->e_clock = clock_new(e, (t_method)osc_eventtick);
+    e->e_owner = x;
+    e->e_size = size;
+    memcpy(e->e_buf, buf, size);
+    e->e_next = x->x_oscevents;
+    x->x_oscevents = e;
+    clock_delay(e->e_clock, delay);
+}
 
-static void netsend_disconnect(t_netsend *x);
-static void netreceive_notify(t_netreceive *x, int fd);
+    /* dispatch an incoming packet, which is a message or a bundle */
+static void osc_packet(t_netsend *x, const char *buf, int size, int depth)
+{
+    int i, n;
+    double delay;
+    if (size < 8 || memcmp(buf, "#bundle", 8))
+    {
+        if (size > 0)
+            osc_message(x, buf, size);
+        return;
+    }
+    if (size < 16 || depth >= OSC_MAXDEPTH)
+    {
+        pd_error(x, "%s: malformed OSC bundle", osc_name(x));
+        return;
+    }
+    delay = osc_timetagdelay(x, osc_getint(buf + 8), osc_getint(buf + 12));
+    for (i = 16; size - i >= 4; i += 4 + n)
+    {
+        const char *elem = buf + i + 4;
+        n = (int)osc_getint(buf + i);
+        if (n <= 0 || n > size - i - 4)
+        {
+            pd_error(x, "%s: bad OSC bundle element size", osc_name(x));
+            return;
+        }
+        if (n >= 8 && !memcmp(elem, "#bundle", 8))
+            osc_packet(x, elem, n, depth + 1);
+        else if (delay > 0)
+            osc_schedule(x, elem, n, delay);
+        else osc_message(x, elem, n);
+    }
+}
+
+    /* format a Pd message as OSC into buf (if it isn't null) and return the
+    size.  The first atom is the address; floats become 'f' and symbols 's'
+    arguments.  Returns -1 if there's no address. */
+static int osc_encode(char *buf, int argc, t_atom *argv)
+{
+    int i, size, typeonset, dataonset;
+    const char *addr;
+    char *dp;
+    if (!argc || argv->a_type != A_SYMBOL ||
+        *(addr = argv->a_w.w_symbol->s_name) != '/')
+            return (-1);
+    typeonset = OSC_PAD((int)strlen(addr) + 1);
+    dataonset = typeonset + OSC_PAD(argc + 1);
+    for (i = 1, size = dataonset; i < argc; i++)
+        size += (argv[i].a_type == A_SYMBOL ?
+            OSC_PAD((int)strlen(argv[i].a_w.w_symbol->s_name) + 1) : 4);
+    if (!buf)
+        return (size);
+    memset(buf, 0, size);
+    strcpy(buf, addr);
+    buf[typeonset] = ',';
+    for (i = 1, dp = buf + dataonset; i < argc; i++)
+    {
+        if (argv[i].a_type == A_SYMBOL)
+        {
+            const char *s = argv[i].a_w.w_symbol->s_name;
+            buf[typeonset + i] = 's';
+            strcpy(dp, s);
+            dp += OSC_PAD((int)strlen(s) + 1);
+        }
+        else
+        {
+            union
+            {
+                float z_f;
+                uint32_t z_i;
+            } z;
+            buf[typeonset + i] = 'f';
+            z.z_f = atom_getfloat(argv + i);
+            osc_putint(dp, z.z_i);
+            dp += 4;
+        }
+    }
+    return (size);
+}
 
 /* ----------------------------- netsend ------------------------- */
 
+/* Outgoing messages are formatted into a buffer kept by the object.  Over
+TCP, and for binary messages ("-t") over UDP, the messages sent during a
+scheduler tick are held and then sent together when the tick is over, so
+that a burst costs one system call (or one handoff to the network thread)
+instead of one per message.  Other UDP messages go out one per packet, at
+once.  Objects holding output are kept on a list so that it can be sent on
+quitting Pd. */
+
+#define NETSEND_MAXHOLD 65536       /* flush early if we have more than this */
+#define NETSEND_MAXPACKET 1400      /* keep coalesced UDP packets this small */
+
+static void netsend_flush(t_netsend *x);
+
+static void netsend_initsend(t_netsend *x)
+{
+    x->x_netmsg = 0;
+    x->x_sendbuf = 0;
+    x->x_sendsize = x->x_sendn = 0;
+    x->x_flushclock = clock_new(x, (t_method)netsend_flush);
+    x->x_pending = 0;
+    x->x_nextpending = 0;
+}
+
 static void *netsend_new(t_symbol *s, int argc, t_atom *argv)
 {
     t_netsend *x = (t_netsend *)pd_new(netsend_class);
     outlet_new(&x->x_obj, &s_float);
     x->x_protocol = SOCK_STREAM;
     x->x_bin = 0;
+    x->x_osc = 0;
+    x->x_oscoffset = 0;
+    x->x_oscevents = 0;
+    netsend_initsend(x);
     if (argc && argv->a_type == A_FLOAT)
     {
         x->x_protocol = (argv->a_w.w_float != 0 ? SOCK_DGRAM : SOCK_STREAM);
@@ -89,6 +1719,14 @@ static void *netsend_new(t_symbol *s, int argc, t_atom *argv)
             x->x_bin = 1;
         else if (!strcmp(argv->a_w.w_symbol->s_name, "-u"))
             x->x_protocol = SOCK_DGRAM;
+        else if (!strcmp(argv->a_w.w_symbol->s_name, "-o"))
+        {
+                /* OSC is binary and only over UDP for now */
+            x->x_osc = x->x_bin = 1;
+            x->x_protocol = SOCK_DGRAM;
+        }
+        else if (!strcmp(argv->a_w.w_symbol->s_name, "-t"))
+            x->x_netmsg = 1;
         else
         {
             pd_error(x, "netsend: unknown flag ...");
@@ -96,6 +1734,8 @@ static void *netsend_new(t_symbol *s, int argc, t_atom *argv)
         }
         argc--; argv++;
     }
+    if (x->x_bin)
+        x->x_netmsg = 0;
     if (argc)
     {
         pd_error(x, "netsend: extra arguments ignored:");
@@ -103,6 +1743,7 @@ static void *netsend_new(t_symbol *s, int argc, t_atom *argv)
     }
     x->x_sockfd = -1;
     x->x_receiver = NULL;
+    x->x_conn = NULL;
     x->x_msgout = outlet_new(&x->x_obj, &s_anything);
     x->x_connectout = NULL;
     x->x_fromout = NULL;
@@ -164,10 +1805,15 @@ static void netsend_readbin(t_netsend *x, int fd)
                     ret, NET_MAXPACKETSIZE);
                 ret = NET_MAXPACKETSIZE;
             }
-            ap = (t_atom *)alloca(ret * sizeof(t_atom));
-            for (i = 0; i < ret; i++)
-                SETFLOAT(ap+i, inbuf[i]);
-            outlet_list(x->x_msgout, 0, ret, ap);
+            if (x->x_osc)
+                osc_packet(x, (const char *)inbuf, ret, 0);
+            else
+            {
+                ap = (t_atom *)alloca(ret * sizeof(t_atom));
+                for (i = 0; i < ret; i++)
+                    SETFLOAT(ap+i, inbuf[i]);
+                outlet_list(x->x_msgout, 0, ret, ap);
+            }
             readbytes += ret;
             /* throttle */
             if (readbytes >= NET_MAXPACKETSIZE)
@@ -239,12 +1885,82 @@ static void netsend_notify(void *z, int fd)
     }
 }
 
+#ifdef NETTHREAD
+static int netsend_framing(t_netsend *x)
+{
+    return (x->x_bin ? NETFRAME_NONE :
+        (x->x_netmsg ? NETFRAME_BINARY : NETFRAME_FUDI));
+}
+
+    /* a FUDI message, or bytes in binary mode, from the network thread */
+static void netsend_netdata(void *z, t_netconn *c, const char *buf, int size,
+    const struct sockaddr_storage *from)
+{
+    t_netsend *x = (t_netsend *)z;
+    int i;
+    if (x->x_fromout && from)
+        outlet_sockaddr(x->x_fromout, (const struct sockaddr *)from);
+    if (!x->x_bin)
+    {
+        t_binbuf *b = STUFF->st_netthread->n_binbuf;
+        if (!x->x_netmsg)
+            binbuf_text(b, buf, size);
+        else
+        {
+            binbuf_clear(b);
+            if (binbuf_addnetmessages(b, buf, size))
+                pd_error(x, "bad binary message dropped");
+        }
+        if (x->x_msgout)
+            netsend_read(x, b);
+        else binbuf_eval(b, 0, 0, 0);
+    }
+    else if (x->x_osc)
+        osc_packet(x, buf, size, 0);
+    else if (c->c_udp)
+    {
+        t_atom *ap = (t_atom *)alloca(size * sizeof(t_atom));
+        for (i = 0; i < size; i++)
+            SETFLOAT(ap+i, (unsigned char)buf[i]);
+        outlet_list(x->x_msgout, 0, size, ap);
+    }
+    else for (i = 0; i < size; i++)
+        outlet_float(x->x_msgout, (unsigned char)buf[i]);
+}
+
+static void netsend_neterror(void *z, t_netconn *c, int err,
+    const char *what, int dead)
+{
+    t_netsend *x = (t_netsend *)z;
+    int isreceive = (x->x_obj.ob_pd == netreceive_class);
+    if (err)
+    {
+        char buf[MAXPDSTRING];
+        socket_strerror(err, buf, sizeof(buf));
+        pd_error(x, "%s: %s (%d)", what, buf, err);
+    }
+    else if (!dead)
+        pd_error(x, "%s: %s", (isreceive ? "netreceive" : "netsend"), what);
+        /* as before, UDP errors don't close [netreceive] */
+    if (isreceive)
+    {
+        if (dead)
+            netreceive_notify((t_netreceive *)x, c->c_fd);
+    }
+    else if (dead || err)
+        netsend_disconnect(x);
+}
+#endif /* NETTHREAD */
+
 static void netsend_connect(t_netsend *x, t_symbol *s, int argc, t_atom *argv)
 {
     int portno, sportno, sockfd, multicast = 0, status;
     struct addrinfo *ailist = NULL, *ai;
     const char *hostname = NULL;
     char hostbuf[256];
+#ifdef NETTHREAD
+    t_netthread *t;
+#endif
 
     /* check argument types */
     if ((argc < 2) ||
@@ -387,6 +2103,13 @@ static void netsend_connect(t_netsend *x, t_symbol *s, int argc, t_atom *argv)
     }
 
     x->x_sockfd = sockfd;
+#ifdef NETTHREAD
+    if ((t = netthread_get()))
+        x->x_conn = netconn_new(t, sockfd, x->x_protocol == SOCK_DGRAM,
+            netsend_framing(x), 0, &x->x_server, x, netsend_netdata,
+                netsend_neterror);
+    else
+#endif
     if (x->x_msgout) /* add polling function for return messages */
     {
         if (x->x_bin)
@@ -396,6 +2119,7 @@ static void netsend_connect(t_netsend *x, t_symbol *s, int argc, t_atom *argv)
             t_socketreceiver *y =
               socketreceiver_new((void *)x, netsend_notify, netsend_read,
                                  x->x_protocol == SOCK_DGRAM);
+            socketreceiver_set_netmessages(y, x->x_netmsg);
             sys_addpollfn(x->x_sockfd, (t_fdpollfn)socketreceiver_read, y);
             x->x_receiver = y;
         }
@@ -410,10 +2134,21 @@ connect_fail:
 
 static void netsend_disconnect(t_netsend *x)
 {
+    netsend_flush(x);
     if (x->x_sockfd >= 0)
     {
-        sys_rmpollfn(x->x_sockfd);
-        sys_closesocket(x->x_sockfd);
+#ifdef NETTHREAD
+        if (x->x_conn)
+        {
+            netconn_close(x->x_conn);
+            x->x_conn = NULL;
+        }
+        else
+#endif
+        {
+            sys_rmpollfn(x->x_sockfd);
+            sys_closesocket(x->x_sockfd);
+        }
         x->x_sockfd = -1;
         if (x->x_receiver)
             socketreceiver_free(x->x_receiver);
@@ -423,28 +2158,19 @@ static void netsend_disconnect(t_netsend *x)
     }
 }
 
-static int netsend_dosend(t_netsend *x, int sockfd, int argc, t_atom *argv)
+static int netsend_dosend(t_netsend *x, int sockfd, struct _netconn *conn,
+    const char *buf, int length)
 {
-    char *buf, *bp;
-    int length, sent, fail = 0;
-    t_binbuf *b = 0;
-    if (x->x_bin)
-    {
-        int i;
-        buf = alloca(argc);
-        for (i = 0; i < argc; i++)
-            ((unsigned char *)buf)[i] = atom_getfloatarg(i, argc, argv);
-        length = argc;
-    }
-    else
+    const char *bp;
+    int sent, fail = 0;
+#ifdef NETTHREAD
+        /* the network thread sends it and reports errors later */
+    if (conn)
     {
-        t_atom at;
-        b = binbuf_new();
-        binbuf_add(b, argc, argv);
-        SETSEMI(&at);
-        binbuf_add(b, 1, &at);
-        binbuf_gettext(b, &buf, &length);
+        netconn_send(conn, buf, length);
+        return (0);
     }
+#endif
     for (bp = buf, sent = 0; sent < length;)
     {
         static double lastwarntime;
@@ -489,33 +2215,167 @@ static int netsend_dosend(t_netsend *x, int sockfd, int argc, t_atom *argv)
             bp += res;
         }
     }
-    done:
-    if (!x->x_bin)
+    return (fail);
+}
+
+    /* send the first n bytes of the send buffer, to the server for
+    [netsend] or to every connection for [netreceive], and drop them */
+static void netsend_sendbuf(t_netsend *x, int n)
+{
+    int fail = 0;
+    if (x->x_obj.ob_pd == netreceive_class)
     {
-        t_freebytes(buf, length);
-        binbuf_free(b);
+        t_netreceive *y = (t_netreceive *)x;
+        int i;
+        for (i = 0; i < y->x_nconnections; i++)
+        {
+            if (netsend_dosend(x, y->x_connections[i], y->x_conns[i],
+                x->x_sendbuf, n))
+                pd_error(x, "netreceive: send message failed");
+                    /* should we now close the connection? */
+        }
     }
-    return (fail);
+    else if (x->x_sockfd >= 0)
+        fail = netsend_dosend(x, x->x_sockfd, x->x_conn, x->x_sendbuf, n);
+    if (fail)
+        x->x_sendn = 0;
+    else
+    {
+        memmove(x->x_sendbuf, x->x_sendbuf + n, x->x_sendn - n);
+        x->x_sendn -= n;
+    }
+        /* this flushes again, but the buffer is empty by now */
+    if (fail)
+        netsend_disconnect(x);
 }
 
-static void netsend_send(t_netsend *x, t_symbol *s, int argc, t_atom *argv)
+static void netsend_flush(t_netsend *x)
 {
-    if (x->x_sockfd >= 0)
+    if (x->x_pending)
+    {
+        t_netsend **xp;
+        for (xp = &STUFF->st_netpending; *xp != x; xp = &(*xp)->x_nextpending)
+            ;
+        *xp = x->x_nextpending;
+        x->x_pending = 0;
+        clock_unset(x->x_flushclock);
+    }
+    if (x->x_sendn)
+        netsend_sendbuf(x, x->x_sendn);
+}
+
+    /* send everything held by all objects, before quitting */
+void netsend_flushall(void)
+{
+    while (STUFF->st_netpending)
+        netsend_flush(STUFF->st_netpending);
+}
+
+static void netsend_reserve(t_netsend *x, int n)
+{
+    if (x->x_sendn + n > x->x_sendsize)
+    {
+        int newsize = 2 * x->x_sendsize + n;
+        x->x_sendbuf = (char *)resizebytes(x->x_sendbuf, x->x_sendsize,
+            newsize);
+        x->x_sendsize = newsize;
+    }
+}
+
+    /* format a FUDI message as binbuf_gettext() would, with a semicolon */
+static void netsend_puttext(t_netsend *x, int argc, t_atom *argv)
+{
+    char string[MAXPDSTRING];
+    int onset = x->x_sendn, i, len;
+    t_atom semi;
+    SETSEMI(&semi);
+    for (i = 0; i <= argc; i++)
+    {
+        t_atom *ap = (i < argc ? argv + i : &semi);
+        if ((ap->a_type == A_SEMI || ap->a_type == A_COMMA) &&
+            x->x_sendn > onset && x->x_sendbuf[x->x_sendn - 1] == ' ')
+                x->x_sendn--;
+        atom_string(ap, string, MAXPDSTRING);
+        len = (int)strlen(string);
+        netsend_reserve(x, len + 1);
+        memcpy(x->x_sendbuf + x->x_sendn, string, len);
+        x->x_sendbuf[x->x_sendn + len] = (ap->a_type == A_SEMI ? '\n' : ' ');
+        x->x_sendn += len + 1;
+    }
+}
+
+    /* format a message into the send buffer and send it now or later */
+static void netsend_queue(t_netsend *x, int argc, t_atom *argv)
+{
+    int onset = x->x_sendn, i;
+    if (x->x_osc)
+    {
+        int length = osc_encode(0, argc, argv);
+        if (length < 0)
+        {
+            pd_error(x, "%s: OSC address must be a symbol starting with '/'",
+                osc_name(x));
+            return;
+        }
+        netsend_reserve(x, length);
+        x->x_sendn += osc_encode(x->x_sendbuf + x->x_sendn, argc, argv);
+    }
+    else if (x->x_netmsg)
+        binbuf_putnetmessage(&x->x_sendbuf, &x->x_sendsize, &x->x_sendn,
+            argc, argv);
+    else if (x->x_bin)
+    {
+        netsend_reserve(x, argc);
+        for (i = 0; i < argc; i++)
+            ((unsigned char *)x->x_sendbuf)[x->x_sendn++] =
+                atom_getfloatarg(i, argc, argv);
+    }
+    else netsend_puttext(x, argc, argv);
+    if (x->x_protocol == SOCK_DGRAM && !x->x_netmsg)
+        netsend_sendbuf(x, x->x_sendn);
+    else
     {
-        if (netsend_dosend(x, x->x_sockfd, argc, argv))
-            netsend_disconnect(x);
+            /* start a new packet if this one won't fit in the current one */
+        if (x->x_protocol == SOCK_DGRAM && onset &&
+            x->x_sendn > NETSEND_MAXPACKET)
+                netsend_sendbuf(x, onset);
+        if (x->x_sendn > NETSEND_MAXHOLD)
+            netsend_flush(x);
+        else if (x->x_sendn && !x->x_pending)
+        {
+            x->x_pending = 1;
+            x->x_nextpending = STUFF->st_netpending;
+            STUFF->st_netpending = x;
+            clock_delay(x->x_flushclock, 0);
+        }
     }
 }
 
+static void netsend_send(t_netsend *x, t_symbol *s, int argc, t_atom *argv)
+{
+    if (x->x_sockfd >= 0)
+        netsend_queue(x, argc, argv);
+}
+
 static void netsend_timeout(t_netsend *x, t_float timeout)
 {
     if (timeout >= 0)
         x->x_timeout = timeout * 0.001;
 }
 
+static void netsend_freesend(t_netsend *x)
+{
+    netsend_flush(x);
+    clock_free(x->x_flushclock);
+    if (x->x_sendbuf)
+        freebytes(x->x_sendbuf, x->x_sendsize);
+}
+
 static void netsend_free(t_netsend *x)
 {
     netsend_disconnect(x);
+    netsend_freesend(x);
+    osc_freeevents(x);
 }
 
 static void netsend_setup(void)
@@ -557,6 +2417,15 @@ static void netreceive_notify(t_netreceive *x, int fd)
             x->x_receivers = (t_socketreceiver **)t_resizebytes(x->x_receivers,
                 x->x_nconnections * sizeof(t_socketreceiver*),
                     (x->x_nconnections-1) * sizeof(t_socketreceiver*));
+#ifdef NETTHREAD
+            if (x->x_conns[i])
+                netconn_close(x->x_conns[i]);
+#endif
+            memmove(x->x_conns+i, x->x_conns+(i+1),
+                sizeof(struct _netconn*) * (x->x_nconnections - (i+1)));
+            x->x_conns = (struct _netconn **)t_resizebytes(x->x_conns,
+                x->x_nconnections * sizeof(struct _netconn*),
+                    (x->x_nconnections-1) * sizeof(struct _netconn*));
             x->x_nconnections--;
         }
     }
@@ -578,7 +2447,12 @@ static void netreceive_fromaddr(void *z, const void *fromaddr)
 
 static void netreceive_connectpoll(t_netreceive *x)
 {
-    int fd = accept(x->x_ns.x_sockfd, 0, 0);
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    int fd = accept(x->x_ns.x_sockfd, (struct sockaddr *)&addr, &addrlen);
+#ifdef NETTHREAD
+    t_netthread *t;
+#endif
     if (fd < 0) post("netreceive: accept failed");
     else
     {
@@ -591,6 +2465,17 @@ static void netreceive_connectpoll(t_netreceive *x)
             x->x_nconnections * sizeof(t_socketreceiver*),
             nconnections * sizeof(t_socketreceiver*));
         x->x_receivers[x->x_nconnections] = NULL;
+        x->x_conns = (struct _netconn **)t_resizebytes(x->x_conns,
+            x->x_nconnections * sizeof(struct _netconn*),
+            nconnections * sizeof(struct _netconn*));
+        x->x_conns[x->x_nconnections] = NULL;
+#ifdef NETTHREAD
+        if ((t = netthread_get()))
+            x->x_conns[x->x_nconnections] = netconn_new(t, fd, 0,
+                netsend_framing(&x->x_ns), 0, &addr, x, netsend_netdata,
+                    netsend_neterror);
+        else
+#endif
         if (x->x_ns.x_bin)
             sys_addpollfn(fd, (t_fdpollfn)netsend_readbin, x);
         else
@@ -598,6 +2483,7 @@ static void netreceive_connectpoll(t_netreceive *x)
             t_socketreceiver *y = socketreceiver_new((void *)x,
             (t_socketnotifier)netreceive_notify,
                 (x->x_ns.x_msgout ? netsend_read : 0), 0);
+            socketreceiver_set_netmessages(y, x->x_ns.x_netmsg);
             if (x->x_ns.x_fromout)
                 socketreceiver_set_fromaddrfn(y,
                     (t_socketfromaddrfn)netreceive_fromaddr);
@@ -611,10 +2497,18 @@ static void netreceive_connectpoll(t_netreceive *x)
 static void netreceive_closeall(t_netreceive *x)
 {
     int i;
+    netsend_flush(&x->x_ns);
     for (i = 0; i < x->x_nconnections; i++)
     {
-        sys_rmpollfn(x->x_connections[i]);
-        sys_closesocket(x->x_connections[i]);
+#ifdef NETTHREAD
+        if (x->x_conns[i])
+            netconn_close(x->x_conns[i]);
+        else
+#endif
+        {
+            sys_rmpollfn(x->x_connections[i]);
+            sys_closesocket(x->x_connections[i]);
+        }
         if (x->x_receivers[i])
         {
             socketreceiver_free(x->x_receivers[i]);
@@ -625,7 +2519,17 @@ static void netreceive_closeall(t_netreceive *x)
         x->x_nconnections * sizeof(int), 0);
     x->x_receivers = (t_socketreceiver**)t_resizebytes(x->x_receivers,
                 x->x_nconnections * sizeof(t_socketreceiver*), 0);
+    x->x_conns = (struct _netconn **)t_resizebytes(x->x_conns,
+                x->x_nconnections * sizeof(struct _netconn*), 0);
     x->x_nconnections = 0;
+#ifdef NETTHREAD
+    if (x->x_ns.x_conn)
+    {
+        netconn_close(x->x_ns.x_conn);
+        x->x_ns.x_conn = NULL;
+    }
+    else
+#endif
     if (x->x_ns.x_sockfd >= 0)
     {
         sys_rmpollfn(x->x_ns.x_sockfd);
@@ -644,6 +2548,9 @@ static void netreceive_listen(t_netreceive *x, t_symbol *s, int argc, t_atom *ar
     int portno = 0, sockfd, status, protocol = x->x_ns.x_protocol, multicast = 0;
     struct addrinfo *ailist = NULL, *ai;
     const char *hostname = NULL; /* allowed or UDP multicast hostname */
+#ifdef NETTHREAD
+    t_netthread *t;
+#endif
 
     netreceive_closeall(x);
 
@@ -801,6 +2708,13 @@ static void netreceive_listen(t_netreceive *x, t_symbol *s, int argc, t_atom *ar
     }
     x->x_ns.x_sockfd = sockfd;
 
+#ifdef NETTHREAD
+    if (protocol == SOCK_DGRAM && (t = netthread_get()))
+        x->x_ns.x_conn = netconn_new(t, sockfd, 1, netsend_framing(&x->x_ns),
+            (x->x_ns.x_fromout != 0), 0, x, netsend_netdata,
+                netsend_neterror);
+    else
+#endif
     if (protocol == SOCK_DGRAM) /* datagram protocol */
     {
         if (x->x_ns.x_bin)
@@ -810,6 +2724,7 @@ static void netreceive_listen(t_netreceive *x, t_symbol *s, int argc, t_atom *ar
                 /* a UDP receiver doesn't get notifications! */
             t_socketreceiver *y = socketreceiver_new(x, 0,
                     (x->x_ns.x_msgout ? netsend_read : 0), 1);
+            socketreceiver_set_netmessages(y, x->x_ns.x_netmsg);
             if (x->x_ns.x_fromout)
                 socketreceiver_set_fromaddrfn(y,
                     (t_socketfromaddrfn)netreceive_fromaddr);
@@ -837,18 +2752,13 @@ static void netreceive_listen(t_netreceive *x, t_symbol *s, int argc, t_atom *ar
 static void netreceive_send(t_netreceive *x,
     t_symbol *s, int argc, t_atom *argv)
 {
-    int i;
     if (x->x_ns.x_protocol != SOCK_STREAM)
     {
         pd_error(x, "netreceive: 'send' only works for TCP");
         return;
     }
-    for (i = 0; i < x->x_nconnections; i++)
-    {
-        if (netsend_dosend(&x->x_ns, x->x_connections[i], argc, argv))
-            pd_error(x, "netreceive: send message failed");
-                /* should we now close the connection? */
-    }
+    if (x->x_nconnections)
+        netsend_queue(&x->x_ns, argc, argv);
 }
 
 static void *netreceive_new(t_symbol *s, int argc, t_atom *argv)
@@ -858,10 +2768,17 @@ static void *netreceive_new(t_symbol *s, int argc, t_atom *argv)
     x->x_ns.x_protocol = SOCK_STREAM;
     x->x_old = 0;
     x->x_ns.x_bin = 0;
+    x->x_ns.x_osc = 0;
+    x->x_ns.x_oscoffset = 0;
+    x->x_ns.x_oscevents = 0;
+    netsend_initsend(&x->x_ns);
     x->x_nconnections = 0;
     x->x_connections = (int *)t_getbytes(0);
     x->x_receivers = (t_socketreceiver **)t_getbytes(0);
+    x->x_conns = (struct _netconn **)t_getbytes(0);
     x->x_ns.x_sockfd = -1;
+    x->x_ns.x_receiver = NULL;
+    x->x_ns.x_conn = NULL;
     if (argc && argv->a_type == A_FLOAT)
     {
         /* port argument is later passed to netreceive_listen */
@@ -879,6 +2796,13 @@ static void *netreceive_new(t_symbol *s, int argc, t_atom *argv)
                 x->x_ns.x_bin = 1;
             else if (!strcmp(argv->a_w.w_symbol->s_name, "-u"))
                 x->x_ns.x_protocol = SOCK_DGRAM;
+            else if (!strcmp(argv->a_w.w_symbol->s_name, "-o"))
+            {
+                x->x_ns.x_osc = x->x_ns.x_bin = 1;
+                x->x_ns.x_protocol = SOCK_DGRAM;
+            }
+            else if (!strcmp(argv->a_w.w_symbol->s_name, "-t"))
+                x->x_ns.x_netmsg = 1;
             else if (!strcmp(argv->a_w.w_symbol->s_name, "-f"))
                 from = 1;
             else
@@ -889,6 +2813,8 @@ static void *netreceive_new(t_symbol *s, int argc, t_atom *argv)
             argc--; argv++;
         }
     }
+    if (x->x_ns.x_bin)
+        x->x_ns.x_netmsg = 0;
     if (x->x_old)
     {
         /* old style, nonsecure version */
@@ -912,6 +2838,8 @@ static void *netreceive_new(t_symbol *s, int argc, t_atom *argv)
 static void netreceive_free(t_netreceive *x)
 {
     netreceive_closeall(x);
+    netsend_freesend(&x->x_ns);
+    osc_freeevents(&x->x_ns);
 }
 
 static void netreceive_setup(void)
@@ -344,8 +344,14 @@ ex_lex(struct expr *expr, long int *n)
                 if (non >= maxnode) {
                         maxnode += MINODES;
 
+#ifdef PD
+                        list_arr = resizebytes((void *)list_arr,
+                            sizeof (struct ex_ex) * (maxnode - MINODES),
+                                        sizeof (struct ex_ex) * maxnode);
+#else
                         list_arr = fts_realloc((void *)list_arr,
                                         sizeof (struct ex_ex) * maxnode);
+#endif
                         if (!list_arr) {
                                 post("ex_lex: no mem\n");
                                 return ((struct ex_ex *)0);
@@ -18,10 +18,17 @@
 typedef float t_float;      // t_float is from m_pd.h
 #endif
 
+#ifdef PD
+    /* use Pd's allocator, so that "-rtaudit" sees expr~'s temporaries */
+#define fts_malloc(n) getbytes(n)
+#define fts_calloc(n, s) getbytes((n) * (s))
+#define fts_free(p) freebytes((p), 0)
+#else
 #define fts_malloc malloc
 #define fts_calloc calloc
 #define fts_free free
 #define fts_realloc realloc
+#endif
 #define fts_atom_t t_atom
 #define fts_object_t t_object
 typedef t_symbol *fts_symbol_t;
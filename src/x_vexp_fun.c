@@ -84,6 +84,46 @@
 
 #include "x_vexp.h"
 
+/*
+ * with "fast math" on (see d_fastmath.h) exp, log, pow, sin and cos
+ * use Pd's approximations instead of the math library, but only on signal
+ * vectors in expr~ and fexpr~; scalars, and so all of control-rate expr,
+ * keep the double-precision library calls.  Arguments outside their
+ * domain still go to the library so error results don't change.
+ */
+#if defined(PD) && PD_FLOATSIZE == 32
+#include "s_stuff.h"
+#include "d_fastmath.h"
+#define EX_ISVEC(x) ((x)->ex_type == ET_VEC || (x)->ex_type == ET_VI)
+#define EX_FASTMATH(x) (sys_fastmath && EX_ISVEC(x))
+
+static t_float
+ex_fastln(t_float x)
+{
+        return (x > 0 ? fastmath_log(x) : log(x));
+}
+
+static t_float
+ex_fastlog10(t_float x)
+{
+        return (x > 0 ? (t_float)0.434294481903251828 * fastmath_log(x) : log10(x));
+}
+
+static t_float
+ex_fastpow(t_float x, t_float y)
+{
+        return (x > 0 ? fastmath_pow(x, y) : pow(x, y));
+}
+#else /* MSP, or double-precision Pd */
+#define EX_FASTMATH(x) 0
+#define ex_fastln(x) log(x)
+#define ex_fastlog10(x) log10(x)
+#define ex_fastpow(x, y) pow((x), (y))
+#define fastmath_exp(x) exp(x)
+#define fastmath_sin(x) sin(x)
+#define fastmath_cos(x) cos(x)
+#endif
+
 struct ex_ex *ex_eval(struct expr *expr, struct ex_ex *eptr,
                                                 struct ex_ex *optr, int i);
 
@@ -615,7 +655,11 @@ ex_pow(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
         right = argv;
-        FUNC_EVAL(left, right, pow, (double), (double), optr, 1);
+        if (EX_FASTMATH(left) || EX_FASTMATH(right))
+                FUNC_EVAL(left, right, ex_fastpow, (t_float), (t_float),
+                    optr, 1)
+        else
+                FUNC_EVAL(left, right, pow, (double), (double), optr, 1);
 }
 
 /*
@@ -649,7 +693,10 @@ ex_exp(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
 
-        FUNC_EVAL_UNARY(left, exp, (double), optr, 1);
+        if (EX_FASTMATH(left))
+                FUNC_EVAL_UNARY(left, fastmath_exp, (t_float), optr, 1)
+        else
+                FUNC_EVAL_UNARY(left, exp, (double), optr, 1);
 }
 
 /*
@@ -666,7 +713,10 @@ ex_log(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
 
-        FUNC_EVAL_UNARY(left, log10, (double), optr, 1);
+        if (EX_FASTMATH(left))
+                FUNC_EVAL_UNARY(left, ex_fastlog10, (t_float), optr, 1)
+        else
+                FUNC_EVAL_UNARY(left, log10, (double), optr, 1);
 }
 
 /*
@@ -683,7 +733,10 @@ ex_ln(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
 
-        FUNC_EVAL_UNARY(left, log, (double), optr, 1);
+        if (EX_FASTMATH(left))
+                FUNC_EVAL_UNARY(left, ex_fastln, (t_float), optr, 1)
+        else
+                FUNC_EVAL_UNARY(left, log, (double), optr, 1);
 }
 
 static void
@@ -697,7 +750,10 @@ ex_sin(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
 
-        FUNC_EVAL_UNARY(left, sin, (double), optr, 1);
+        if (EX_FASTMATH(left))
+                FUNC_EVAL_UNARY(left, fastmath_sin, (t_float), optr, 1)
+        else
+                FUNC_EVAL_UNARY(left, sin, (double), optr, 1);
 }
 
 static void
@@ -711,7 +767,10 @@ ex_cos(t_expr *e, long int argc, struct ex_ex *argv, struct ex_ex *optr)
 
         left = argv++;
 
-        FUNC_EVAL_UNARY(left, cos, (double), optr, 1);
+        if (EX_FASTMATH(left))
+                FUNC_EVAL_UNARY(left, fastmath_cos, (t_float), optr, 1)
+        else
+                FUNC_EVAL_UNARY(left, cos, (double), optr, 1);
 }
 
 